@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_BOUND_CONSTRAINED_OPTIMIZER_H_
+#define MAV_TRAJECTORY_GENERATION_BOUND_CONSTRAINED_OPTIMIZER_H_
+
+#include <Eigen/Core>
+#include <deque>
+#include <functional>
+#include <nlopt.hpp>
+
+namespace mav_trajectory_generation {
+
+// Minimizes a function of x subject to lower <= x <= upper.
+// Results are reported as nlopt::result codes, such that they can be used
+// interchangeably with nlopt's in OptimizationInfo::stopping_reason.
+class BoundConstrainedOptimizer {
+ public:
+  // Returns the function value at x. If gradient has a non-zero size, the
+  // gradient at x has to be written to it as well.
+  typedef std::function<double(const Eigen::Ref<const Eigen::VectorXd>& x,
+                               Eigen::Ref<Eigen::VectorXd> gradient)>
+      Objective;
+
+  // Stopping criteria. Disabled if negative.
+  struct Tolerances {
+    // Relative change of the function value between iterations.
+    double f_rel = 1.0e-6;
+    // Relative change of x between iterations.
+    double x_rel = -1.0;
+    // Maximum number of function evaluations.
+    int max_evaluations = 1000;
+  };
+
+  virtual ~BoundConstrainedOptimizer() {}
+
+  void setTolerances(const Tolerances& tolerances) {
+    tolerances_ = tolerances;
+  }
+  const Tolerances& getTolerances() const { return tolerances_; }
+
+  // Whether the backend needs the gradient of the objective.
+  virtual bool requiresGradient() const = 0;
+
+  // Input: objective = Function to minimize.
+  // Input: lower, upper = Bounds on x.
+  // Input/Output: x = Initial guess, overwritten by the best point found.
+  // Output: f_min = Function value at x.
+  // Returns an nlopt::result, positive on success.
+  virtual int minimize(const Objective& objective, const Eigen::VectorXd& lower,
+                       const Eigen::VectorXd& upper, Eigen::VectorXd* x,
+                       double* f_min) = 0;
+
+  // Returns the number of function evaluations of the last minimization.
+  int getNumberOfEvaluations() const { return n_evaluations_; }
+
+  typedef std::function<double(const Eigen::Ref<const Eigen::VectorXd>& x)>
+      Function;
+
+  // Wraps a function without gradient into an objective that computes the
+  // gradient by forward differences, stepping backwards at upper bounds.
+  // Input: relative_step = Step size relative to max(1, |x_i|).
+  static Objective withFiniteDifferenceGradient(const Function& function,
+                                                const Eigen::VectorXd& upper,
+                                                double relative_step = 1.0e-6);
+
+  // Same, but evaluates the perturbed points with probe instead of function,
+  // e.g. to keep them out of the bookkeeping of function.
+  static Objective withFiniteDifferenceGradient(const Function& function,
+                                                const Function& probe,
+                                                const Eigen::VectorXd& upper,
+                                                double relative_step = 1.0e-6);
+
+ protected:
+  Tolerances tolerances_;
+  int n_evaluations_ = 0;
+};
+
+// Runs the minimization on an existing nlopt instance. Its algorithm,
+// initial step and any constraints registered on it are kept, e.g. the hard
+// constraints of a trajectory optimization, while minimize() sets the
+// objective, bounds and tolerances. x and the gradient are passed to the
+// objective as maps of nlopt's buffers, without copies.
+class NloptOptimizer : public BoundConstrainedOptimizer {
+ public:
+  // Input: opt = nlopt instance with the dimension of x. Not owned.
+  explicit NloptOptimizer(nlopt::opt* opt);
+
+  virtual bool requiresGradient() const;
+
+  virtual int minimize(const Objective& objective, const Eigen::VectorXd& lower,
+                       const Eigen::VectorXd& upper, Eigen::VectorXd* x,
+                       double* f_min);
+
+ private:
+  nlopt::opt* opt_;
+};
+
+// Projected L-BFGS: limited-memory quasi-Newton steps on the variables that
+// are not held at a bound, projected back onto the bounds, with a
+// backtracking line search along the projected path. The curvature pairs can
+// be kept across minimizations, which warm-starts a sequence of similar
+// problems, e.g. replanning with slightly changed waypoints.
+class ProjectedLbfgsOptimizer : public BoundConstrainedOptimizer {
+ public:
+  // Input: memory = Number of curvature pairs kept.
+  explicit ProjectedLbfgsOptimizer(size_t memory = 10);
+
+  virtual bool requiresGradient() const { return true; }
+
+  virtual int minimize(const Objective& objective, const Eigen::VectorXd& lower,
+                       const Eigen::VectorXd& upper, Eigen::VectorXd* x,
+                       double* f_min);
+
+  // If enabled, the next minimization starts with the curvature pairs of the
+  // previous one, as long as the number of variables did not change.
+  void setWarmStart(bool warm_start) { warm_start_ = warm_start; }
+
+  // Converged if the largest projected gradient entry falls below this value.
+  void setGradientTolerance(double tolerance) {
+    gradient_tolerance_ = tolerance;
+  }
+
+  // Discards the curvature pairs.
+  void reset();
+
+ private:
+  // Computes the quasi-Newton direction -H * gradient from the curvature
+  // pairs. Variables in fixed do not move.
+  void computeDirection(const Eigen::VectorXd& gradient,
+                        const Eigen::Array<bool, Eigen::Dynamic, 1>& fixed,
+                        Eigen::VectorXd* direction) const;
+
+  size_t memory_;
+  bool warm_start_;
+  double gradient_tolerance_;
+  std::deque<Eigen::VectorXd> s_;
+  std::deque<Eigen::VectorXd> y_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_BOUND_CONSTRAINED_OPTIMIZER_H_
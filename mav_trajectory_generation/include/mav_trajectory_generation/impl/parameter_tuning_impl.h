@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_IMPL_PARAMETER_TUNING_IMPL_H_
+#define MAV_TRAJECTORY_GENERATION_IMPL_PARAMETER_TUNING_IMPL_H_
+
+#include <algorithm>
+
+namespace mav_trajectory_generation {
+
+template <int _N>
+ParameterTuning<_N>::ParameterTuning(
+    const NonlinearOptimizationParameters& base,
+    const TuningParameters& tuning_parameters)
+    : base_(base), tuning_parameters_(tuning_parameters) {}
+
+template <int _N>
+void ParameterTuning<_N>::addProblem(const TuningProblem& problem) {
+  CHECK_GE(problem.vertices.size(), 2u);
+  problems_.push_back(problem);
+}
+
+template <int _N>
+bool ParameterTuning<_N>::run() {
+  if (problems_.empty()) {
+    LOG(WARNING) << "No problems to tune the parameters on.";
+    return false;
+  }
+
+  // Sample all parameter sets up front, such that the results do not depend
+  // on the number of threads.
+  std::mt19937 generator(tuning_parameters_.random_seed);
+  results_.assign(tuning_parameters_.n_samples + 1, TuningResult());
+  results_.front().parameters = base_;
+  for (size_t i = 1; i < results_.size(); ++i) {
+    results_[i].parameters =
+        sampleParameters(base_, tuning_parameters_, &generator);
+  }
+
+  std::vector<char> success(results_.size(), 0);
+  ThreadPool thread_pool(tuning_parameters_.n_threads);
+  thread_pool.parallelFor(results_.size(), [&](size_t i) {
+    success[i] = evaluate(results_[i].parameters, &results_[i]);
+  });
+
+  return std::find(success.begin(), success.end(), 0) == success.end();
+}
+
+template <int _N>
+bool ParameterTuning<_N>::evaluate(
+    const NonlinearOptimizationParameters& parameters,
+    TuningResult* result) const {
+  CHECK_NOTNULL(result);
+  // Copy first, parameters may refer to result->parameters.
+  const NonlinearOptimizationParameters parameters_copy = parameters;
+  *result = TuningResult();
+  result->parameters = parameters_copy;
+  // Debug output of parallel evaluations would be interleaved.
+  result->parameters.print_debug_info = false;
+  result->parameters.print_debug_info_time_allocation = false;
+
+  for (const TuningProblem& problem : problems_) {
+    const size_t dimension = problem.vertices.front().D();
+    std::vector<double> segment_times = problem.segment_times;
+    if (segment_times.empty()) {
+      std::map<int, double>::const_iterator v_max =
+          problem.limits.find(derivative_order::VELOCITY);
+      std::map<int, double>::const_iterator a_max =
+          problem.limits.find(derivative_order::ACCELERATION);
+      if (v_max == problem.limits.end() || a_max == problem.limits.end()) {
+        LOG(WARNING) << "Problems without segment times need velocity and "
+                        "acceleration limits.";
+        return false;
+      }
+      segment_times =
+          estimateSegmentTimes(problem.vertices, v_max->second, a_max->second);
+    }
+
+    PolynomialOptimizationNonLinear<N> opt(dimension, result->parameters);
+    if (!opt.setupFromVertices(problem.vertices, segment_times,
+                               problem.derivative_to_optimize)) {
+      return false;
+    }
+    for (const std::pair<const int, double>& limit : problem.limits) {
+      opt.addMaximumMagnitudeConstraint(limit.first, limit.second);
+    }
+    // Failed optimizations show up as violations instead of failing the
+    // evaluation.
+    opt.optimize();
+
+    Trajectory trajectory;
+    opt.getTrajectory(&trajectory);
+    result->runtime += opt.getOptimizationInfo().optimization_time;
+    result->cost += opt.getCost() + base_.time_penalty * trajectory.getMaxTime();
+
+    std::vector<int> dimensions(std::min<size_t>(dimension, 3));
+    for (size_t i = 0; i < dimensions.size(); ++i) {
+      dimensions[i] = i;
+    }
+    double problem_violation = 0.0;
+    for (const std::pair<const int, double>& limit : problem.limits) {
+      Extremum minimum, maximum;
+      trajectory.computeMinMaxMagnitude(limit.first, dimensions, &minimum,
+                                        &maximum);
+      problem_violation =
+          std::max(problem_violation, maximum.value / limit.second - 1.0);
+    }
+    result->violation = std::max(result->violation, problem_violation);
+    if (problem_violation <= tuning_parameters_.feasibility_tolerance_rel) {
+      ++result->n_feasible;
+    }
+  }
+  return true;
+}
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_IMPL_PARAMETER_TUNING_IMPL_H_
@@ -0,0 +1,228 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_BATCH_IMPL_H_
+#define MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_BATCH_IMPL_H_
+
+#include <algorithm>
+#include <chrono>
+
+namespace mav_trajectory_generation {
+
+template <int _N>
+PolynomialOptimizationBatch<_N>::PolynomialOptimizationBatch(
+    size_t dimension, const NonlinearOptimizationParameters& parameters,
+    size_t n_threads)
+    : dimension_(dimension),
+      optimization_parameters_(parameters),
+      thread_pool_(n_threads),
+      n_constraint_patterns_(0) {}
+
+template <int _N>
+size_t PolynomialOptimizationBatch<_N>::addProblem(
+    const BatchOptimizationProblem& problem) {
+  CHECK_EQ(problem.vertices.size(), problem.segment_times.size() + 1)
+      << "Size of segment times must be one less than vertices.";
+  problems_.push_back(problem);
+  return problems_.size() - 1;
+}
+
+template <int _N>
+void PolynomialOptimizationBatch<_N>::clear() {
+  problems_.clear();
+  trajectories_.clear();
+  optimization_infos_.clear();
+  n_constraint_patterns_ = 0;
+}
+
+template <int _N>
+int PolynomialOptimizationBatch<_N>::getDerivativeToOptimize(
+    const BatchOptimizationProblem& problem) const {
+  if (problem.derivative_to_optimize < 0) {
+    return PolynomialOptimization<N>::kHighestDerivativeToOptimize;
+  }
+  return problem.derivative_to_optimize;
+}
+
+template <int _N>
+void PolynomialOptimizationBatch<_N>::setupConstraintPatterns(
+    std::vector<PolynomialOptimization<N> >* pattern_problems,
+    std::vector<size_t>* pattern_indices) {
+  CHECK_NOTNULL(pattern_problems);
+  CHECK_NOTNULL(pattern_indices);
+
+  // The pattern consists of the derivative to optimize and, per vertex, a
+  // bit mask of the constrained derivatives.
+  std::map<std::vector<int>, size_t> patterns;
+  std::vector<size_t> first_problem_of_pattern;
+  pattern_indices->resize(problems_.size());
+  std::vector<int> pattern;
+  for (size_t i = 0; i < problems_.size(); ++i) {
+    const BatchOptimizationProblem& problem = problems_[i];
+    pattern.clear();
+    pattern.push_back(getDerivativeToOptimize(problem));
+    for (const Vertex& vertex : problem.vertices) {
+      int mask = 0;
+      for (int derivative = 0;
+           derivative <=
+           PolynomialOptimization<N>::kHighestDerivativeToOptimize;
+           ++derivative) {
+        if (vertex.hasConstraint(derivative)) mask |= 1 << derivative;
+      }
+      pattern.push_back(mask);
+    }
+
+    std::pair<std::map<std::vector<int>, size_t>::iterator, bool> inserted =
+        patterns.insert(std::make_pair(pattern, patterns.size()));
+    if (inserted.second) {
+      first_problem_of_pattern.push_back(i);
+    }
+    (*pattern_indices)[i] = inserted.first->second;
+  }
+  n_constraint_patterns_ = first_problem_of_pattern.size();
+
+  pattern_problems->assign(n_constraint_patterns_,
+                           PolynomialOptimization<N>(dimension_));
+  thread_pool_.parallelFor(n_constraint_patterns_, [&](size_t pattern_idx) {
+    const BatchOptimizationProblem& problem =
+        problems_[first_problem_of_pattern[pattern_idx]];
+    (*pattern_problems)[pattern_idx].setupFromVertices(
+        problem.vertices, problem.segment_times,
+        getDerivativeToOptimize(problem));
+  });
+}
+
+template <int _N>
+void PolynomialOptimizationBatch<_N>::setupProblem(
+    size_t problem_idx, const PolynomialOptimization<N>& pattern_problem,
+    PolynomialOptimization<N>* poly_opt) const {
+  CHECK_NOTNULL(poly_opt);
+  const BatchOptimizationProblem& problem = problems_[problem_idx];
+  *poly_opt = pattern_problem;
+  if (!poly_opt->updateVertices(problem.vertices, problem.segment_times)) {
+    LOG(WARNING) << "Constraint pattern of problem " << problem_idx
+                 << " does not match, setting it up from scratch.";
+    poly_opt->setupFromVertices(problem.vertices, problem.segment_times,
+                                getDerivativeToOptimize(problem));
+  }
+}
+
+template <int _N>
+bool PolynomialOptimizationBatch<_N>::solveLinear() {
+  std::vector<PolynomialOptimization<N> > pattern_problems;
+  std::vector<size_t> pattern_indices;
+  setupConstraintPatterns(&pattern_problems, &pattern_indices);
+
+  trajectories_.assign(problems_.size(), Trajectory());
+  optimization_infos_.assign(problems_.size(), OptimizationInfo());
+  std::vector<char> success(problems_.size(), false);
+
+  thread_pool_.parallelFor(problems_.size(), [&](size_t problem_idx) {
+    const std::chrono::high_resolution_clock::time_point t_start =
+        std::chrono::high_resolution_clock::now();
+
+    PolynomialOptimization<N> poly_opt(dimension_);
+    setupProblem(problem_idx, pattern_problems[pattern_indices[problem_idx]],
+                 &poly_opt);
+    success[problem_idx] = poly_opt.solveLinear();
+    poly_opt.getTrajectory(&trajectories_[problem_idx]);
+
+    OptimizationInfo& info = optimization_infos_[problem_idx];
+    info.stopping_reason =
+        success[problem_idx] ? nlopt::SUCCESS : nlopt::FAILURE;
+    info.cost_trajectory = poly_opt.computeCost();
+    for (const std::pair<const int, double>& constraint :
+         problems_[problem_idx].maximum_magnitude_constraints) {
+      info.maxima[constraint.first] =
+          poly_opt.computeMaximumOfMagnitude(constraint.first, nullptr);
+    }
+
+    const std::chrono::high_resolution_clock::time_point t_stop =
+        std::chrono::high_resolution_clock::now();
+    info.optimization_time =
+        std::chrono::duration_cast<std::chrono::duration<double> >(t_stop -
+                                                                   t_start)
+            .count();
+  });
+
+  return std::find(success.begin(), success.end(), false) == success.end();
+}
+
+template <int _N>
+bool PolynomialOptimizationBatch<_N>::optimize() {
+  std::vector<PolynomialOptimization<N> > pattern_problems;
+  std::vector<size_t> pattern_indices;
+  setupConstraintPatterns(&pattern_problems, &pattern_indices);
+
+  trajectories_.assign(problems_.size(), Trajectory());
+  optimization_infos_.assign(problems_.size(), OptimizationInfo());
+
+  thread_pool_.parallelFor(problems_.size(), [&](size_t problem_idx) {
+    const BatchOptimizationProblem& problem = problems_[problem_idx];
+    PolynomialOptimization<N> poly_opt(dimension_);
+    setupProblem(problem_idx, pattern_problems[pattern_indices[problem_idx]],
+                 &poly_opt);
+
+    PolynomialOptimizationNonLinear<N> nonlinear_opt(
+        dimension_, optimization_parameters_);
+    nonlinear_opt.setupFromPolynomialOptimization(poly_opt);
+    for (const std::pair<const int, double>& constraint :
+         problem.maximum_magnitude_constraints) {
+      nonlinear_opt.addMaximumMagnitudeConstraint(constraint.first,
+                                                  constraint.second);
+    }
+    nonlinear_opt.optimize();
+    nonlinear_opt.getTrajectory(&trajectories_[problem_idx]);
+
+    OptimizationInfo& info = optimization_infos_[problem_idx];
+    info = nonlinear_opt.getOptimizationInfo();
+    const PolynomialOptimization<N>& result =
+        nonlinear_opt.getPolynomialOptimizationRef();
+    for (const std::pair<const int, double>& constraint :
+         problem.maximum_magnitude_constraints) {
+      info.maxima[constraint.first] =
+          result.computeMaximumOfMagnitude(constraint.first, nullptr);
+    }
+  });
+
+  for (const OptimizationInfo& info : optimization_infos_) {
+    if (info.stopping_reason < 0) return false;
+  }
+  return true;
+}
+
+template <int _N>
+void PolynomialOptimizationBatch<_N>::getTrajectory(
+    size_t problem_idx, Trajectory* trajectory) const {
+  CHECK_NOTNULL(trajectory);
+  CHECK_LT(problem_idx, trajectories_.size());
+  *trajectory = trajectories_[problem_idx];
+}
+
+template <int _N>
+const OptimizationInfo& PolynomialOptimizationBatch<_N>::getOptimizationInfo(
+    size_t problem_idx) const {
+  CHECK_LT(problem_idx, optimization_infos_.size());
+  return optimization_infos_[problem_idx];
+}
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_BATCH_IMPL_H_
@@ -35,6 +35,7 @@
 #endif
 
 #include "mav_trajectory_generation/convolution.h"
+#include "mav_trajectory_generation/thread_pool.h"
 
 
 
@@ -42,7 +43,9 @@ namespace mav_trajectory_generation {
 
 template <int _N>
 PolynomialOptimization<_N>::PolynomialOptimization(size_t dimension)
-    : dimension_(dimension),
+    : time_normalization_(false),
+      unit_matrices_derivative_(derivative_order::INVALID),
+      dimension_(dimension),
       derivative_to_optimize_(derivative_order::INVALID),
       n_vertices_(0),
       n_segments_(0),
@@ -67,6 +70,7 @@ bool PolynomialOptimization<_N>::setupFromVertices(
   derivative_to_optimize_ = derivative_to_optimize;
   vertices_ = vertices;
   segment_times_ = times;
+  clearDerivativeBounds();
 
   n_vertices_ = vertices.size();
   n_segments_ = n_vertices_ - 1;
@@ -79,6 +83,24 @@ bool PolynomialOptimization<_N>::setupFromVertices(
   inverse_mapping_matrices_.resize(n_segments_);
   cost_matrices_.resize(n_segments_);
 
+  // The unit time matrices are computed once in extended precision. The
+  // entries of A^-1 grow quickly with N, such that a double inversion loses
+  // most digits for N > 12.
+  if (unit_matrices_derivative_ != derivative_to_optimize_) {
+    typedef Eigen::Matrix<long double, N, N> ExtendedSquareMatrix;
+    SquareMatrix A_unit, Q_unit;
+    setupMappingMatrix(1.0, &A_unit);
+    computeQuadraticCostJacobian(derivative_to_optimize_, 1.0, &Q_unit);
+    const ExtendedSquareMatrix A_unit_inverse =
+        A_unit.template cast<long double>().fullPivLu().inverse();
+    unit_inverse_mapping_matrix_ = A_unit_inverse.template cast<double>();
+    unit_cost_matrix_ = Q_unit;
+    unit_cost_block_ = (A_unit_inverse.transpose() *
+                        Q_unit.template cast<long double>() * A_unit_inverse)
+                           .template cast<double>();
+    unit_matrices_derivative_ = derivative_to_optimize_;
+  }
+
   // Iterate through all vertices and remove invalid constraints (order too
   // high).
   for (size_t vertex_idx = 0; vertex_idx < n_vertices_; ++vertex_idx) {
@@ -104,7 +126,83 @@ bool PolynomialOptimization<_N>::setupFromVertices(
     }
   }
   updateSegmentTimes(times);
-  setupConstraintReorderingMatrix();
+  if (updateConstraintPattern()) {
+    setupConstraintReorderingMatrix();
+  } else {
+    updateFixedConstraintsCompact();
+  }
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::updateConstraintPattern() {
+  bool changed = constraint_pattern_.size() != n_vertices_;
+  constraint_pattern_.resize(n_vertices_);
+  for (size_t vertex_idx = 0; vertex_idx < n_vertices_; ++vertex_idx) {
+    unsigned int pattern = 0;
+    for (int derivative = 0; derivative <= kHighestDerivativeToOptimize;
+         ++derivative) {
+      if (vertices_[vertex_idx].hasConstraint(derivative)) {
+        pattern |= 1u << derivative;
+      }
+    }
+    changed |= constraint_pattern_[vertex_idx] != pattern;
+    constraint_pattern_[vertex_idx] = pattern;
+  }
+  return changed;
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::updateFixedConstraintsCompact() {
+  // The fixed constraints are ordered by vertex and derivative, see
+  // setupConstraintReorderingMatrix().
+  size_t col = 0;
+  Vertex::ConstraintValue value;
+  for (size_t vertex_idx = 0; vertex_idx < n_vertices_; ++vertex_idx) {
+    for (int derivative = 0; derivative <= kHighestDerivativeToOptimize;
+         ++derivative) {
+      if (vertices_[vertex_idx].getConstraint(derivative, &value)) {
+        for (size_t d = 0; d < dimension_; ++d) {
+          fixed_constraints_compact_[d][col] = value[d];
+        }
+        ++col;
+      }
+    }
+  }
+  CHECK_EQ(col, n_fixed_constraints_);
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::updateVertices(
+    const Vertex::Vector& vertices, const std::vector<double>& segment_times) {
+  if (vertices.size() != n_vertices_) {
+    return false;
+  }
+  for (size_t vertex_idx = 0; vertex_idx < n_vertices_; ++vertex_idx) {
+    if (vertices[vertex_idx].D() != static_cast<int>(dimension_)) {
+      return false;
+    }
+    for (int derivative = 0; derivative <= kHighestDerivativeToOptimize;
+         ++derivative) {
+      if (vertices[vertex_idx].hasConstraint(derivative) !=
+          vertices_[vertex_idx].hasConstraint(derivative)) {
+        return false;
+      }
+    }
+  }
+
+  Vertex::ConstraintValue value;
+  for (size_t vertex_idx = 0; vertex_idx < n_vertices_; ++vertex_idx) {
+    for (int derivative = 0; derivative <= kHighestDerivativeToOptimize;
+         ++derivative) {
+      if (vertices[vertex_idx].getConstraint(derivative, &value)) {
+        vertices_[vertex_idx].addConstraint(derivative, value);
+      }
+    }
+  }
+  updateFixedConstraintsCompact();
+
+  updateSegmentTimes(segment_times);
   return true;
 }
 
@@ -257,12 +355,90 @@ void PolynomialOptimization<_N>::setupConstraintReorderingMatrix() {
 
   constraint_reordering_.setFromTriplets(reordering_list.begin(),
                                          reordering_list.end());
+
+  // Every row of the reordering matrix has exactly one entry.
+  constraint_indices_.resize(n_all_constraints_);
+  for (const Triplet& entry : reordering_list) {
+    constraint_indices_[entry.row()] = entry.col();
+  }
+  setupCostBlockPatterns();
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::setupCostBlockPatterns() {
+  typedef Eigen::Triplet<double> Triplet;
+  std::vector<Triplet> free_free_list;
+  std::vector<Triplet> free_fixed_list;
+  free_free_list.reserve(N * N * n_segments_);
+  free_fixed_list.reserve(N * N * n_segments_);
+  for (size_t i = 0; i < n_segments_; ++i) {
+    for (int col = 0; col < N; ++col) {
+      const size_t constraint_col = constraint_indices_[i * N + col];
+      for (int row = 0; row < N; ++row) {
+        const size_t constraint_row = constraint_indices_[i * N + row];
+        if (constraint_row < n_fixed_constraints_) {
+          continue;
+        }
+        if (constraint_col < n_fixed_constraints_) {
+          free_fixed_list.emplace_back(constraint_row - n_fixed_constraints_,
+                                       constraint_col, 0.0);
+        } else {
+          free_free_list.emplace_back(constraint_row - n_fixed_constraints_,
+                                      constraint_col - n_fixed_constraints_,
+                                      0.0);
+        }
+      }
+    }
+  }
+  cost_free_free_.resize(n_free_constraints_, n_free_constraints_);
+  cost_free_free_.setFromTriplets(free_free_list.begin(),
+                                  free_free_list.end());
+  cost_free_fixed_.resize(n_free_constraints_, n_fixed_constraints_);
+  cost_free_fixed_.setFromTriplets(free_fixed_list.begin(),
+                                   free_fixed_list.end());
+
+  // Position of (row, col) in the values of a compressed column-major matrix.
+  auto value_index = [](const Eigen::SparseMatrix<double>& matrix, int row,
+                        int col) {
+    const int* begin = matrix.innerIndexPtr() + matrix.outerIndexPtr()[col];
+    const int* end = matrix.innerIndexPtr() + matrix.outerIndexPtr()[col + 1];
+    const int* it = std::lower_bound(begin, end, row);
+    CHECK(it != end && *it == row);
+    return static_cast<int>(it - matrix.innerIndexPtr());
+  };
+  cost_value_indices_.resize(N * N * n_segments_);
+  for (size_t i = 0; i < n_segments_; ++i) {
+    for (int col = 0; col < N; ++col) {
+      const size_t constraint_col = constraint_indices_[i * N + col];
+      for (int row = 0; row < N; ++row) {
+        const size_t constraint_row = constraint_indices_[i * N + row];
+        int& index = cost_value_indices_[(i * N + col) * N + row];
+        if (constraint_row < n_fixed_constraints_) {
+          index = -1;
+        } else if (constraint_col < n_fixed_constraints_) {
+          index = -2 - value_index(cost_free_fixed_,
+                                   constraint_row - n_fixed_constraints_,
+                                   constraint_col);
+        } else {
+          index = value_index(cost_free_free_,
+                              constraint_row - n_fixed_constraints_,
+                              constraint_col - n_fixed_constraints_);
+        }
+      }
+    }
+  }
+  cost_blocks_.resize(n_segments_);
 }
 
 template <int _N>
 void PolynomialOptimization<_N>::updateSegmentsFromCompactConstraints() {
   const size_t n_all_constraints = n_fixed_constraints_ + n_free_constraints_;
 
+  // The segments may have been moved out by extractTrajectory().
+  if (segments_.size() != n_segments_) {
+    segments_.assign(n_segments_, Segment(N, dimension_));
+  }
+
   for (size_t dimension_idx = 0; dimension_idx < dimension_; ++dimension_idx) {
     const Eigen::VectorXd& df = fixed_constraints_compact_[dimension_idx];
     const Eigen::VectorXd& dp_opt = free_constraints_compact_[dimension_idx];
@@ -271,8 +447,10 @@ void PolynomialOptimization<_N>::updateSegmentsFromCompactConstraints() {
     d_all << df, dp_opt;
 
     for (size_t i = 0; i < n_segments_; ++i) {
-      const Eigen::Matrix<double, N, 1> new_d =
-          constraint_reordering_.block(i * N, 0, N, n_all_constraints) * d_all;
+      Eigen::Matrix<double, N, 1> new_d;
+      for (int k = 0; k < N; ++k) {
+        new_d[k] = d_all[constraint_indices_[i * N + k]];
+      }
       const Eigen::Matrix<double, N, 1> coeffs =
           inverse_mapping_matrices_[i] * new_d;
       Segment& segment = segments_[i];
@@ -295,13 +473,86 @@ void PolynomialOptimization<_N>::updateSegmentTimes(
   for (size_t i = 0; i < n_segments_; ++i) {
     const double segment_time = segment_times[i];
     CHECK_GT(segment_time, 0) << "Segment times need to be greater than zero";
+    updateSegmentMatrices(i, segment_time);
+  };
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::updateSegmentTime(size_t segment_idx,
+                                                   double segment_time) {
+  CHECK_LT(segment_idx, n_segments_);
+  CHECK_GT(segment_time, 0) << "Segment times need to be greater than zero";
+
+  segment_times_[segment_idx] = segment_time;
+  updateSegmentMatrices(segment_idx, segment_time);
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::setTimeNormalization(
+    bool time_normalization) {
+  time_normalization_ = time_normalization;
+  if (n_segments_ > 0) {
+    updateSegmentTimes(segment_times_);
+  }
+}
 
+template <int _N>
+void PolynomialOptimization<_N>::updateSegmentMatrices(size_t segment_idx,
+                                                       double segment_time) {
+  if (!time_normalization_) {
     computeQuadraticCostJacobian(derivative_to_optimize_, segment_time,
-                                 &cost_matrices_[i]);
+                                 &cost_matrices_[segment_idx]);
     SquareMatrix A;
     setupMappingMatrix(segment_time, &A);
-    invertMappingMatrix(A, &inverse_mapping_matrices_[i]);
-  };
+    invertMappingMatrix(A, &inverse_mapping_matrices_[segment_idx]);
+    return;
+  }
+
+  // With tau = t / T, the coefficients of p(tau) are c_k * T^k, and the
+  // j-th derivative constraints are d_j * T^j at both ends of the segment.
+  Eigen::Matrix<double, N, 1> coefficient_powers;
+  Eigen::Matrix<double, N, 1> constraint_powers;
+  double power = 1.0;
+  for (int k = 0; k < N; ++k) {
+    coefficient_powers[k] = power;
+    if (k < N / 2) {
+      constraint_powers[k] = power;
+      constraint_powers[k + N / 2] = power;
+    }
+    power *= segment_time;
+  }
+  inverse_mapping_matrices_[segment_idx] =
+      coefficient_powers.cwiseInverse().asDiagonal() *
+      unit_inverse_mapping_matrix_ * constraint_powers.asDiagonal();
+  // The r-th derivative is scaled by T^-r, and dt = T dtau.
+  cost_matrices_[segment_idx] =
+      std::pow(segment_time, 1 - 2 * derivative_to_optimize_) *
+      (coefficient_powers.asDiagonal() * unit_cost_matrix_ *
+       coefficient_powers.asDiagonal());
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::computeCostBlock(size_t segment_idx,
+                                                  SquareMatrix* H) const {
+  CHECK_NOTNULL(H);
+  if (!time_normalization_) {
+    const SquareMatrix& Ai = inverse_mapping_matrices_[segment_idx];
+    H->noalias() = Ai.transpose() * cost_matrices_[segment_idx] * Ai;
+    return;
+  }
+
+  // H = T^(1 - 2r) * S * H_unit * S with S = diag(T^j) of the constraints.
+  const double segment_time = segment_times_[segment_idx];
+  Eigen::Matrix<double, N, 1> constraint_powers;
+  double power = 1.0;
+  for (int j = 0; j < N / 2; ++j) {
+    constraint_powers[j] = power;
+    constraint_powers[j + N / 2] = power;
+    power *= segment_time;
+  }
+  *H = std::pow(segment_time, 1 - 2 * derivative_to_optimize_) *
+       (constraint_powers.asDiagonal() * unit_cost_block_ *
+        constraint_powers.asDiagonal());
 }
 
 template <int _N>
@@ -309,34 +560,121 @@ void PolynomialOptimization<_N>::constructR(
     Eigen::SparseMatrix<double>* R) const {
   CHECK_NOTNULL(R);
   typedef Eigen::Triplet<double> Triplet;
-  std::vector<Triplet> cost_unconstrained_triplets;
-  cost_unconstrained_triplets.reserve(N * N * n_segments_);
+  std::vector<Triplet> cost_triplets;
+  cost_triplets.reserve(N * N * n_segments_);
 
+  // [1]: R = C^T * H * C. C: constraint_reodering_ ; H: block-diagonal with
+  // the blocks A^{-T}QA^{-1}. As C only reorders, the entries of H are
+  // summed into R at the compact constraint indices.
+  SquareMatrix H;
   for (size_t i = 0; i < n_segments_; ++i) {
-    const SquareMatrix& Ai = inverse_mapping_matrices_[i];
-    const SquareMatrix& Q = cost_matrices_[i];
-    const SquareMatrix H = Ai.transpose() * Q * Ai;
-    const int start_pos = i * N;
-    for (int row = 0; row < N; ++row) {
-      for (int col = 0; col < N; ++col) {
-        cost_unconstrained_triplets.emplace_back(
-            Triplet(start_pos + row, start_pos + col, H(row, col)));
+    computeCostBlock(i, &H);
+    for (int col = 0; col < N; ++col) {
+      for (int row = 0; row < N; ++row) {
+        cost_triplets.emplace_back(constraint_indices_[i * N + row],
+                                   constraint_indices_[i * N + col],
+                                   H(row, col));
       }
     }
   }
-  Eigen::SparseMatrix<double> cost_unconstrained(N * n_segments_,
-                                                 N * n_segments_);
-  cost_unconstrained.setFromTriplets(cost_unconstrained_triplets.begin(),
-                                     cost_unconstrained_triplets.end());
+  const size_t n_constraints = n_fixed_constraints_ + n_free_constraints_;
+  R->resize(n_constraints, n_constraints);
+  R->setFromTriplets(cost_triplets.begin(), cost_triplets.end());
+}
 
-  // [1]: R = C^T * H * C. C: constraint_reodering_ ; H: cost_unconstrained,
-  // assembled from the block-H above.
-  *R = constraint_reordering_.transpose() * cost_unconstrained *
-       constraint_reordering_;
+template <int _N>
+void PolynomialOptimization<_N>::updateCostBlocks() {
+  // The blocks of the segments are independent, but neighboring segments
+  // add to the same entries of R, so only the products run in parallel.
+  parallelForSegments(n_segments_,
+                      [this](size_t i) { computeCostBlock(i, &cost_blocks_[i]); });
+
+  double* free_free_values = cost_free_free_.valuePtr();
+  double* free_fixed_values = cost_free_fixed_.valuePtr();
+  std::fill(free_free_values, free_free_values + cost_free_free_.nonZeros(),
+            0.0);
+  std::fill(free_fixed_values,
+            free_fixed_values + cost_free_fixed_.nonZeros(), 0.0);
+  const int* index = cost_value_indices_.data();
+  for (size_t i = 0; i < n_segments_; ++i) {
+    const double* H = cost_blocks_[i].data();
+    for (int k = 0; k < N * N; ++k, ++index) {
+      if (*index >= 0) {
+        free_free_values[*index] += H[k];
+      } else if (*index < -1) {
+        free_fixed_values[-2 - *index] += H[k];
+      }
+    }
+  }
 }
 
 template <int _N>
 bool PolynomialOptimization<_N>::solveLinear() {
+  if (time_normalization_) {
+    CholeskySolver solver;
+    return solveLinear(&solver, true);
+  }
+  LinearSolver solver;
+  return solveLinear(&solver, true);
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::solveLinear(CholeskySolver* solver,
+                                             bool analyze_pattern) {
+  CHECK_NOTNULL(solver);
+  CHECK(derivative_to_optimize_ >= 0 &&
+        derivative_to_optimize_ <= kHighestDerivativeToOptimize);
+  if (n_free_constraints_ == 0) {
+    DLOG(WARNING)
+        << "No free constraints set in the vertices. Polynomial can "
+           "not be optimized. Outputting fully constrained polynomial.";
+    updateSegmentsFromCompactConstraints();
+    return true;
+  }
+
+  updateCostBlocks();
+
+  // The free constraints are of different derivatives and thus scales.
+  // Equilibrating Rpp to a unit diagonal, s_i = 1 / sqrt(Rpp_ii), bounds its
+  // condition number well enough for a factorization without pivoting. The
+  // values of cost_free_free_ are scaled in place, updateCostBlocks()
+  // overwrites them on the next solve.
+  Eigen::VectorXd scaling = cost_free_free_.diagonal();
+  for (int i = 0; i < scaling.size(); ++i) {
+    scaling[i] = scaling[i] > 0.0 ? 1.0 / std::sqrt(scaling[i]) : 1.0;
+  }
+  for (int k = 0; k < cost_free_free_.outerSize(); ++k) {
+    for (Eigen::SparseMatrix<double>::InnerIterator it(cost_free_free_, k); it;
+         ++it) {
+      it.valueRef() *= scaling[it.row()] * scaling[k];
+    }
+  }
+  if (analyze_pattern) {
+    solver->analyzePattern(cost_free_free_);
+  }
+  solver->factorize(cost_free_free_);
+  if (solver->info() != Eigen::Success) {
+    LOG(WARNING) << "Could not factorize the cost matrix.";
+    return false;
+  }
+
+  // dp = -Rpp^-1 * Rpf * df = -S * (S Rpp S)^-1 * S * Rpf * df.
+  for (size_t dimension_idx = 0; dimension_idx < dimension_; ++dimension_idx) {
+    const Eigen::VectorXd df =
+        -scaling.cwiseProduct(cost_free_fixed_ *
+                              fixed_constraints_compact_[dimension_idx]);
+    free_constraints_compact_[dimension_idx] =
+        scaling.cwiseProduct(solver->solve(df));
+  }
+
+  updateSegmentsFromCompactConstraints();
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::solveLinear(LinearSolver* solver,
+                                             bool analyze_pattern) {
+  CHECK_NOTNULL(solver);
   CHECK(derivative_to_optimize_ >= 0 &&
         derivative_to_optimize_ <= kHighestDerivativeToOptimize);
   // Catch the fully constrained case:
@@ -351,33 +689,228 @@ bool PolynomialOptimization<_N>::solveLinear() {
   // TODO(acmarkus): figure out if sparse becomes less efficient for small
   // problems, and switch back to dense in case.
 
-  // Compute cost matrix for the unconstrained optimization problem.
+  // Compute the blocks of the cost matrix R of the free constraints.
   // Block-wise H = A^{-T}QA^{-1} according to [1]
-  Eigen::SparseMatrix<double> R;
-  constructR(&R);
-
-  // Extract block matrices and prepare solver.
-  Eigen::SparseMatrix<double> Rpf = R.block(
-      n_fixed_constraints_, 0, n_free_constraints_, n_fixed_constraints_);
-  Eigen::SparseMatrix<double> Rpp =
-      R.block(n_fixed_constraints_, n_fixed_constraints_, n_free_constraints_,
-              n_free_constraints_);
-  Eigen::SparseQR<Eigen::SparseMatrix<double>, Eigen::COLAMDOrdering<int>>
-      solver;
-  solver.compute(Rpp);
+  updateCostBlocks();
+  const Eigen::SparseMatrix<double>& Rpf = cost_free_fixed_;
+  const Eigen::SparseMatrix<double>& Rpp = cost_free_free_;
+  if (analyze_pattern) {
+    solver->analyzePattern(Rpp);
+  }
+  solver->factorize(Rpp);
 
   // Compute dp_opt for every dimension.
   for (size_t dimension_idx = 0; dimension_idx < dimension_; ++dimension_idx) {
     Eigen::VectorXd df =
         -Rpf * fixed_constraints_compact_[dimension_idx];  // Rpf = Rfp^T
     free_constraints_compact_[dimension_idx] =
-        solver.solve(df);  // dp = -Rpp^-1 * Rpf * df
+        solver->solve(df);  // dp = -Rpp^-1 * Rpf * df
   }
 
   updateSegmentsFromCompactConstraints();
   return true;
 }
 
+template <int _N>
+bool PolynomialOptimization<_N>::addDerivativeBound(
+    size_t segment_idx, double relative_time, int derivative,
+    size_t dimension_idx, double lower, double upper) {
+  if (segment_idx >= n_segments_ || dimension_idx >= dimension_ ||
+      derivative < 0 || derivative >= N || relative_time < 0.0 ||
+      relative_time > 1.0 || lower > upper) {
+    LOG(WARNING) << "Invalid derivative bound.";
+    return false;
+  }
+  DerivativeBound bound;
+  bound.segment_idx = segment_idx;
+  bound.dimension_idx = dimension_idx;
+  bound.derivative = derivative;
+  bound.control_point_idx = -1;
+  bound.relative_time = relative_time;
+  bound.lower = lower;
+  bound.upper = upper;
+  derivative_bounds_.push_back(bound);
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::addDerivativeBoundsAtCollocationPoints(
+    int derivative, double lower, double upper, size_t n_points) {
+  if (n_points < 2) {
+    LOG(WARNING) << "At least start and end of a segment are needed.";
+    return false;
+  }
+  for (size_t segment_idx = 0; segment_idx < n_segments_; ++segment_idx) {
+    for (size_t dimension_idx = 0; dimension_idx < dimension_;
+         ++dimension_idx) {
+      for (size_t i = 0; i < n_points; ++i) {
+        if (!addDerivativeBound(segment_idx,
+                                static_cast<double>(i) / (n_points - 1),
+                                derivative, dimension_idx, lower, upper)) {
+          return false;
+        }
+      }
+    }
+  }
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::addDerivativeBoundsOnControlPoints(
+    int derivative, double lower, double upper) {
+  if (derivative < 0 || derivative >= N || lower > upper) {
+    LOG(WARNING) << "Invalid derivative bound.";
+    return false;
+  }
+  // The derivative is a polynomial of degree N - 1 - derivative with one
+  // more control point.
+  const int n_control_points = N - derivative;
+  for (size_t segment_idx = 0; segment_idx < n_segments_; ++segment_idx) {
+    for (size_t dimension_idx = 0; dimension_idx < dimension_;
+         ++dimension_idx) {
+      for (int j = 0; j < n_control_points; ++j) {
+        DerivativeBound bound;
+        bound.segment_idx = segment_idx;
+        bound.dimension_idx = dimension_idx;
+        bound.derivative = derivative;
+        bound.control_point_idx = j;
+        bound.relative_time = 0.0;
+        bound.lower = lower;
+        bound.upper = upper;
+        derivative_bounds_.push_back(bound);
+      }
+    }
+  }
+  return true;
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::clearDerivativeBounds() {
+  derivative_bounds_.clear();
+  qp_states_.clear();
+}
+
+template <int _N>
+void PolynomialOptimization<_N>::computeDerivativeBoundRow(
+    const DerivativeBound& bound, Eigen::Matrix<double, N, 1>* row) const {
+  CHECK_NOTNULL(row);
+  const double segment_time = segment_times_[bound.segment_idx];
+  if (bound.control_point_idx < 0) {
+    *row = Polynomial::baseCoeffsWithTime(N, bound.derivative,
+                                          bound.relative_time * segment_time);
+    return;
+  }
+
+  // With s = t / T, the derivative is sum_i a_i * T^i * s^i, where
+  // a_i = c_{i + k} * (i + k)! / i! are its coefficients in t. The Bernstein
+  // control points of degree m are b_j = sum_{i <= j} C(j, i) / C(m, i) *
+  // a_i * T^i.
+  const int k = bound.derivative;
+  const int m = N - 1 - k;
+  const int j = bound.control_point_idx;
+  const Eigen::VectorXd factorials = Polynomial::baseCoeffsWithTime(N, k, 1.0);
+  row->setZero();
+  double binomial_j_i = 1.0;  // C(j, i)
+  double binomial_m_i = 1.0;  // C(m, i)
+  double time_power = 1.0;    // T^i
+  for (int i = 0; i <= j; ++i) {
+    (*row)[i + k] = binomial_j_i / binomial_m_i * time_power * factorials[i + k];
+    binomial_j_i *= static_cast<double>(j - i) / (i + 1);
+    binomial_m_i *= static_cast<double>(m - i) / (i + 1);
+    time_power *= segment_time;
+  }
+}
+
+template <int _N>
+bool PolynomialOptimization<_N>::solveQP(
+    const AdmmQpParameters& parameters,
+    std::vector<AdmmQpSolver::Info>* infos) {
+  CHECK(derivative_to_optimize_ >= 0 &&
+        derivative_to_optimize_ <= kHighestDerivativeToOptimize);
+  if (infos != nullptr) {
+    infos->assign(dimension_, AdmmQpSolver::Info());
+  }
+  if (n_free_constraints_ == 0) {
+    DLOG(WARNING)
+        << "No free constraints set in the vertices. Polynomial can "
+           "not be optimized. Outputting fully constrained polynomial.";
+    updateSegmentsFromCompactConstraints();
+    return true;
+  }
+
+  updateCostBlocks();
+  const Eigen::SparseMatrix<double>& Rpf = cost_free_fixed_;
+  const Eigen::SparseMatrix<double>& Rpp = cost_free_free_;
+
+  // Maps every bound to the constraints: w^T c = w^T A^-1 C_s d, where C_s
+  // are the rows of the reordering matrix of the segment. The columns of
+  // the transposed reordering matrix are cheap to extract.
+  const Eigen::SparseMatrix<double> reordering_transposed =
+      constraint_reordering_.transpose();
+  std::vector<Eigen::SparseVector<double> > bound_rows(
+      derivative_bounds_.size());
+  Eigen::Matrix<double, N, 1> row;
+  for (size_t i = 0; i < derivative_bounds_.size(); ++i) {
+    const DerivativeBound& bound = derivative_bounds_[i];
+    computeDerivativeBoundRow(bound, &row);
+    const Eigen::Matrix<double, N, 1> mapped_row =
+        inverse_mapping_matrices_[bound.segment_idx].transpose() * row;
+    const Eigen::VectorXd bound_row =
+        reordering_transposed.middleCols(bound.segment_idx * N, N) *
+        mapped_row;
+    bound_rows[i] = bound_row.sparseView();
+  }
+
+  qp_states_.resize(dimension_);
+  AdmmQpSolver solver(parameters);
+  bool success = true;
+  typedef Eigen::Triplet<double> Triplet;
+  std::vector<Triplet> triplets;
+  for (size_t dimension_idx = 0; dimension_idx < dimension_; ++dimension_idx) {
+    const Eigen::VectorXd& df = fixed_constraints_compact_[dimension_idx];
+
+    // Rows of the bounds on this dimension, shifted by the contribution of
+    // the fixed constraints.
+    triplets.clear();
+    std::vector<double> lower, upper;
+    for (size_t i = 0; i < derivative_bounds_.size(); ++i) {
+      const DerivativeBound& bound = derivative_bounds_[i];
+      if (bound.dimension_idx != dimension_idx) {
+        continue;
+      }
+      const int row_idx = lower.size();
+      double offset = 0.0;
+      for (Eigen::SparseVector<double>::InnerIterator it(bound_rows[i]); it;
+           ++it) {
+        if (it.index() < static_cast<int>(n_fixed_constraints_)) {
+          offset += it.value() * df[it.index()];
+        } else {
+          triplets.emplace_back(row_idx, it.index() - n_fixed_constraints_,
+                                it.value());
+        }
+      }
+      lower.push_back(bound.lower - offset);
+      upper.push_back(bound.upper - offset);
+    }
+    Eigen::SparseMatrix<double> G(lower.size(), n_free_constraints_);
+    G.setFromTriplets(triplets.begin(), triplets.end());
+
+    AdmmQpSolver::Info info;
+    success &= solver.solve(
+        Rpp, Rpf * df, G,
+        Eigen::Map<const Eigen::VectorXd>(lower.data(), lower.size()),
+        Eigen::Map<const Eigen::VectorXd>(upper.data(), upper.size()),
+        &qp_states_[dimension_idx], &info);
+    free_constraints_compact_[dimension_idx] = qp_states_[dimension_idx].x;
+    if (infos != nullptr) {
+      (*infos)[dimension_idx] = info;
+    }
+  }
+
+  updateSegmentsFromCompactConstraints();
+  return success;
+}
+
 template <int _N>
 void PolynomialOptimization<_N>::printReorderingMatrix(
     std::ostream& stream) const {
@@ -455,23 +988,39 @@ Extremum PolynomialOptimization<_N>::computeMaximumOfMagnitude(
     int derivative, std::vector<Extremum>* candidates) const {
   if (candidates != nullptr) candidates->clear();
 
-  int segment_idx = 0;
   Extremum extremum;
-  for (const Segment& s : segments_) {
+  if (!runsSegmentsInParallel(n_segments_)) {
     std::vector<double> extrema_times;
-    extrema_times.reserve(N - 1);
-    // Add the beginning as well. Call below appends its extrema.
-    extrema_times.push_back(0.0);
-    computeSegmentMaximumMagnitudeCandidates(derivative, s, 0.0, s.getTime(),
-                                             &extrema_times);
-
-    for (double t : extrema_times) {
-      const Extremum candidate(t, s.evaluate(t, derivative).norm(),
-                               segment_idx);
+    extrema_times.reserve(N);
+    for (size_t segment_idx = 0; segment_idx < n_segments_; ++segment_idx) {
+      const Extremum candidate = computeSegmentMaximumOfMagnitude(
+          derivative, segment_idx, &extrema_times, candidates);
       if (extremum < candidate) extremum = candidate;
-      if (candidates != nullptr) candidates->emplace_back(candidate);
     }
-    ++segment_idx;
+  } else {
+    // Every segment stores its maximum (and candidates) separately. The
+    // reduction below runs in segment order and thus selects the same
+    // extremum among equal values as the serial search.
+    std::vector<Extremum> segment_maxima(n_segments_);
+    std::vector<std::vector<Extremum> > segment_candidates(
+        candidates != nullptr ? n_segments_ : 0);
+    parallelForSegments(n_segments_, [&](size_t segment_idx) {
+      // Kept per thread across calls to avoid allocations.
+      static thread_local std::vector<double> extrema_times;
+      segment_maxima[segment_idx] = computeSegmentMaximumOfMagnitude(
+          derivative, segment_idx, &extrema_times,
+          candidates != nullptr ? &segment_candidates[segment_idx] : nullptr);
+    });
+    for (size_t segment_idx = 0; segment_idx < n_segments_; ++segment_idx) {
+      if (extremum < segment_maxima[segment_idx]) {
+        extremum = segment_maxima[segment_idx];
+      }
+      if (candidates != nullptr) {
+        candidates->insert(candidates->end(),
+                           segment_candidates[segment_idx].begin(),
+                           segment_candidates[segment_idx].end());
+      }
+    }
   }
   // Check last time at last segment.
   const Extremum candidate(
@@ -484,6 +1033,26 @@ Extremum PolynomialOptimization<_N>::computeMaximumOfMagnitude(
   return extremum;
 }
 
+template <int _N>
+Extremum PolynomialOptimization<_N>::computeSegmentMaximumOfMagnitude(
+    int derivative, size_t segment_idx, std::vector<double>* extrema_times,
+    std::vector<Extremum>* candidates) const {
+  const Segment& s = segments_[segment_idx];
+  extrema_times->clear();
+  // Add the beginning as well. Call below appends its extrema.
+  extrema_times->push_back(0.0);
+  computeSegmentMaximumMagnitudeCandidates(derivative, s, 0.0, s.getTime(),
+                                           extrema_times);
+
+  Extremum extremum;
+  for (double t : *extrema_times) {
+    const Extremum candidate(t, s.evaluate(t, derivative).norm(), segment_idx);
+    if (extremum < candidate) extremum = candidate;
+    if (candidates != nullptr) candidates->emplace_back(candidate);
+  }
+  return extremum;
+}
+
 template <int _N>
 void PolynomialOptimization<_N>::setFreeConstraints(
     const std::vector<Eigen::VectorXd>& free_constraints) {
@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_IMPL_H_
+#define MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_IMPL_H_
+
+namespace mav_trajectory_generation {
+
+template <int _N>
+PolynomialOptimizationGroup<_N>::PolynomialOptimizationGroup(
+    const Vertex::Vector& vertices, int derivative_to_optimize)
+    : dimension_(vertices.empty() ? 0 : vertices.front().D()),
+      vertices_(vertices),
+      derivative_to_optimize_(derivative_to_optimize),
+      optimization_(dimension_) {
+  CHECK(!vertices_.empty()) << "A group needs vertices.";
+}
+
+template <int _N>
+bool PolynomialOptimizationGroup<_N>::setup(
+    const std::vector<double>& segment_times) {
+  return optimization_.setupFromVertices(vertices_, segment_times,
+                                         derivative_to_optimize_);
+}
+
+template <int _N>
+void PolynomialOptimizationGroup<_N>::updateSegmentTimes(
+    const std::vector<double>& segment_times) {
+  optimization_.updateSegmentTimes(segment_times);
+}
+
+template <int _N>
+bool PolynomialOptimizationGroup<_N>::solveLinear() {
+  return optimization_.solveLinear();
+}
+
+template <int _N>
+double PolynomialOptimizationGroup<_N>::computeCost() const {
+  return optimization_.computeCost();
+}
+
+template <int _N>
+void PolynomialOptimizationGroup<_N>::getTrajectory(
+    Trajectory* trajectory) const {
+  optimization_.getTrajectory(trajectory);
+}
+
+template <int N>
+size_t PolynomialOptimizationMultiGroup::addGroup(
+    const Vertex::Vector& vertices, int derivative_to_optimize) {
+  return addGroup(std::unique_ptr<PolynomialOptimizationGroupBase>(
+      new PolynomialOptimizationGroup<N>(vertices, derivative_to_optimize)));
+}
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_IMPL_H_
@@ -0,0 +1,166 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_IMPL_H_
+#define MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_IMPL_H_
+
+#include <numeric>
+
+namespace mav_trajectory_generation {
+
+template <int _N>
+PolynomialOptimizationMultiResolution<_N>::
+    PolynomialOptimizationMultiResolution(
+        size_t dimension, const NonlinearOptimizationParameters& parameters,
+        const MultiResolutionParameters& resolution_parameters)
+    : dimension_(dimension),
+      optimization_parameters_(parameters),
+      resolution_parameters_(resolution_parameters),
+      derivative_to_optimize_(
+          PolynomialOptimization<N>::kHighestDerivativeToOptimize) {
+  CHECK_GE(resolution_parameters_.subsampling, 2u);
+  CHECK_GT(resolution_parameters_.min_segments, 0u);
+}
+
+template <int _N>
+bool PolynomialOptimizationMultiResolution<_N>::setupFromVertices(
+    const Vertex::Vector& vertices, const std::vector<double>& segment_times,
+    int derivative_to_optimize) {
+  CHECK_EQ(vertices.size(), segment_times.size() + 1)
+      << "Size of segment times must be one less than vertices.";
+  if (vertices.size() < 2) {
+    LOG(ERROR) << "At least two vertices are required.";
+    return false;
+  }
+  vertices_ = vertices;
+  segment_times_ = segment_times;
+  derivative_to_optimize_ = derivative_to_optimize;
+  level_infos_.clear();
+  trajectory_.clear();
+  computeLevels();
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimizationMultiResolution<_N>::addMaximumMagnitudeConstraint(
+    int derivative, double maximum_value) {
+  CHECK_GE(derivative, 0);
+  CHECK_GE(maximum_value, 0.0);
+  maximum_magnitude_constraints_[derivative] = maximum_value;
+  return true;
+}
+
+template <int _N>
+void PolynomialOptimizationMultiResolution<_N>::computeLevels() {
+  level_vertex_indices_.clear();
+  std::vector<size_t> indices(vertices_.size());
+  for (size_t i = 0; i < indices.size(); ++i) indices[i] = i;
+  level_vertex_indices_.push_back(indices);
+
+  const size_t subsampling = resolution_parameters_.subsampling;
+  const size_t max_levels = resolution_parameters_.max_levels;
+  while (max_levels == 0 || level_vertex_indices_.size() < max_levels) {
+    const std::vector<size_t>& finer = level_vertex_indices_.back();
+    if ((finer.size() - 1) / subsampling < resolution_parameters_.min_segments) {
+      break;
+    }
+    std::vector<size_t> coarser;
+    for (size_t j = 0; j < finer.size(); ++j) {
+      const Vertex& vertex = vertices_[finer[j]];
+      const bool locked =
+          !vertex.hasConstraint(derivative_order::POSITION) ||
+          vertex.getNumberOfConstraints() > 1;
+      if (j % subsampling == 0 || j + 1 == finer.size() || locked) {
+        coarser.push_back(finer[j]);
+      }
+    }
+    // Stop if locked vertices prevent any reduction.
+    if (coarser.size() == finer.size()) break;
+    level_vertex_indices_.push_back(coarser);
+  }
+}
+
+template <int _N>
+int PolynomialOptimizationMultiResolution<_N>::optimize() {
+  CHECK(!vertices_.empty()) << "Call setupFromVertices() first.";
+  level_infos_.assign(level_vertex_indices_.size(), OptimizationInfo());
+
+  // Optimized times of the segments between the vertices of the last
+  // optimized level, at full resolution.
+  std::vector<double> segment_times = segment_times_;
+  int result = nlopt::FAILURE;
+  for (int level = static_cast<int>(level_vertex_indices_.size()) - 1;
+       level >= 0; --level) {
+    const std::vector<size_t>& indices = level_vertex_indices_[level];
+    Vertex::Vector vertices;
+    vertices.reserve(indices.size());
+    std::vector<double> times;
+    times.reserve(indices.size() - 1);
+    for (size_t j = 0; j < indices.size(); ++j) {
+      vertices.push_back(vertices_[indices[j]]);
+      if (j + 1 < indices.size()) {
+        times.push_back(std::accumulate(segment_times.begin() + indices[j],
+                                        segment_times.begin() + indices[j + 1],
+                                        0.0));
+      }
+    }
+
+    NonlinearOptimizationParameters parameters = optimization_parameters_;
+    if (level + 1 < static_cast<int>(level_vertex_indices_.size())) {
+      parameters.max_iterations = resolution_parameters_.refinement_iterations;
+    }
+    PolynomialOptimizationNonLinear<N> nonlinear_opt(dimension_, parameters);
+    nonlinear_opt.setupFromVertices(vertices, times, derivative_to_optimize_);
+    for (const std::pair<const int, double>& constraint :
+         maximum_magnitude_constraints_) {
+      nonlinear_opt.addMaximumMagnitudeConstraint(constraint.first,
+                                                  constraint.second);
+    }
+    result = nonlinear_opt.optimize();
+    level_infos_[level] = nonlinear_opt.getOptimizationInfo();
+
+    // Distribute the optimized time of every segment of this level over the
+    // full resolution segments it covers, proportionally to their times.
+    std::vector<double> optimized_times;
+    nonlinear_opt.getPolynomialOptimizationRef().getSegmentTimes(
+        &optimized_times);
+    for (size_t j = 0; j + 1 < indices.size(); ++j) {
+      const double scaling = optimized_times[j] / times[j];
+      for (size_t i = indices[j]; i < indices[j + 1]; ++i) {
+        segment_times[i] *= scaling;
+      }
+    }
+    if (level == 0) {
+      nonlinear_opt.getTrajectory(&trajectory_);
+    }
+  }
+  return result;
+}
+
+template <int _N>
+void PolynomialOptimizationMultiResolution<_N>::getTrajectory(
+    Trajectory* trajectory) const {
+  CHECK_NOTNULL(trajectory);
+  *trajectory = trajectory_;
+}
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_IMPL_H_
@@ -18,10 +18,13 @@
 #ifndef MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_NONLINEAR_IMPL_H_
 #define MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_NONLINEAR_IMPL_H_
 
+#include <algorithm>
 #include <chrono>
+#include <limits>
 #include <numeric>
 
 #include "mav_trajectory_generation/polynomial_optimization_linear.h"
+#include "mav_trajectory_generation/rpoly/rpoly_ak1.h"
 #include "mav_trajectory_generation/timing.h"
 
 namespace mav_trajectory_generation {
@@ -43,6 +46,20 @@ inline std::ostream& operator<<(std::ostream& stream,
            << m.second.value << " in segment " << m.second.segment_idx
            << " and segment time " << m.second.time << std::endl;
   }
+  for (int derivative : val.active_constraints) {
+    stream << "    active: " << positionDerivativeToString(derivative)
+           << std::endl;
+  }
+  for (const std::pair<const size_t, double>& v : val.corridor_violations) {
+    stream << "    corridor violation in segment " << v.first << ": "
+           << v.second << std::endl;
+  }
+  for (size_t i = 0; i < val.separation_minima.size(); ++i) {
+    const Extremum& m = val.separation_minima[i];
+    stream << "  separation to neighbour " << i << ": " << m.value
+           << " in segment " << m.segment_idx << " and segment time "
+           << m.time << std::endl;
+  }
   return stream;
 }
 
@@ -57,23 +74,61 @@ bool PolynomialOptimizationNonLinear<_N>::setupFromVertices(
     int derivative_to_optimize) {
   bool ret = poly_opt_.setupFromVertices(vertices, segment_times,
                                          derivative_to_optimize);
+  invalidateEvaluationCache();
+  setupNlopt();
+  return ret;
+}
 
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::reset() {
+  inequality_constraints_.clear();
+  corridor_constraints_.clear();
+  separation_constraints_.clear();
+  if (nlopt_ && nlopt_.use_count() == 1) {
+    nlopt_->remove_inequality_constraints();
+  }
+  optimization_info_ = OptimizationInfo();
+  invalidateEvaluationCache();
+}
+
+template <int _N>
+bool PolynomialOptimizationNonLinear<_N>::setupFromPolynomialOptimization(
+    const PolynomialOptimization<N>& poly_opt) {
+  CHECK_EQ(poly_opt.getDimension(), poly_opt_.getDimension());
+  poly_opt_ = poly_opt;
+  invalidateEvaluationCache();
+  setupNlopt();
+  return true;
+}
+
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::setupNlopt() {
+  const size_t n_segments = poly_opt_.getNumberSegments();
   size_t n_optimization_parameters;
   switch (optimization_parameters_.time_alloc_method) {
     case NonlinearOptimizationParameters::kSquaredTime:
     case NonlinearOptimizationParameters::kRichterTime:
     case NonlinearOptimizationParameters::kMellingerOuterLoop:
-      n_optimization_parameters = segment_times.size();
+    case NonlinearOptimizationParameters::kMinimumTime:
+      n_optimization_parameters = n_segments;
       break;
     default:
       n_optimization_parameters =
-          segment_times.size() +
+          n_segments +
           poly_opt_.getNumberFreeConstraints() * poly_opt_.getDimension();
       break;
   }
 
-  nlopt_.reset(new nlopt::opt(optimization_parameters_.algorithm,
-                              n_optimization_parameters));
+  // A shared nlopt object (after copying this object) is not reused, since
+  // its constraints and bounds would change for all owners.
+  if (nlopt_ && nlopt_.use_count() == 1 &&
+      nlopt_->get_algorithm() == optimization_parameters_.algorithm &&
+      nlopt_->get_dimension() == n_optimization_parameters) {
+    nlopt_->remove_inequality_constraints();
+  } else {
+    nlopt_.reset(new nlopt::opt(optimization_parameters_.algorithm,
+                                n_optimization_parameters));
+  }
   nlopt_->set_ftol_rel(optimization_parameters_.f_rel);
   nlopt_->set_ftol_abs(optimization_parameters_.f_abs);
   nlopt_->set_xtol_rel(optimization_parameters_.x_rel);
@@ -84,22 +139,24 @@ bool PolynomialOptimizationNonLinear<_N>::setupFromVertices(
     nlopt_srand_time();
   else
     nlopt_srand(optimization_parameters_.random_seed);
-
-  return ret;
 }
 
 template <int _N>
 bool PolynomialOptimizationNonLinear<_N>::solveLinear() {
+  invalidateEvaluationCache();
   return poly_opt_.solveLinear();
 }
 
 template <int _N>
 int PolynomialOptimizationNonLinear<_N>::optimize() {
   optimization_info_ = OptimizationInfo();
+  invalidateEvaluationCache();
+  trace_.setCapacity(optimization_parameters_.trace_capacity);
   int result = nlopt::FAILURE;
 
   const std::chrono::high_resolution_clock::time_point t_start =
       std::chrono::high_resolution_clock::now();
+  optimization_start_ = t_start;
 
   switch (optimization_parameters_.time_alloc_method) {
     case NonlinearOptimizationParameters::kSquaredTime:
@@ -113,10 +170,24 @@ int PolynomialOptimizationNonLinear<_N>::optimize() {
     case NonlinearOptimizationParameters::kMellingerOuterLoop:
       result = optimizeTimeMellingerOuterLoop();
       break;
+    case NonlinearOptimizationParameters::kMinimumTime:
+      result = optimizeMinimumTime();
+      break;
     default:
       break;
   }
 
+  // kIntegralViolation does not search the maxima during the optimization,
+  // so they are reported for the final solution only.
+  if (optimization_parameters_.soft_constraint_method ==
+      NonlinearOptimizationParameters::kIntegralViolation) {
+    for (const std::shared_ptr<ConstraintData>& constraint :
+         inequality_constraints_) {
+      optimization_info_.maxima[constraint->derivative] =
+          poly_opt_.computeMaximumOfMagnitude(constraint->derivative, nullptr);
+    }
+  }
+
   const std::chrono::high_resolution_clock::time_point t_stop =
       std::chrono::high_resolution_clock::now();
   optimization_info_.optimization_time =
@@ -141,30 +212,15 @@ int PolynomialOptimizationNonLinear<_N>::optimizeTime() {
     initial_step.push_back(optimization_parameters_.initial_stepsize_rel * t);
   }
 
-  try {
-    // Set a lower bound on the segment time per segment to avoid numerical
-    // issues.
-    nlopt_->set_initial_step(initial_step);
-    nlopt_->set_upper_bounds(std::numeric_limits<double>::max());
-    nlopt_->set_lower_bounds(kOptimizationTimeLowerBound);
-    nlopt_->set_min_objective(
-        &PolynomialOptimizationNonLinear<N>::objectiveFunctionTime, this);
-  } catch (std::exception& e) {
-    LOG(ERROR) << "error while setting up nlopt: " << e.what() << std::endl;
-    return nlopt::FAILURE;
-  }
-
-  double final_cost = std::numeric_limits<double>::max();
-  int result;
-
-  try {
-    result = nlopt_->optimize(segment_times, final_cost);
-  } catch (std::exception& e) {
-    LOG(ERROR) << "error while running nlopt: " << e.what() << std::endl;
-    return nlopt::FAILURE;
-  }
-
-  return result;
+  // Set a lower bound on the segment time per segment to avoid numerical
+  // issues.
+  const Eigen::VectorXd lower_bounds =
+      Eigen::VectorXd::Constant(n_segments, kOptimizationTimeLowerBound);
+  const Eigen::VectorXd upper_bounds = Eigen::VectorXd::Constant(
+      n_segments, std::numeric_limits<double>::max());
+  Eigen::VectorXd x =
+      Eigen::Map<const Eigen::VectorXd>(segment_times.data(), n_segments);
+  return minimizeTimeObjective(lower_bounds, upper_bounds, initial_step, &x);
 }
 
 template <int _N>
@@ -266,12 +322,14 @@ double PolynomialOptimizationNonLinear<_N>::getCost() const {
 template <int _N>
 double PolynomialOptimizationNonLinear<_N>::getTotalCostWithSoftConstraints()
     const {
+  // The linear problem may have been changed through
+  // getPolynomialOptimizationRef().
+  invalidateEvaluationCache();
   double cost_trajectory = poly_opt_.computeCost();
 
   // Use consistent cost metrics regardless of method set, to compare between
   // methods.
-  std::vector<double> segment_times;
-  poly_opt_.getSegmentTimes(&segment_times);
+  const std::vector<double>& segment_times = poly_opt_.getSegmentTimesRef();
   double total_time =
       std::accumulate(segment_times.begin(), segment_times.end(), 0.0);
   double cost_time =
@@ -279,6 +337,10 @@ double PolynomialOptimizationNonLinear<_N>::getTotalCostWithSoftConstraints()
   double cost_constraints = evaluateMaximumMagnitudeAsSoftConstraint(
       inequality_constraints_, optimization_parameters_.soft_constraint_weight,
       1e9);
+  cost_constraints += evaluateMinimumSeparationAsSoftConstraint(
+      optimization_parameters_.soft_constraint_weight, 1e9);
+  cost_constraints += evaluateCorridorAsSoftConstraint(
+      optimization_parameters_.soft_constraint_weight, 1e9);
 
   return cost_trajectory + cost_time + cost_constraints;
 }
@@ -393,6 +455,7 @@ void PolynomialOptimizationNonLinear<_N>::scaleSegmentTimesWithViolation() {
 
   std::vector<double> segment_times;
   segment_times = traj.getSegmentTimes();
+  invalidateEvaluationCache();
   poly_opt_.updateSegmentTimes(segment_times);
   poly_opt_.solveLinear();
 
@@ -452,9 +515,7 @@ int PolynomialOptimizationNonLinear<_N>::optimizeTimeAndFreeConstraints() {
 
   // Get the lower and upper bounds constraints on the free endpoint
   // derivatives
-  Vertex::Vector vertices;
-  poly_opt_.getVertices(&vertices);
-  setFreeEndpointDerivativeHardConstraints(vertices, &lower_bounds_free,
+  setFreeEndpointDerivativeHardConstraints(poly_opt_.getVerticesRef(), &lower_bounds_free,
                                            &upper_bounds_free);
 
   // Set segment time constraints
@@ -494,31 +555,248 @@ int PolynomialOptimizationNonLinear<_N>::optimizeTimeAndFreeConstraints() {
   CHECK_EQ(initial_solution.size(), initial_step.size());
   CHECK_EQ(initial_solution.size(), n_optimization_variables);
 
-  try {
-    nlopt_->set_initial_step(initial_step);
-    nlopt_->set_lower_bounds(lower_bounds);
-    nlopt_->set_upper_bounds(upper_bounds);
-    nlopt_->set_min_objective(&PolynomialOptimizationNonLinear<
-                                  N>::objectiveFunctionTimeAndConstraints,
-                              this);
-  } catch (std::exception& e) {
-    LOG(ERROR) << "error while setting up nlopt: " << e.what() << std::endl;
-    return nlopt::FAILURE;
+  Eigen::VectorXd x = Eigen::Map<const Eigen::VectorXd>(
+      initial_solution.data(), initial_solution.size());
+  timing::Timer timer_solve("optimize_nonlinear_full_total_time");
+  const int result = minimizeTimeObjective(
+      Eigen::Map<const Eigen::VectorXd>(lower_bounds.data(),
+                                        lower_bounds.size()),
+      Eigen::Map<const Eigen::VectorXd>(upper_bounds.data(),
+                                        upper_bounds.size()),
+      initial_step, &x);
+  timer_solve.Stop();
+  return result;
+}
+
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::recordTrace(
+    double cost_trajectory, double cost_time, double cost_soft_constraints) {
+  if (trace_.getCapacity() == 0) {
+    return;
+  }
+  OptimizationTraceEntry& entry = trace_.addEntry();
+  entry.iteration = optimization_info_.n_iterations;
+  entry.elapsed_time =
+      std::chrono::duration_cast<std::chrono::duration<double> >(
+          std::chrono::high_resolution_clock::now() - optimization_start_)
+          .count();
+  entry.cost_trajectory = cost_trajectory;
+  entry.cost_time = cost_time;
+  entry.cost_soft_constraints = cost_soft_constraints;
+  poly_opt_.getSegmentTimes(&entry.segment_times);
+}
+
+template <int _N>
+bool PolynomialOptimizationNonLinear<_N>::useNativeSolver() const {
+  if (optimization_parameters_.solver !=
+      NonlinearOptimizationParameters::kProjectedLbfgs) {
+    return false;
+  }
+  if (optimization_parameters_.time_alloc_method !=
+          NonlinearOptimizationParameters::kSquaredTime &&
+      optimization_parameters_.time_alloc_method !=
+          NonlinearOptimizationParameters::kRichterTime) {
+    // With the free derivatives as variables, every finite-difference
+    // gradient would cost one objective evaluation per variable.
+    LOG(WARNING) << "The projected L-BFGS solver only supports the time-only "
+                    "methods, falling back to nlopt.";
+    return false;
+  }
+  if (!optimization_parameters_.use_soft_constraints &&
+      !(inequality_constraints_.empty() && corridor_constraints_.empty() &&
+        separation_constraints_.empty())) {
+    LOG(WARNING) << "The projected L-BFGS solver does not support hard "
+                    "constraints, falling back to nlopt.";
+    return false;
+  }
+  return true;
+}
+
+template <int _N>
+int PolynomialOptimizationNonLinear<_N>::minimizeTimeObjective(
+    const Eigen::VectorXd& lower_bounds, const Eigen::VectorXd& upper_bounds,
+    const std::vector<double>& initial_step, Eigen::VectorXd* x) {
+  CHECK_NOTNULL(x);
+  CHECK_EQ(x->size(), lower_bounds.size());
+  CHECK_EQ(x->size(), upper_bounds.size());
+
+  BoundConstrainedOptimizer* optimizer = nullptr;
+  std::unique_ptr<NloptOptimizer> nlopt_optimizer;
+  if (useNativeSolver()) {
+    if (!native_optimizer_) {
+      native_optimizer_.reset(new ProjectedLbfgsOptimizer());
+    }
+    native_optimizer_->setWarmStart(optimization_parameters_.warm_start);
+    optimizer = native_optimizer_.get();
+  } else {
+    // nlopt_ holds the hard constraints, if any.
+    try {
+      nlopt_->set_initial_step(initial_step);
+    } catch (std::exception& e) {
+      LOG(ERROR) << "error while setting up nlopt: " << e.what() << std::endl;
+      return nlopt::FAILURE;
+    }
+    nlopt_optimizer.reset(new NloptOptimizer(nlopt_.get()));
+    optimizer = nlopt_optimizer.get();
   }
+  BoundConstrainedOptimizer::Tolerances tolerances;
+  tolerances.f_rel = optimization_parameters_.f_rel;
+  tolerances.x_rel = optimization_parameters_.x_rel;
+  tolerances.max_evaluations = optimization_parameters_.max_iterations;
+  optimizer->setTolerances(tolerances);
+
+  // The gradient, if the backend needs one, is computed by forward
+  // differences. Only the unperturbed points count as iterations.
+  const BoundConstrainedOptimizer::Objective objective =
+      BoundConstrainedOptimizer::withFiniteDifferenceGradient(
+          [this](const Eigen::Ref<const Eigen::VectorXd>& x_value) {
+            return evaluateTimeObjective(x_value, kIterate);
+          },
+          [this](const Eigen::Ref<const Eigen::VectorXd>& x_value) {
+            return evaluateTimeObjective(x_value, kProbe);
+          },
+          upper_bounds);
 
   double final_cost = std::numeric_limits<double>::max();
-  int result;
+  const int result = optimizer->minimize(objective, lower_bounds, upper_bounds,
+                                         x, &final_cost);
+  if (result == nlopt::FAILURE) {
+    return result;
+  }
 
-  try {
-    timing::Timer timer_solve("optimize_nonlinear_full_total_time");
+  // Leave the linear problem and the reported costs at the optimum rather
+  // than at the last evaluated point.
+  evaluateTimeObjective(*x, kOptimum);
+  return result;
+}
 
-    result = nlopt_->optimize(initial_solution, final_cost);
-    timer_solve.Stop();
-  } catch (std::exception& e) {
-    LOG(ERROR) << "error while running nlopt: " << e.what() << std::endl;
+template <int _N>
+bool PolynomialOptimizationNonLinear<_N>::solveAndCheckConstraints(
+    typename PolynomialOptimization<N>::LinearSolver* solver,
+    bool analyze_pattern) {
+  invalidateEvaluationCache();
+  poly_opt_.solveLinear(solver, analyze_pattern);
+  ++optimization_info_.n_iterations;
+
+  bool feasible = true;
+  for (const std::shared_ptr<ConstraintData>& constraint :
+       inequality_constraints_) {
+    const Extremum& max = getMaximumOfMagnitude(constraint->derivative);
+    optimization_info_.maxima[constraint->derivative] = max;
+    feasible &= max.value <= constraint->value;
+  }
+  for (const std::shared_ptr<CorridorConstraintData>& constraint :
+       corridor_constraints_) {
+    feasible &= computeCorridorViolation(*constraint) <= 0.0;
+  }
+  for (const std::shared_ptr<SeparationConstraintData>& constraint :
+       separation_constraints_) {
+    feasible &= computeSeparation(*constraint, getCurrentTrajectory()).value >=
+                constraint->minimum_distance;
+  }
+  return feasible;
+}
+
+template <int _N>
+int PolynomialOptimizationNonLinear<_N>::optimizeMinimumTime() {
+  if (inequality_constraints_.empty()) {
+    LOG(ERROR) << "Minimum-time allocation requires at least one maximum "
+                  "magnitude constraint.";
+    return nlopt::INVALID_ARGS;
+  }
+  const double tolerance = optimization_parameters_.minimum_time_tolerance_rel;
+  CHECK_GT(tolerance, 0.0);
+  CHECK_LT(tolerance, 1.0);
+  const int max_iterations = optimization_parameters_.max_iterations;
+
+  std::vector<double> segment_times;
+  poly_opt_.getSegmentTimes(&segment_times);
+  const size_t n_segments = segment_times.size();
+
+  typename PolynomialOptimization<N>::LinearSolver solver;
+  bool feasible = solveAndCheckConstraints(&solver, true);
+
+  // Scale all segment times uniformly. The magnitude of derivative k scales
+  // with s^-k for a time scaling s, which is exact as long as the vertices
+  // only constrain positions. Otherwise, a few iterations are needed.
+  constexpr int kMaxScalingIterations = 20;
+  std::vector<double> best_segment_times;
+  if (feasible) best_segment_times = segment_times;
+  for (int i = 0; i < kMaxScalingIterations; ++i) {
+    double scaling = 0.0;
+    for (const std::shared_ptr<ConstraintData>& constraint :
+         inequality_constraints_) {
+      if (constraint->derivative == derivative_order::POSITION) continue;
+      const double max = getMaximumOfMagnitude(constraint->derivative).value;
+      scaling = std::max(scaling, std::pow(max / constraint->value,
+                                           1.0 / constraint->derivative));
+    }
+    if (feasible && scaling > 1.0 - tolerance) break;
+    if (!feasible) scaling = std::max(scaling, 1.0 + tolerance);
+    if (scaling <= 0.0) break;
+
+    for (double& t : segment_times) {
+      t = std::max(kOptimizationTimeLowerBound, t * scaling);
+    }
+    poly_opt_.updateSegmentTimes(segment_times);
+    feasible = solveAndCheckConstraints(&solver, false);
+    if (feasible) best_segment_times = segment_times;
+  }
+  if (best_segment_times.empty()) {
+    LOG(WARNING) << "Could not find segment times that meet all constraints.";
     return nlopt::FAILURE;
   }
+  segment_times = best_segment_times;
+  poly_opt_.updateSegmentTimes(segment_times);
+
+  // Shorten one segment at a time by bisection between half its time and
+  // its current, feasible, time. Sweep until no segment could be shortened.
+  int result = nlopt::XTOL_REACHED;
+  bool improved = true;
+  while (improved && result != nlopt::MAXEVAL_REACHED) {
+    improved = false;
+    for (size_t i = 0; i < n_segments; ++i) {
+      if (max_iterations > 0 &&
+          optimization_info_.n_iterations >= max_iterations) {
+        result = nlopt::MAXEVAL_REACHED;
+        break;
+      }
+      double upper = segment_times[i];
+      double lower = std::max(kOptimizationTimeLowerBound, 0.5 * upper);
+      while (upper - lower > tolerance * upper) {
+        const double t = 0.5 * (lower + upper);
+        poly_opt_.updateSegmentTime(i, t);
+        if (solveAndCheckConstraints(&solver, false)) {
+          upper = t;
+        } else {
+          lower = t;
+        }
+      }
+      if (upper < segment_times[i] * (1.0 - tolerance)) improved = true;
+      segment_times[i] = upper;
+      poly_opt_.updateSegmentTime(i, upper);
+    }
+  }
+  solveAndCheckConstraints(&solver, false);
+
+  // A constraint is active if shortening all segments by twice the
+  // tolerance would violate it.
+  optimization_info_.active_constraints.clear();
+  for (const std::shared_ptr<ConstraintData>& constraint :
+       inequality_constraints_) {
+    const double threshold =
+        constraint->value *
+        std::pow(1.0 - 2.0 * tolerance, std::max(constraint->derivative, 1));
+    if (optimization_info_.maxima[constraint->derivative].value >= threshold) {
+      optimization_info_.active_constraints.push_back(constraint->derivative);
+    }
+  }
 
+  const double total_time =
+      std::accumulate(segment_times.begin(), segment_times.end(), 0.0);
+  optimization_info_.cost_trajectory = poly_opt_.computeCost();
+  optimization_info_.cost_time =
+      total_time * total_time * optimization_parameters_.time_penalty;
   return result;
 }
 
@@ -553,63 +831,173 @@ bool PolynomialOptimizationNonLinear<_N>::addMaximumMagnitudeConstraint(
 }
 
 template <int _N>
-double PolynomialOptimizationNonLinear<_N>::objectiveFunctionTime(
-    const std::vector<double>& segment_times, std::vector<double>& gradient,
-    void* data) {
-  CHECK(gradient.empty())
-      << "computing gradient not possible, choose a gradient free method";
-  CHECK_NOTNULL(data);
+bool PolynomialOptimizationNonLinear<_N>::addMinimumSeparationConstraint(
+    const std::vector<Trajectory>& neighbours, double minimum_distance) {
+  CHECK_GT(minimum_distance, 0.0);
+  const int n_position_dimensions =
+      std::min(static_cast<int>(poly_opt_.getDimension()), 3);
+
+  for (const Trajectory& neighbour : neighbours) {
+    if (neighbour.empty() || neighbour.D() < n_position_dimensions) {
+      LOG(WARNING) << "Neighbour trajectory is empty or has less than "
+                   << n_position_dimensions << " dimensions.";
+      return false;
+    }
+  }
 
-  PolynomialOptimizationNonLinear<N>* optimization_data =
-      static_cast<PolynomialOptimizationNonLinear<N>*>(data);  // wheee ...
+  for (const Trajectory& neighbour : neighbours) {
+    std::shared_ptr<SeparationConstraintData> constraint_data(
+        new SeparationConstraintData);
+    constraint_data->this_object = this;
+    constraint_data->neighbour_idx = separation_constraints_.size();
+    constraint_data->neighbour = neighbour;
+    constraint_data->minimum_distance = minimum_distance;
+
+    // Store the shared_ptrs such that their data will be destroyed later.
+    separation_constraints_.push_back(constraint_data);
+
+    if (!optimization_parameters_.use_soft_constraints) {
+      try {
+        nlopt_->add_inequality_constraint(
+            &PolynomialOptimizationNonLinear<
+                N>::evaluateMinimumSeparationConstraint,
+            constraint_data.get(),
+            optimization_parameters_.inequality_constraint_tolerance);
+      } catch (std::exception& e) {
+        LOG(ERROR) << "ERROR while setting inequality constraint " << e.what()
+                   << std::endl;
+        return false;
+      }
+    }
+  }
+  return true;
+}
 
-  CHECK_EQ(segment_times.size(),
-           optimization_data->poly_opt_.getNumberSegments());
+template <int _N>
+bool PolynomialOptimizationNonLinear<_N>::addCorridorConstraint(
+    size_t segment_idx, const Eigen::MatrixXd& A, const Eigen::VectorXd& b) {
+  const int n_position_dimensions =
+      std::min(static_cast<int>(poly_opt_.getDimension()), 3);
+  if (segment_idx >= poly_opt_.getNumberSegments()) {
+    LOG(WARNING) << "Segment " << segment_idx << " does not exist.";
+    return false;
+  }
+  if (A.cols() != n_position_dimensions || A.rows() != b.size()) {
+    LOG(WARNING) << "Corridor polytope has to be of size " << b.size() << "x"
+                 << n_position_dimensions << " but is " << A.rows() << "x"
+                 << A.cols() << ".";
+    return false;
+  }
 
-  optimization_data->poly_opt_.updateSegmentTimes(segment_times);
-  optimization_data->poly_opt_.solveLinear();
-  double cost_trajectory = optimization_data->poly_opt_.computeCost();
+  std::shared_ptr<CorridorConstraintData> constraint_data(
+      new CorridorConstraintData);
+  constraint_data->this_object = this;
+  constraint_data->segment_idx = segment_idx;
+  constraint_data->A = A;
+  constraint_data->b = b;
+  for (int j = 0; j < A.rows(); ++j) {
+    const double norm = A.row(j).norm();
+    if (norm <= 0.0) {
+      LOG(WARNING) << "Face " << j << " of the corridor has no normal.";
+      return false;
+    }
+    constraint_data->A.row(j) /= norm;
+    constraint_data->b[j] /= norm;
+  }
+
+  // Store the shared_ptrs such that their data will be destroyed later.
+  corridor_constraints_.push_back(constraint_data);
+
+  if (!optimization_parameters_.use_soft_constraints) {
+    try {
+      nlopt_->add_inequality_constraint(
+          &PolynomialOptimizationNonLinear<N>::evaluateCorridorConstraint,
+          constraint_data.get(),
+          optimization_parameters_.inequality_constraint_tolerance);
+    } catch (std::exception& e) {
+      LOG(ERROR) << "ERROR while setting inequality constraint " << e.what()
+                 << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimizationNonLinear<_N>::addCorridorConstraints(
+    const std::vector<std::pair<Eigen::MatrixXd, Eigen::VectorXd> >&
+        polytopes) {
+  if (polytopes.size() != poly_opt_.getNumberSegments()) {
+    LOG(WARNING) << "Number of polytopes (" << polytopes.size()
+                 << ") does not match number of segments ("
+                 << poly_opt_.getNumberSegments() << ").";
+    return false;
+  }
+  for (size_t i = 0; i < polytopes.size(); ++i) {
+    if (!addCorridorConstraint(i, polytopes[i].first, polytopes[i].second)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template <int _N>
+double PolynomialOptimizationNonLinear<_N>::evaluateTimeObjective(
+    const Eigen::Ref<const Eigen::VectorXd>& x, Evaluation evaluation) {
+  const size_t n_segments = poly_opt_.getNumberSegments();
+  CHECK_GE(static_cast<size_t>(x.size()), n_segments);
+
+  updateOptimizationVariables(x);
+  double cost_trajectory = poly_opt_.computeCost();
   double cost_time = 0;
   double cost_constraints = 0;
-  const double total_time = computeTotalTrajectoryTime(segment_times);
+  const double total_time = x.head(n_segments).sum();
 
-  switch (optimization_data->optimization_parameters_.time_alloc_method) {
+  switch (optimization_parameters_.time_alloc_method) {
     case NonlinearOptimizationParameters::kRichterTime:
-      cost_time =
-          total_time * optimization_data->optimization_parameters_.time_penalty;
+    case NonlinearOptimizationParameters::kRichterTimeAndConstraints:
+      cost_time = total_time * optimization_parameters_.time_penalty;
       break;
-    default:  // kSquaredTime
-      cost_time = total_time * total_time *
-                  optimization_data->optimization_parameters_.time_penalty;
+    default:  // kSquaredTime, kSquaredTimeAndConstraints
+      cost_time =
+          total_time * total_time * optimization_parameters_.time_penalty;
       break;
   }
 
-  if (optimization_data->optimization_parameters_.print_debug_info) {
-    std::cout << "---- cost at iteration "
-              << optimization_data->optimization_info_.n_iterations << "---- "
-              << std::endl;
+  const bool print_debug_info =
+      optimization_parameters_.print_debug_info && evaluation == kIterate;
+  if (print_debug_info) {
+    std::cout << "---- cost at iteration " << optimization_info_.n_iterations
+              << "---- " << std::endl;
     std::cout << "  trajectory: " << cost_trajectory << std::endl;
     std::cout << "  time: " << cost_time << std::endl;
   }
 
-  if (optimization_data->optimization_parameters_.use_soft_constraints) {
-    cost_constraints =
-        optimization_data->evaluateMaximumMagnitudeAsSoftConstraint(
-            optimization_data->inequality_constraints_,
-            optimization_data->optimization_parameters_.soft_constraint_weight);
+  if (optimization_parameters_.use_soft_constraints) {
+    cost_constraints = evaluateMaximumMagnitudeAsSoftConstraint(
+        inequality_constraints_,
+        optimization_parameters_.soft_constraint_weight);
+    cost_constraints += evaluateMinimumSeparationAsSoftConstraint(
+        optimization_parameters_.soft_constraint_weight);
+    cost_constraints += evaluateCorridorAsSoftConstraint(
+        optimization_parameters_.soft_constraint_weight);
   }
 
-  if (optimization_data->optimization_parameters_.print_debug_info) {
+  if (print_debug_info) {
     std::cout << "  sum: " << cost_trajectory + cost_time + cost_constraints
               << std::endl;
     std::cout << "  total time: " << total_time << std::endl;
   }
 
-  optimization_data->optimization_info_.n_iterations++;
-  optimization_data->optimization_info_.cost_trajectory = cost_trajectory;
-  optimization_data->optimization_info_.cost_time = cost_time;
-  optimization_data->optimization_info_.cost_soft_constraints =
-      cost_constraints;
+  if (evaluation == kIterate) {
+    recordTrace(cost_trajectory, cost_time, cost_constraints);
+    optimization_info_.n_iterations++;
+  }
+  if (evaluation != kProbe) {
+    optimization_info_.cost_trajectory = cost_trajectory;
+    optimization_info_.cost_time = cost_time;
+    optimization_info_.cost_soft_constraints = cost_constraints;
+  }
 
   return cost_trajectory + cost_time + cost_constraints;
 }
@@ -629,8 +1017,7 @@ PolynomialOptimizationNonLinear<_N>::objectiveFunctionTimeMellingerOuterLoop(
   CHECK_EQ(segment_times.size(),
            optimization_data->poly_opt_.getNumberSegments());
 
-  optimization_data->poly_opt_.updateSegmentTimes(segment_times);
-  optimization_data->poly_opt_.solveLinear();
+  optimization_data->updateOptimizationVariables(segment_times);
   double cost_trajectory;
   if (!gradient.empty()) {
     cost_trajectory = optimization_data->getCostAndGradientMellinger(&gradient);
@@ -650,6 +1037,7 @@ PolynomialOptimizationNonLinear<_N>::objectiveFunctionTimeMellingerOuterLoop(
     std::cout << "  sum: " << cost_trajectory << std::endl;
   }
 
+  optimization_data->recordTrace(cost_trajectory, 0.0, 0.0);
   optimization_data->optimization_info_.n_iterations++;
   optimization_data->optimization_info_.cost_trajectory = cost_trajectory;
 
@@ -657,135 +1045,290 @@ PolynomialOptimizationNonLinear<_N>::objectiveFunctionTimeMellingerOuterLoop(
 }
 
 template <int _N>
-double PolynomialOptimizationNonLinear<_N>::objectiveFunctionTimeAndConstraints(
-    const std::vector<double>& x, std::vector<double>& gradient, void* data) {
+double PolynomialOptimizationNonLinear<_N>::evaluateMaximumMagnitudeConstraint(
+    const std::vector<double>& optimization_variables,
+    std::vector<double>& gradient, void* data) {
   CHECK(gradient.empty())
       << "computing gradient not possible, choose a gradient-free method";
-  CHECK_NOTNULL(data);
-
+  ConstraintData* constraint_data =
+      static_cast<ConstraintData*>(data);  // wheee ...
   PolynomialOptimizationNonLinear<N>* optimization_data =
-      static_cast<PolynomialOptimizationNonLinear<N>*>(data);  // wheee ...
+      constraint_data->this_object;
 
-  const size_t n_segments = optimization_data->poly_opt_.getNumberSegments();
-  const size_t n_free_constraints =
-      optimization_data->poly_opt_.getNumberFreeConstraints();
-  const size_t dim = optimization_data->poly_opt_.getDimension();
+  optimization_data->updateOptimizationVariables(optimization_variables);
+  const Extremum& max =
+      optimization_data->getMaximumOfMagnitude(constraint_data->derivative);
 
-  CHECK_EQ(x.size(), n_segments + n_free_constraints * dim);
+  optimization_data->optimization_info_.maxima[constraint_data->derivative] =
+      max;
 
-  std::vector<Eigen::VectorXd> free_constraints;
-  free_constraints.resize(dim);
-  std::vector<double> segment_times;
-  segment_times.reserve(n_segments);
+  return max.value - constraint_data->value;
+}
 
-  for (size_t i = 0; i < n_segments; ++i) {
-    segment_times.push_back(x[i]);
+template <int _N>
+double
+PolynomialOptimizationNonLinear<_N>::evaluateMaximumMagnitudeAsSoftConstraint(
+    const std::vector<std::shared_ptr<ConstraintData> >& inequality_constraints,
+    double weight, double maximum_cost) const {
+  if (optimization_parameters_.soft_constraint_method ==
+      NonlinearOptimizationParameters::kIntegralViolation) {
+    return evaluateMaximumMagnitudeAsIntegralSoftConstraint(
+        optimization_parameters_.soft_constraint_integral_weight,
+        maximum_cost);
   }
 
-  for (size_t d = 0; d < dim; ++d) {
-    const size_t idx_start = n_segments + d * n_free_constraints;
+  double cost = 0;
+
+  if (optimization_parameters_.print_debug_info)
+    std::cout << "  soft_constraints: " << std::endl;
+
+  for (std::shared_ptr<const ConstraintData> constraint :
+       inequality_constraints_) {
+    const Extremum& max = getMaximumOfMagnitude(constraint->derivative);
+    constraint->this_object->optimization_info_.maxima[constraint->derivative] =
+        max;
+    double abs_violation = max.value - constraint->value;
 
-    Eigen::VectorXd& free_constraints_dim = free_constraints[d];
-    free_constraints_dim.resize(n_free_constraints, Eigen::NoChange);
-    for (size_t i = 0; i < n_free_constraints; ++i) {
-      free_constraints_dim[i] = x[idx_start + i];
+    double relative_violation = abs_violation / constraint->value;
+    const double current_cost =
+        std::min(maximum_cost, exp(relative_violation * weight));
+    cost += current_cost;
+    if (optimization_parameters_.print_debug_info) {
+      std::cout << "    derivative " << constraint->derivative
+                << " abs violation: " << abs_violation
+                << " : relative violation: " << relative_violation
+                << " cost: " << current_cost << std::endl;
     }
   }
+  return cost;
+}
 
-  optimization_data->poly_opt_.updateSegmentTimes(segment_times);
-  optimization_data->poly_opt_.setFreeConstraints(free_constraints);
+template <int _N>
+double PolynomialOptimizationNonLinear<_N>::
+    evaluateMaximumMagnitudeAsIntegralSoftConstraint(
+        double weight, double maximum_cost) const {
+  double cost = 0;
 
-  double cost_trajectory = optimization_data->poly_opt_.computeCost();
-  double cost_time = 0;
-  double cost_constraints = 0;
+  if (optimization_parameters_.print_debug_info)
+    std::cout << "  soft_constraints: " << std::endl;
 
-  const double total_time = computeTotalTrajectoryTime(segment_times);
-  switch (optimization_data->optimization_parameters_.time_alloc_method) {
-    case NonlinearOptimizationParameters::kRichterTimeAndConstraints:
-      cost_time =
-          total_time * optimization_data->optimization_parameters_.time_penalty;
-      break;
-    default:  // kSquaredTimeAndConstraints
-      cost_time = total_time * total_time *
-                  optimization_data->optimization_parameters_.time_penalty;
-      break;
-  }
+  // Horner's scheme for coefficients in increasing order.
+  auto evaluate = [](const Eigen::VectorXd& coefficients, double t) {
+    double result = 0.0;
+    for (int i = coefficients.size() - 1; i >= 0; --i) {
+      result = result * t + coefficients[i];
+    }
+    return result;
+  };
 
-  if (optimization_data->optimization_parameters_.print_debug_info) {
-    std::cout << "---- cost at iteration "
-              << optimization_data->optimization_info_.n_iterations << "---- "
-              << std::endl;
-    std::cout << "  trajectory: " << cost_trajectory << std::endl;
-    std::cout << "  time: " << cost_time << std::endl;
+  const Segment::Vector& segments = poly_opt_.getSegmentsRef();
+  std::vector<double> crossings;
+  Eigen::VectorXcd roots;
+  for (const std::shared_ptr<ConstraintData>& constraint :
+       inequality_constraints_) {
+    const int n_d = N - constraint->derivative;
+    const double squared_limit = constraint->value * constraint->value;
+
+    double integral = 0.0;
+    for (const Segment& segment : segments) {
+      // exceedance(t) = |d(t)|^2 - max^2.
+      Eigen::VectorXd exceedance =
+          Eigen::VectorXd::Zero(Polynomial::getConvolutionLength(n_d, n_d));
+      for (int dim = 0; dim < segment.D(); ++dim) {
+        const Eigen::VectorXd d =
+            segment[dim].getCoefficients(constraint->derivative).head(n_d);
+        exceedance += Polynomial::convolve(d, d);
+      }
+      exceedance[0] -= squared_limit;
+      // Antiderivative of exceedance(t)^2, without the constant.
+      const Eigen::VectorXd squared =
+          Polynomial::convolve(exceedance, exceedance);
+      Eigen::VectorXd antiderivative =
+          Eigen::VectorXd::Zero(squared.size() + 1);
+      for (int i = 0; i < squared.size(); ++i) {
+        antiderivative[i + 1] = squared[i] / (i + 1);
+      }
+
+      const double segment_time = segment.getTime();
+      crossings.clear();
+      crossings.push_back(0.0);
+      crossings.push_back(segment_time);
+      if (findRootsJenkinsTraub(exceedance, &roots)) {
+        for (int i = 0; i < roots.size(); ++i) {
+          if (std::abs(roots[i].imag()) <=
+                  std::numeric_limits<double>::epsilon() &&
+              roots[i].real() > 0.0 && roots[i].real() < segment_time) {
+            crossings.push_back(roots[i].real());
+          }
+        }
+      }
+      std::sort(crossings.begin(), crossings.end());
+
+      for (size_t i = 0; i + 1 < crossings.size(); ++i) {
+        const double t_start = crossings[i];
+        const double t_end = crossings[i + 1];
+        if (evaluate(exceedance, 0.5 * (t_start + t_end)) > 0.0) {
+          integral += evaluate(antiderivative, t_end) -
+                      evaluate(antiderivative, t_start);
+        }
+      }
+    }
+
+    const double relative_integral =
+        std::max(0.0, integral) / (squared_limit * squared_limit);
+    const double current_cost =
+        std::min(maximum_cost, weight * relative_integral);
+    cost += current_cost;
+    if (optimization_parameters_.print_debug_info) {
+      std::cout << "    derivative " << constraint->derivative
+                << " integral of relative squared exceedance: "
+                << relative_integral << " cost: " << current_cost
+                << std::endl;
+    }
   }
+  return cost;
+}
 
-  if (optimization_data->optimization_parameters_.use_soft_constraints) {
-    cost_constraints =
-        optimization_data->evaluateMaximumMagnitudeAsSoftConstraint(
-            optimization_data->inequality_constraints_,
-            optimization_data->optimization_parameters_.soft_constraint_weight);
+template <int _N>
+double PolynomialOptimizationNonLinear<_N>::computeCorridorViolation(
+    const CorridorConstraintData& constraint) {
+  const Segment& segment = constraint.this_object->poly_opt_.getSegmentsRef()
+                               [constraint.segment_idx];
+
+  // The projection of the segment onto the normal of a face is a polynomial
+  // again. Its maximum over the segment is the largest signed distance to
+  // the face.
+  double violation = std::numeric_limits<double>::lowest();
+  Eigen::VectorXd coefficients(segment.N());
+  std::pair<double, double> minimum, maximum;
+  for (int j = 0; j < constraint.A.rows(); ++j) {
+    coefficients.setZero();
+    for (int k = 0; k < constraint.A.cols(); ++k) {
+      coefficients += constraint.A(j, k) * segment[k].getCoefficients();
+    }
+    coefficients[0] -= constraint.b[j];
+    const Polynomial projection(coefficients);
+    if (projection.computeMinMax(0.0, segment.getTime(),
+                                 derivative_order::POSITION, &minimum,
+                                 &maximum)) {
+      violation = std::max(violation, maximum.second);
+      continue;
+    }
+    // Without the extrema, the face is checked at the segment end points and
+    // at evenly spaced samples in between, such that it is never silently
+    // treated as satisfied.
+    LOG(WARNING) << "Could not compute the extrema of corridor face " << j
+                 << " of segment " << constraint.segment_idx
+                 << ", falling back to sampling.";
+    const int n_samples = 2 * segment.N();
+    for (int i = 0; i <= n_samples; ++i) {
+      violation = std::max(
+          violation, projection.evaluate(segment.getTime() * i / n_samples,
+                                         derivative_order::POSITION));
+    }
   }
 
-  if (optimization_data->optimization_parameters_.print_debug_info) {
-    std::cout << "  sum: " << cost_trajectory + cost_time + cost_constraints
-              << std::endl;
-    std::cout << "  total time: " << total_time << std::endl;
+  constraint.this_object->optimization_info_
+      .corridor_violations[constraint.segment_idx] = violation;
+  return violation;
+}
+
+template <int _N>
+double PolynomialOptimizationNonLinear<_N>::evaluateCorridorConstraint(
+    const std::vector<double>& optimization_variables,
+    std::vector<double>& gradient, void* data) {
+  CHECK(gradient.empty())
+      << "computing gradient not possible, choose a gradient-free method";
+  CorridorConstraintData* constraint_data =
+      static_cast<CorridorConstraintData*>(data);  // wheee ...
+  constraint_data->this_object->updateOptimizationVariables(
+      optimization_variables);
+  return computeCorridorViolation(*constraint_data);
+}
+
+template <int _N>
+double PolynomialOptimizationNonLinear<_N>::evaluateCorridorAsSoftConstraint(
+    double weight, double maximum_cost) const {
+  double cost = 0;
+  for (const std::shared_ptr<CorridorConstraintData>& constraint :
+       corridor_constraints_) {
+    const double violation = computeCorridorViolation(*constraint);
+    const double current_cost =
+        std::min(maximum_cost, exp(violation * weight));
+    cost += current_cost;
+    if (optimization_parameters_.print_debug_info) {
+      std::cout << "    corridor of segment " << constraint->segment_idx
+                << " violation: " << violation << " cost: " << current_cost
+                << std::endl;
+    }
   }
+  return cost;
+}
 
-  optimization_data->optimization_info_.n_iterations++;
-  optimization_data->optimization_info_.cost_trajectory = cost_trajectory;
-  optimization_data->optimization_info_.cost_time = cost_time;
-  optimization_data->optimization_info_.cost_soft_constraints =
-      cost_constraints;
+template <int _N>
+Extremum PolynomialOptimizationNonLinear<_N>::computeSeparation(
+    const SeparationConstraintData& constraint, const Trajectory& trajectory) {
+  const int n_position_dimensions = std::min(trajectory.D(), 3);
+  std::vector<int> dimensions(n_position_dimensions);
+  std::iota(dimensions.begin(), dimensions.end(), 0);
+
+  Extremum minimum;
+  if (!trajectory.computeMinimumDistance(constraint.neighbour, dimensions,
+                                         &minimum)) {
+    LOG(WARNING) << "Could not compute the distance to neighbour "
+                 << constraint.neighbour_idx << ".";
+  }
 
-  return cost_trajectory + cost_time + cost_constraints;
+  std::vector<Extremum>& separation_minima =
+      constraint.this_object->optimization_info_.separation_minima;
+  if (separation_minima.size() <= constraint.neighbour_idx) {
+    separation_minima.resize(constraint.neighbour_idx + 1);
+  }
+  separation_minima[constraint.neighbour_idx] = minimum;
+  return minimum;
 }
 
 template <int _N>
-double PolynomialOptimizationNonLinear<_N>::evaluateMaximumMagnitudeConstraint(
-    const std::vector<double>& segment_times, std::vector<double>& gradient,
-    void* data) {
+double
+PolynomialOptimizationNonLinear<_N>::evaluateMinimumSeparationConstraint(
+    const std::vector<double>& optimization_variables,
+    std::vector<double>& gradient, void* data) {
   CHECK(gradient.empty())
       << "computing gradient not possible, choose a gradient-free method";
-  ConstraintData* constraint_data =
-      static_cast<ConstraintData*>(data);  // wheee ...
+  SeparationConstraintData* constraint_data =
+      static_cast<SeparationConstraintData*>(data);  // wheee ...
+
   PolynomialOptimizationNonLinear<N>* optimization_data =
       constraint_data->this_object;
-
-  Extremum max;
-  max = optimization_data->poly_opt_.computeMaximumOfMagnitude(
-      constraint_data->derivative, nullptr);
-
-  optimization_data->optimization_info_.maxima[constraint_data->derivative] =
-      max;
-
-  return max.value - constraint_data->value;
+  optimization_data->updateOptimizationVariables(optimization_variables);
+  const Extremum minimum = computeSeparation(
+      *constraint_data, optimization_data->getCurrentTrajectory());
+  return constraint_data->minimum_distance - minimum.value;
 }
 
 template <int _N>
 double
-PolynomialOptimizationNonLinear<_N>::evaluateMaximumMagnitudeAsSoftConstraint(
-    const std::vector<std::shared_ptr<ConstraintData> >& inequality_constraints,
+PolynomialOptimizationNonLinear<_N>::evaluateMinimumSeparationAsSoftConstraint(
     double weight, double maximum_cost) const {
-  std::vector<double> dummy;
-  double cost = 0;
-
-  if (optimization_parameters_.print_debug_info)
-    std::cout << "  soft_constraints: " << std::endl;
+  if (separation_constraints_.empty()) {
+    return 0.0;
+  }
 
-  for (std::shared_ptr<const ConstraintData> constraint :
-       inequality_constraints_) {
-    // need to call the c-style callback function here, thus the ugly cast to
-    // void*.
-    double abs_violation = evaluateMaximumMagnitudeConstraint(
-        dummy, dummy, (void*)constraint.get());
+  // The trajectory is shared by all neighbours.
+  const Trajectory& trajectory = getCurrentTrajectory();
 
-    double relative_violation = abs_violation / constraint->value;
+  double cost = 0;
+  for (const std::shared_ptr<SeparationConstraintData>& constraint :
+       separation_constraints_) {
+    const Extremum minimum = computeSeparation(*constraint, trajectory);
+    const double abs_violation = constraint->minimum_distance - minimum.value;
+    const double relative_violation =
+        abs_violation / constraint->minimum_distance;
     const double current_cost =
         std::min(maximum_cost, exp(relative_violation * weight));
     cost += current_cost;
     if (optimization_parameters_.print_debug_info) {
-      std::cout << "    derivative " << constraint->derivative
+      std::cout << "    neighbour " << constraint->neighbour_idx
                 << " abs violation: " << abs_violation
                 << " : relative violation: " << relative_violation
                 << " cost: " << current_cost << std::endl;
@@ -843,6 +1386,83 @@ void PolynomialOptimizationNonLinear<_N>::
   }
 }
 
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::updateOptimizationVariables(
+    const std::vector<double>& x) {
+  updateOptimizationVariables(
+      Eigen::Map<const Eigen::VectorXd>(x.data(), x.size()));
+}
+
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::updateOptimizationVariables(
+    const Eigen::Ref<const Eigen::VectorXd>& x) {
+  if (evaluated_x_.size() != 0 && evaluated_x_.size() == x.size() &&
+      evaluated_x_ == x) {
+    return;
+  }
+  invalidateEvaluationCache();
+
+  const size_t n_segments = poly_opt_.getNumberSegments();
+  CHECK_GE(static_cast<size_t>(x.size()), n_segments);
+  const std::vector<double> segment_times(x.data(), x.data() + n_segments);
+  poly_opt_.updateSegmentTimes(segment_times);
+
+  switch (optimization_parameters_.time_alloc_method) {
+    case NonlinearOptimizationParameters::kSquaredTimeAndConstraints:
+    case NonlinearOptimizationParameters::kRichterTimeAndConstraints: {
+      // The variables are stacked as [segment_times derivatives_dim_0 ...
+      // derivatives_dim_N].
+      const size_t n_free_constraints = poly_opt_.getNumberFreeConstraints();
+      const size_t dim = poly_opt_.getDimension();
+      CHECK_EQ(static_cast<size_t>(x.size()),
+               n_segments + n_free_constraints * dim);
+      std::vector<Eigen::VectorXd> free_constraints(dim);
+      for (size_t d = 0; d < dim; ++d) {
+        const size_t idx_start = n_segments + d * n_free_constraints;
+        free_constraints[d] = x.segment(idx_start, n_free_constraints);
+      }
+      poly_opt_.setFreeConstraints(free_constraints);
+      break;
+    }
+    default:
+      poly_opt_.solveLinear();
+      break;
+  }
+
+  evaluated_x_ = x;
+}
+
+template <int _N>
+void PolynomialOptimizationNonLinear<_N>::invalidateEvaluationCache() const {
+  evaluated_x_.resize(0);
+  evaluated_maxima_.clear();
+  evaluated_trajectory_.clear();
+}
+
+template <int _N>
+const Extremum& PolynomialOptimizationNonLinear<_N>::getMaximumOfMagnitude(
+    int derivative) const {
+  typename std::map<int, Extremum>::iterator it =
+      evaluated_maxima_.find(derivative);
+  if (it == evaluated_maxima_.end()) {
+    it = evaluated_maxima_
+             .insert(std::make_pair(derivative,
+                                    poly_opt_.computeMaximumOfMagnitude(
+                                        derivative, nullptr)))
+             .first;
+  }
+  return it->second;
+}
+
+template <int _N>
+const Trajectory& PolynomialOptimizationNonLinear<_N>::getCurrentTrajectory()
+    const {
+  if (evaluated_trajectory_.empty()) {
+    poly_opt_.getTrajectory(&evaluated_trajectory_);
+  }
+  return evaluated_trajectory_;
+}
+
 template <int _N>
 double PolynomialOptimizationNonLinear<_N>::computeTotalTrajectoryTime(
     const std::vector<double>& segment_times) {
@@ -0,0 +1,239 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_WINDOWED_IMPL_H_
+#define MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_WINDOWED_IMPL_H_
+
+#include <algorithm>
+
+namespace mav_trajectory_generation {
+
+template <int _N>
+PolynomialOptimizationWindowed<_N>::PolynomialOptimizationWindowed(
+    size_t dimension, const NonlinearOptimizationParameters& parameters,
+    const WindowedOptimizationParameters& window_parameters, size_t n_threads)
+    : dimension_(dimension),
+      optimization_parameters_(parameters),
+      window_parameters_(window_parameters),
+      thread_pool_(n_threads),
+      derivative_to_optimize_(
+          PolynomialOptimization<N>::kHighestDerivativeToOptimize) {
+  CHECK_GT(window_parameters_.window_segments, 0u);
+}
+
+template <int _N>
+bool PolynomialOptimizationWindowed<_N>::setupFromVertices(
+    const Vertex::Vector& vertices, const std::vector<double>& segment_times,
+    int derivative_to_optimize) {
+  CHECK_EQ(vertices.size(), segment_times.size() + 1)
+      << "Size of segment times must be one less than vertices.";
+  if (vertices.size() < 2) {
+    LOG(ERROR) << "At least two vertices are required.";
+    return false;
+  }
+  for (const Vertex& vertex : vertices) {
+    if (vertex.D() != static_cast<int>(dimension_)) {
+      LOG(ERROR) << "Vertex dimension " << vertex.D()
+                 << " does not match the dimension " << dimension_ << ".";
+      return false;
+    }
+  }
+  vertices_ = vertices;
+  segment_times_ = segment_times;
+  derivative_to_optimize_ = derivative_to_optimize;
+  segments_.clear();
+  window_infos_.clear();
+  return true;
+}
+
+template <int _N>
+bool PolynomialOptimizationWindowed<_N>::addMaximumMagnitudeConstraint(
+    int derivative, double maximum_value) {
+  CHECK_GE(derivative, 0);
+  CHECK_GE(maximum_value, 0.0);
+  maximum_magnitude_constraints_[derivative] = maximum_value;
+  return true;
+}
+
+template <int _N>
+void PolynomialOptimizationWindowed<_N>::computeWindows(
+    size_t offset, std::vector<Window>* windows) const {
+  CHECK_NOTNULL(windows);
+  windows->clear();
+  const size_t n_segments = segment_times_.size();
+  const size_t window_segments = window_parameters_.window_segments;
+  const size_t overlap = window_parameters_.overlap_segments;
+
+  // Cuts at offset + k * window_segments. A window that would end up smaller
+  // than half a window is merged into its neighbour.
+  std::vector<size_t> cuts(1, 0);
+  size_t cut = offset > 0 ? offset : window_segments;
+  while (cut + window_segments / 2 < n_segments) {
+    cuts.push_back(cut);
+    cut += window_segments;
+  }
+  cuts.push_back(n_segments);
+
+  for (size_t i = 0; i + 1 < cuts.size(); ++i) {
+    Window window;
+    window.start = cuts[i];
+    window.end = cuts[i + 1];
+    window.extended_start = window.start > overlap ? window.start - overlap : 0;
+    window.extended_end = std::min(window.end + overlap, n_segments);
+    windows->push_back(window);
+  }
+}
+
+template <int _N>
+void PolynomialOptimizationWindowed<_N>::getVertexState(
+    const Window& window, const Trajectory& trajectory, size_t vertex_idx,
+    Eigen::MatrixXd* state) const {
+  CHECK_NOTNULL(state);
+  CHECK_GE(vertex_idx, window.extended_start);
+  CHECK_LE(vertex_idx, window.extended_end);
+  const Segment::Vector& segments = trajectory.segments();
+  const size_t local_idx = vertex_idx - window.extended_start;
+
+  state->resize(PolynomialOptimization<N>::kHighestDerivativeToOptimize + 1,
+                dimension_);
+  for (int derivative = 0; derivative < state->rows(); ++derivative) {
+    if (local_idx < segments.size()) {
+      state->row(derivative) =
+          segments[local_idx].evaluate(0.0, derivative).transpose();
+    } else {
+      state->row(derivative) =
+          segments.back()
+              .evaluate(segments.back().getTime(), derivative)
+              .transpose();
+    }
+  }
+}
+
+template <int _N>
+bool PolynomialOptimizationWindowed<_N>::optimize() {
+  CHECK(!vertices_.empty()) << "Call setupFromVertices() first.";
+  const size_t n_sweeps = std::max<size_t>(window_parameters_.n_sweeps, 1);
+
+  std::vector<Window> windows;
+  std::vector<Trajectory> window_trajectories;
+  for (size_t sweep = 0; sweep < n_sweeps; ++sweep) {
+    const size_t offset =
+        sweep % 2 == 0 ? 0 : window_parameters_.window_segments / 2;
+    computeWindows(offset, &windows);
+    window_trajectories.assign(windows.size(), Trajectory());
+    window_infos_.assign(windows.size(), OptimizationInfo());
+
+    // All windows start from the segment times of the previous sweep.
+    const std::vector<double> segment_times = segment_times_;
+    thread_pool_.parallelFor(windows.size(), [&](size_t window_idx) {
+      const Window& window = windows[window_idx];
+      const Vertex::Vector vertices(
+          vertices_.begin() + window.extended_start,
+          vertices_.begin() + window.extended_end + 1);
+      const std::vector<double> times(
+          segment_times.begin() + window.extended_start,
+          segment_times.begin() + window.extended_end);
+
+      PolynomialOptimizationNonLinear<N> nonlinear_opt(
+          dimension_, optimization_parameters_);
+      nonlinear_opt.setupFromVertices(vertices, times, derivative_to_optimize_);
+      for (const std::pair<const int, double>& constraint :
+           maximum_magnitude_constraints_) {
+        nonlinear_opt.addMaximumMagnitudeConstraint(constraint.first,
+                                                    constraint.second);
+      }
+      nonlinear_opt.optimize();
+      nonlinear_opt.getTrajectory(&window_trajectories[window_idx]);
+      window_infos_[window_idx] = nonlinear_opt.getOptimizationInfo();
+
+      // Every segment belongs to exactly one window.
+      const std::vector<double> optimized_times =
+          window_trajectories[window_idx].getSegmentTimes();
+      for (size_t i = window.start; i < window.end; ++i) {
+        segment_times_[i] = optimized_times[i - window.extended_start];
+      }
+    });
+  }
+
+  // Fix the average state of the two adjacent windows at each cut and solve
+  // the segments of every window with the final segment times.
+  std::vector<Eigen::MatrixXd> cut_states(windows.size());
+  for (size_t i = 1; i < windows.size(); ++i) {
+    Eigen::MatrixXd state_before, state_after;
+    getVertexState(windows[i - 1], window_trajectories[i - 1],
+                   windows[i].start, &state_before);
+    getVertexState(windows[i], window_trajectories[i], windows[i].start,
+                   &state_after);
+    cut_states[i] = 0.5 * (state_before + state_after);
+  }
+
+  std::vector<Segment::Vector> window_segments(windows.size());
+  std::vector<char> solved(windows.size(), false);
+  thread_pool_.parallelFor(windows.size(), [&](size_t window_idx) {
+    const Window& window = windows[window_idx];
+    Vertex::Vector vertices(vertices_.begin() + window.start,
+                            vertices_.begin() + window.end + 1);
+    if (window_idx > 0) {
+      const Eigen::MatrixXd& state = cut_states[window_idx];
+      for (int derivative = 0; derivative < state.rows(); ++derivative) {
+        vertices.front().addConstraint(derivative,
+                                       state.row(derivative).transpose());
+      }
+    }
+    if (window_idx + 1 < windows.size()) {
+      const Eigen::MatrixXd& state = cut_states[window_idx + 1];
+      for (int derivative = 0; derivative < state.rows(); ++derivative) {
+        vertices.back().addConstraint(derivative,
+                                      state.row(derivative).transpose());
+      }
+    }
+    const std::vector<double> times(segment_times_.begin() + window.start,
+                                    segment_times_.begin() + window.end);
+
+    PolynomialOptimization<N> poly_opt(dimension_);
+    solved[window_idx] =
+        poly_opt.setupFromVertices(vertices, times, derivative_to_optimize_) &&
+        poly_opt.solveLinear();
+    poly_opt.getSegments(&window_segments[window_idx]);
+  });
+
+  segments_.clear();
+  bool success = true;
+  for (size_t i = 0; i < windows.size(); ++i) {
+    success &= static_cast<bool>(solved[i]);
+    segments_.insert(segments_.end(), window_segments[i].begin(),
+                     window_segments[i].end());
+  }
+  for (const OptimizationInfo& info : window_infos_) {
+    if (info.stopping_reason < 0) success = false;
+  }
+  return success;
+}
+
+template <int _N>
+void PolynomialOptimizationWindowed<_N>::getTrajectory(
+    Trajectory* trajectory) const {
+  CHECK_NOTNULL(trajectory);
+  trajectory->setSegments(segments_);
+}
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_IMPL_POLYNOMIAL_OPTIMIZATION_WINDOWED_IMPL_H_
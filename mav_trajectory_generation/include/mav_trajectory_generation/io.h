@@ -25,9 +25,12 @@
 
 #include "mav_trajectory_generation/segment.h"
 #include "mav_trajectory_generation/trajectory.h"
+#include "mav_trajectory_generation/vertex.h"
 
 namespace mav_trajectory_generation {
 
+struct NonlinearOptimizationParameters;
+
 YAML::Node coefficientsToYaml(const Eigen::VectorXd& coefficients);
 YAML::Node segmentToYaml(const Segment& segment);
 YAML::Node segmentsToYaml(const Segment::Vector& segments);
@@ -65,6 +68,28 @@ inline bool trajectoryFromFile(
 bool sampledTrajectoryStatesToFile(const std::string& filename,
                                    const Trajectory& trajectory);
 
+// Vertices as a sequence of {D: dimension, constraints: {derivative_order:
+// [values]}}.
+YAML::Node verticesToYaml(const Vertex::Vector& vertices);
+bool verticesFromYaml(const YAML::Node& node, Vertex::Vector* vertices);
+
+// Parameters of the nonlinear optimization as a map from the member names to
+// their values. The enums are written as their names without the leading k,
+// except for the nlopt algorithm, which is written as its integer value.
+YAML::Node nonlinearOptimizationParametersToYaml(
+    const NonlinearOptimizationParameters& parameters);
+
+// Parameters missing in the node keep their current value in *parameters.
+bool nonlinearOptimizationParametersFromYaml(
+    const YAML::Node& node, NonlinearOptimizationParameters* parameters);
+
+bool nonlinearOptimizationParametersToFile(
+    const std::string& filename,
+    const NonlinearOptimizationParameters& parameters);
+
+bool nonlinearOptimizationParametersFromFile(
+    const std::string& filename, NonlinearOptimizationParameters* parameters);
+
 }  // namespace mav_trajectory_generation
 
 #endif  // MAV_TRAJECTORY_GENERATION_YAML_IO_H_
@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_OPTIMIZATION_TRACE_H_
+#define MAV_TRAJECTORY_GENERATION_OPTIMIZATION_TRACE_H_
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace mav_trajectory_generation {
+
+// State of the optimization at one objective evaluation.
+struct OptimizationTraceEntry {
+  // Index of the evaluation, starting at 0 for every optimization.
+  int iteration = 0;
+  // Time since the start of the optimization [s].
+  double elapsed_time = 0.0;
+  double cost_trajectory = 0.0;
+  double cost_time = 0.0;
+  double cost_soft_constraints = 0.0;
+  std::vector<double> segment_times;
+};
+
+// Ring buffer holding the most recent objective evaluations of an
+// optimization. Once full, the oldest entries are overwritten, and the
+// storage of the entries is reused, such that recording does not allocate
+// after the first round.
+class OptimizationTrace {
+ public:
+  // Input: capacity = Maximum number of entries kept. Recording is disabled
+  // if 0.
+  explicit OptimizationTrace(size_t capacity = 0);
+
+  // Changes the capacity and removes all entries.
+  void setCapacity(size_t capacity);
+  size_t getCapacity() const { return entries_.size(); }
+
+  // Removes all entries.
+  void clear();
+
+  // Returns the slot for a new entry, which replaces the oldest entry if the
+  // trace is full. Must not be called if the capacity is 0.
+  OptimizationTraceEntry& addEntry();
+
+  // Returns the number of entries currently held.
+  size_t size() const { return size_; }
+  bool empty() const { return size_ == 0; }
+
+  // Returns the number of entries that were overwritten since the last clear.
+  size_t getNumberOfDroppedEntries() const { return n_dropped_; }
+
+  // Returns the i-th entry, where 0 is the oldest one still held.
+  const OptimizationTraceEntry& operator[](size_t i) const;
+
+  // Writes one line per entry with the columns iteration, elapsed_time,
+  // cost_trajectory, cost_time, cost_soft_constraints and the segment times
+  // t_0 ... t_{K-1}.
+  void writeCsv(std::ostream& stream) const;
+
+  // Writes an array with one object per entry.
+  void writeJson(std::ostream& stream) const;
+
+  // Write the trace to a file. Return false if the file could not be
+  // opened.
+  bool saveCsv(const std::string& filename) const;
+  bool saveJson(const std::string& filename) const;
+
+ private:
+  std::vector<OptimizationTraceEntry> entries_;
+  // Index of the oldest entry.
+  size_t begin_;
+  size_t size_;
+  size_t n_dropped_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_OPTIMIZATION_TRACE_H_
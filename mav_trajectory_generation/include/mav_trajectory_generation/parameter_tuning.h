@@ -0,0 +1,178 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_PARAMETER_TUNING_H_
+#define MAV_TRAJECTORY_GENERATION_PARAMETER_TUNING_H_
+
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include <yaml-cpp/yaml.h>
+
+#include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
+#include "mav_trajectory_generation/thread_pool.h"
+
+namespace mav_trajectory_generation {
+
+// A recorded planning problem of a tuning corpus.
+struct TuningProblem {
+  Vertex::Vector vertices;
+
+  // Initial guess of the segment times. Estimated from the limits of
+  // velocity and acceleration if empty.
+  std::vector<double> segment_times;
+
+  // Maximum magnitude per derivative order, e.g. {1: v_max, 2: a_max}.
+  // Added as magnitude constraints and checked for feasibility.
+  std::map<int, double> limits;
+
+  int derivative_to_optimize = derivative_order::SNAP;
+};
+
+// A problem as a map with the keys vertices (see verticesToYaml()),
+// segment_times, limits and derivative_to_optimize.
+YAML::Node tuningProblemToYaml(const TuningProblem& problem);
+bool tuningProblemFromYaml(const YAML::Node& node, TuningProblem* problem);
+bool tuningProblemToFile(const std::string& filename,
+                         const TuningProblem& problem);
+bool tuningProblemFromFile(const std::string& filename,
+                           TuningProblem* problem);
+
+// Search space of the random search. Continuous parameters are sampled
+// log-uniformly between their bounds, the enums uniformly from the lists.
+// The remaining parameters are taken from the base parameters.
+struct TuningParameters {
+  // Number of random parameter sets evaluated in addition to the base.
+  size_t n_samples = 50;
+
+  int random_seed = 0;
+
+  // Number of threads evaluating parameter sets. If 0, the number of
+  // hardware threads is used. Use 1 for the least noisy runtimes.
+  size_t n_threads = 0;
+
+  std::vector<nlopt::algorithm> algorithms = {nlopt::LN_BOBYQA,
+                                              nlopt::LN_SBPLX,
+                                              nlopt::LN_COBYLA};
+  std::vector<NonlinearOptimizationParameters::TimeAllocMethod>
+      time_alloc_methods = {
+          NonlinearOptimizationParameters::kSquaredTime,
+          NonlinearOptimizationParameters::kRichterTime,
+          NonlinearOptimizationParameters::kSquaredTimeAndConstraints,
+          NonlinearOptimizationParameters::kRichterTimeAndConstraints};
+
+  double f_rel_min = 1.0e-4;
+  double f_rel_max = 0.1;
+  double initial_stepsize_rel_min = 0.01;
+  double initial_stepsize_rel_max = 0.5;
+  double time_penalty_min = 10.0;
+  double time_penalty_max = 5000.0;
+  double soft_constraint_weight_min = 1.0;
+  double soft_constraint_weight_max = 1000.0;
+
+  // Relative violation of a limit up to which a problem counts as feasible.
+  double feasibility_tolerance_rel = 0.05;
+};
+
+// Performance of one parameter set on the corpus.
+struct TuningResult {
+  NonlinearOptimizationParameters parameters;
+
+  // Optimization time summed over all problems [s].
+  double runtime = 0.0;
+
+  // Trajectory cost plus the time penalty of the base parameters times the
+  // trajectory duration, summed over all problems. The time penalty of the
+  // base parameters expresses the desired trade-off between smoothness and
+  // speed, such that costs are comparable between parameter sets with
+  // different time penalties.
+  double cost = 0.0;
+
+  // Largest relative violation of a limit over all problems, 0 if all
+  // limits are met.
+  double violation = 0.0;
+
+  // Number of problems within the feasibility tolerance.
+  size_t n_feasible = 0;
+};
+
+std::ostream& operator<<(std::ostream& stream, const TuningResult& val);
+
+// Draws a parameter set from the search space.
+NonlinearOptimizationParameters sampleParameters(
+    const NonlinearOptimizationParameters& base,
+    const TuningParameters& tuning_parameters, std::mt19937* generator);
+
+// Finds the results that are not dominated in runtime, cost and violation,
+// i.e. no other result is at least as good in all three and better in one.
+// Output: front = Indices of the Pareto-optimal results, by increasing
+// runtime.
+void computeParetoFront(const std::vector<TuningResult>& results,
+                        std::vector<size_t>* front);
+
+// Random search over the parameters of PolynomialOptimizationNonLinear on a
+// corpus of recorded problems. Every parameter set is evaluated on all
+// problems, and the parameter sets are evaluated in parallel.
+// _N specifies the number of coefficients for the underlying polynomials.
+template <int _N = 10>
+class ParameterTuning {
+ public:
+  enum { N = _N };
+
+  // Input: base = Parameters that are evaluated first and that define the
+  // parameters outside of the search space.
+  // Input: tuning_parameters = Search space.
+  ParameterTuning(const NonlinearOptimizationParameters& base,
+                  const TuningParameters& tuning_parameters);
+
+  void addProblem(const TuningProblem& problem);
+  size_t getNumberOfProblems() const { return problems_.size(); }
+
+  // Evaluates the base parameters and n_samples random parameter sets.
+  // Previous results are discarded.
+  bool run();
+
+  // Evaluates one parameter set on all problems.
+  bool evaluate(const NonlinearOptimizationParameters& parameters,
+                TuningResult* result) const;
+
+  // Results of run(), the base parameters first.
+  const std::vector<TuningResult>& getResults() const { return results_; }
+
+  // Output: front = Indices into getResults() of the Pareto-optimal
+  // parameter sets, by increasing runtime.
+  void getParetoFront(std::vector<size_t>* front) const {
+    computeParetoFront(results_, front);
+  }
+
+ private:
+  NonlinearOptimizationParameters base_;
+  TuningParameters tuning_parameters_;
+  std::vector<TuningProblem> problems_;
+  std::vector<TuningResult> results_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_PARAMETER_TUNING_H_
+
+#include "mav_trajectory_generation/impl/parameter_tuning_impl.h"
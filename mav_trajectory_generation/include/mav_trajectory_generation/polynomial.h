@@ -37,12 +37,17 @@ namespace mav_trajectory_generation {
 class Polynomial {
  public:
   typedef std::vector<Polynomial> Vector;
+  // Coefficients of several polynomials, one polynomial per column. Stored
+  // row-major, such that the n-th coefficients of all polynomials are
+  // contiguous.
+  typedef Eigen::Matrix<double, Eigen::Dynamic, Eigen::Dynamic, Eigen::RowMajor>
+      CoefficientMatrix;
 
   // Maximum degree of a polynomial for which the static derivative (basis
   // coefficient) matrix should be evaluated for.
   // kMaxN = max. number of coefficients.
-  static constexpr int kMaxN = 12;
-  // kMaxConvolutionSize = max. convolution size for N = 12, convolved with its
+  static constexpr int kMaxN = 16;
+  // kMaxConvolutionSize = max. convolution size for N = 16, convolved with its
   // derivative.
   static constexpr int kMaxConvolutionSize = 2 * kMaxN - 2;
   // One static shared across all members of the class, computed up to order
@@ -242,6 +247,18 @@ class Polynomial {
   // p_out = a12*b^12*t^12 + a11*b^11*t^11... etc.
   void scalePolynomialInTime(double scaling_factor);
 
+  // Shifts the polynomial in time, such that p_out(t) = p(t + t_shift).
+  void shiftPolynomialInTime(double t_shift);
+
+  // Batched version of shiftPolynomialInTime() for polynomials with the same
+  // number of coefficients, e.g. all dimensions of a segment. Each column of
+  // coefficients holds the coefficients of one polynomial, such that every
+  // step of the Taylor shift is one vectorized operation on a contiguous row.
+  // Input: t_shift = Time shift.
+  // Input/Output: coefficients = N x D matrix of coefficients.
+  static void shiftCoefficientsInTime(
+      double t_shift, Eigen::Ref<CoefficientMatrix> coefficients);
+
   // Offset this polynomial.
   void offsetPolynomial(const double offset);
 
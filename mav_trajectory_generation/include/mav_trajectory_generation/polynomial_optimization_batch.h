@@ -0,0 +1,147 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_BATCH_H_
+#define MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_BATCH_H_
+
+#include <map>
+#include <vector>
+
+#include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
+#include "mav_trajectory_generation/thread_pool.h"
+
+namespace mav_trajectory_generation {
+
+// Planning problem of a single vehicle of a fleet.
+struct BatchOptimizationProblem {
+  // Support points and constraints of the path.
+  Vertex::Vector vertices;
+
+  // Time between two vertices, initial guess for nonlinear optimization.
+  std::vector<double> segment_times;
+
+  // Derivative of which the cost is optimized. The highest possible
+  // derivative for the number of coefficients is chosen if negative.
+  int derivative_to_optimize = -1;
+
+  // Maximum magnitude per derivative order, e.g. {{derivative_order::VELOCITY,
+  // v_max}, {derivative_order::ACCELERATION, a_max}}. Only used by
+  // nonlinear optimization.
+  std::map<int, double> maximum_magnitude_constraints;
+};
+
+// Plans trajectories for many independent vehicles at once.
+// Problems whose vertices constrain the same derivatives share the constraint
+// reordering of the linear problem, which is only built once per constraint
+// pattern, and all problems are solved concurrently on a thread pool. The
+// results are identical to solving each problem on its own with
+// PolynomialOptimization or PolynomialOptimizationNonLinear.
+// _N specifies the number of coefficients for the underlying polynomials.
+template <int _N = 10>
+class PolynomialOptimizationBatch {
+  static_assert(_N % 2 == 0, "The number of coefficients has to be even.");
+
+ public:
+  enum { N = _N };
+
+  // Input: dimension = Spatial dimension of all problems. Usually 1 or 3.
+  // Input: parameters = Parameters for nonlinear optimization, shared by all
+  // problems.
+  // Input: n_threads = Number of threads solving problems. If 0, the number
+  // of hardware threads is used.
+  PolynomialOptimizationBatch(size_t dimension,
+                              const NonlinearOptimizationParameters& parameters,
+                              size_t n_threads = 0);
+
+  // Adds the problem of one vehicle and returns its index, which is also the
+  // index of its results.
+  size_t addProblem(const BatchOptimizationProblem& problem);
+
+  // Removes all problems and results.
+  void clear();
+
+  size_t getNumberOfProblems() const { return problems_.size(); }
+
+  // Returns the number of distinct constraint patterns, i.e. how many times
+  // the constraint reordering had to be built during the last solve.
+  size_t getNumberOfConstraintPatterns() const {
+    return n_constraint_patterns_;
+  }
+
+  // Solves the linear optimization problem of every vehicle with the given
+  // segment times. Returns true if all problems were solved.
+  bool solveLinear();
+
+  // Runs nonlinear optimization for every vehicle. Returns true if no
+  // optimization failed, see getOptimizationInfo() for the per-vehicle
+  // stopping reasons.
+  bool optimize();
+
+  // Returns the trajectory of the problem with the given index. Only valid
+  // after solveLinear() or optimize() was called.
+  void getTrajectory(size_t problem_idx, Trajectory* trajectory) const;
+
+  // Returns the trajectories of all problems in the order they were added.
+  const std::vector<Trajectory>& getTrajectories() const {
+    return trajectories_;
+  }
+
+  // Returns the optimization info of the problem with the given index. For
+  // linear solves, only the trajectory cost and the optimization time are
+  // set.
+  const OptimizationInfo& getOptimizationInfo(size_t problem_idx) const;
+
+  // Returns the optimization infos of all problems in the order they were
+  // added.
+  const std::vector<OptimizationInfo>& getOptimizationInfos() const {
+    return optimization_infos_;
+  }
+
+ private:
+  // Sets up one linear problem per constraint pattern and returns for each
+  // problem the index of the linear problem to start from.
+  void setupConstraintPatterns(
+      std::vector<PolynomialOptimization<N> >* pattern_problems,
+      std::vector<size_t>* pattern_indices);
+
+  // Sets up *poly_opt for the problem with the given index from the set up
+  // problem with the same constraint pattern.
+  void setupProblem(size_t problem_idx,
+                    const PolynomialOptimization<N>& pattern_problem,
+                    PolynomialOptimization<N>* poly_opt) const;
+
+  // Returns the derivative to optimize of the given problem.
+  int getDerivativeToOptimize(const BatchOptimizationProblem& problem) const;
+
+  size_t dimension_;
+  NonlinearOptimizationParameters optimization_parameters_;
+  ThreadPool thread_pool_;
+
+  std::vector<BatchOptimizationProblem> problems_;
+  std::vector<Trajectory> trajectories_;
+  std::vector<OptimizationInfo> optimization_infos_;
+  size_t n_constraint_patterns_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_BATCH_H_
+
+#include "mav_trajectory_generation/impl/polynomial_optimization_batch_impl.h"
@@ -28,6 +28,7 @@
 #include "mav_trajectory_generation/extremum.h"
 #include "mav_trajectory_generation/motion_defines.h"
 #include "mav_trajectory_generation/polynomial.h"
+#include "mav_trajectory_generation/qp_solver.h"
 #include "mav_trajectory_generation/segment.h"
 #include "mav_trajectory_generation/trajectory.h"
 #include "mav_trajectory_generation/vertex.h"
@@ -50,6 +51,11 @@ class PolynomialOptimization {
   enum { N = _N };
   static constexpr int kHighestDerivativeToOptimize = N / 2 - 1;
   typedef Eigen::Matrix<double, N, N> SquareMatrix;
+  typedef Eigen::SparseQR<Eigen::SparseMatrix<double>,
+                          Eigen::COLAMDOrdering<int> >
+      LinearSolver;
+  // Solver for problems with time normalization, see setTimeNormalization().
+  typedef Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > CholeskySolver;
   typedef std::vector<SquareMatrix, Eigen::aligned_allocator<SquareMatrix> >
       SquareMatrixVector;
 
@@ -64,6 +70,10 @@ class PolynomialOptimization {
   // Thus, its size is size(vertices) - 1.
   // Input: derivative_to_optimize = Specifies the derivative of which the
   // cost is optimized.
+  // Can be called repeatedly on the same object, e.g. for replanning. All
+  // buffers keep their capacity, and if the vertices constrain the same
+  // derivatives as in the previous setup, the constraint reordering and the
+  // sparsity patterns are reused as in updateVertices().
   bool setupFromVertices(
       const Vertex::Vector& vertices, const std::vector<double>& segment_times,
       int derivative_to_optimize = kHighestDerivativeToOptimize);
@@ -79,6 +89,18 @@ class PolynomialOptimization {
   bool setupFromPositons(const std::vector<double>& positions,
                          const std::vector<double>& times);
 
+  // Updates the constraint values and segment times of a problem that was set
+  // up before, e.g. a copy of the problem of another vehicle with the same
+  // kind of waypoints. Skips building the constraint reordering, which
+  // dominates the setup time of problems with many vertices.
+  // Returns false and leaves the problem untouched if the vertices do not
+  // constrain exactly the same derivatives as the ones used during setup.
+  // Input: vertices = Vector containing the vertices with the new constraint
+  // values.
+  // Input: segment_times = Vector containing the time between two vertices.
+  bool updateVertices(const Vertex::Vector& vertices,
+                      const std::vector<double>& segment_times);
+
   // Wrapper that inverts the mapping matrix (A in [1]) to take advantage
   // of its structure.
   // Input: A matrix
@@ -88,6 +110,17 @@ class PolynomialOptimization {
 
   static void setupMappingMatrix(double segment_time, SquareMatrix* A);
 
+  // Parameterizes every segment on unit time instead of its actual time.
+  // The mapping and cost matrices are then computed once for T = 1 and
+  // scaled by powers of the segment times, instead of inverting mapping
+  // matrices with entries up to T^(N-1), and solveLinear() factorizes the
+  // equilibrated cost matrix with LDL^T instead of QR. This keeps long
+  // segments and polynomials with N > 12 accurate and is faster. Can be
+  // changed at any time, the matrices are recomputed if the problem is set
+  // up already. Disabled by default.
+  void setTimeNormalization(bool time_normalization);
+  bool getTimeNormalization() const { return time_normalization_; }
+
   // Computes the cost in the derivative that was specified during
   // setupFromVertices().
   // The cost is computed as: 0.5*c^T*Q*c
@@ -100,6 +133,11 @@ class PolynomialOptimization {
   // to be called during non-linear optimization procedures.
   void updateSegmentTimes(const std::vector<double>& segment_times);
 
+  // Updates the time of a single segment. Only recomputes the cost- and
+  // inverse mapping block-matrices of this segment, for procedures that
+  // change one segment at a time.
+  void updateSegmentTime(size_t segment_idx, double segment_time);
+
   // Solves the linear optimization problem according to [1].
   // The solver is re-used for every dimension, which means:
   //  - segment times are equal for each dimension.
@@ -107,6 +145,59 @@ class PolynomialOptimization {
   //    course differ.
   bool solveLinear();
 
+  // Same as solveLinear(), but factorizes with the given solver. The sparsity
+  // pattern of the problem only depends on the constraint structure, not on
+  // the segment times. Solvers that are kept across repeated solves of the
+  // same problem thus only have to analyze the pattern once.
+  // Input: analyze_pattern = Whether to analyze the pattern. Has to be true
+  // the first time a solver is used for this problem.
+  bool solveLinear(LinearSolver* solver, bool analyze_pattern);
+
+  // Same as solveLinear(LinearSolver*, bool), with an LDL^T factorization of
+  // the cost matrix equilibrated by its diagonal. Requires a well scaled
+  // problem, i.e. time normalization.
+  bool solveLinear(CholeskySolver* solver, bool analyze_pattern);
+
+  // Adds the hard bound lower <= d^k/dt^k p(t) <= upper on one dimension
+  // of a segment, where p is the polynomial of the dimension and
+  // k = derivative. The bounds are only enforced by solveQP().
+  // Input: relative_time = Time of the bound relative to the segment time,
+  // in [0, 1]. The bound moves with the segment time.
+  bool addDerivativeBound(size_t segment_idx, double relative_time,
+                          int derivative, size_t dimension_idx, double lower,
+                          double upper);
+
+  // Adds bounds on a derivative of every dimension at n_points collocation
+  // points per segment, spread evenly over the segment including its start
+  // and end. Between the points, the derivative may exceed the bounds.
+  bool addDerivativeBoundsAtCollocationPoints(int derivative, double lower,
+                                              double upper, size_t n_points);
+
+  // Adds bounds on the Bernstein control points of a derivative of every
+  // dimension and segment. By the convex hull property of the Bernstein
+  // basis, the derivative then stays within the bounds over the whole
+  // segment. The bounds are conservative, i.e. the derivative usually does
+  // not reach them.
+  bool addDerivativeBoundsOnControlPoints(int derivative, double lower,
+                                          double upper);
+
+  // Removes all bounds.
+  void clearDerivativeBounds();
+  size_t getNumberDerivativeBounds() const { return derivative_bounds_.size(); }
+
+  // Solves the optimization problem for the current segment times with the
+  // derivative bounds as hard inequality constraints. The quadratic program
+  // of every dimension is solved with AdmmQpSolver. With the default
+  // parameters, the solver starts from the solution of the previous call,
+  // which speeds up repeated solves, e.g. with slightly changed segment
+  // times. Without bounds, the result equals solveLinear().
+  // Input: parameters = Parameters of the QP solver.
+  // Output: infos = Optional solver statistics per dimension.
+  // Returns whether the QPs of all dimensions converged.
+  bool solveQP(
+      const AdmmQpParameters& parameters = AdmmQpParameters(),
+      std::vector<AdmmQpSolver::Info>* infos = nullptr);
+
   // Returns the trajectory created by the optimization.
   // Only valid after solveLinear() is called. This is the preferred external
   // interface for getting information back out of the solver.
@@ -115,6 +206,16 @@ class PolynomialOptimization {
     trajectory->setSegments(segments_);
   }
 
+  // Same as getTrajectory(), but moves the segments into the trajectory
+  // instead of copying them. Afterwards, the segments of the optimization are
+  // empty until the next call to solveLinear() (or any other solve).
+  void extractTrajectory(Trajectory* trajectory) {
+    CHECK_NOTNULL(trajectory);
+    CHECK(!segments_.empty()) << "No segments to extract, solve first.";
+    trajectory->setSegments(std::move(segments_));
+    segments_.clear();
+  }
+
   // Computes the candidates for the maximum magnitude of a single
   // segment in the specified derivative.
   // In the 1D case, it simply returns the roots of the derivative of the
@@ -180,17 +281,27 @@ class PolynomialOptimization {
     *vertices = vertices_;
   }
 
+  const Vertex::Vector& getVerticesRef() const { return vertices_; }
+
   // Only for internal use -- always use getTrajectory() instead if you can!
   void getSegments(Segment::Vector* segments) const {
     CHECK_NOTNULL(segments);
     *segments = segments_;
   }
 
+  // Returns a const reference to the segments, e.g. to evaluate constraints
+  // during nonlinear optimization without copying.
+  const Segment::Vector& getSegmentsRef() const { return segments_; }
+
   void getSegmentTimes(std::vector<double>* segment_times) const {
     CHECK(segment_times != nullptr);
     *segment_times = segment_times_;
   }
 
+  const std::vector<double>& getSegmentTimesRef() const {
+    return segment_times_;
+  }
+
   void getFreeConstraints(
       std::vector<Eigen::VectorXd>* free_constraints) const {
     CHECK(free_constraints != nullptr);
@@ -231,15 +342,66 @@ class PolynomialOptimization {
   void printReorderingMatrix(std::ostream& stream) const;
 
  private:
+  // Bound on a derivative of one dimension of a segment, either at a time or
+  // on a Bernstein control point.
+  struct DerivativeBound {
+    size_t segment_idx;
+    size_t dimension_idx;
+    int derivative;
+    // Index of the Bernstein control point, or -1 for a bound at
+    // relative_time.
+    int control_point_idx;
+    double relative_time;
+    double lower;
+    double upper;
+  };
+
+  // Computes the row w with w^T c = bounded value for the coefficients c of
+  // the segment at its current time.
+  void computeDerivativeBoundRow(const DerivativeBound& bound,
+                                 Eigen::Matrix<double, N, 1>* row) const;
+
+  // Maximum of the magnitude of a derivative within a segment, excluding the
+  // segment end.
+  // Input: extrema_times = Buffer for the candidate times, overwritten.
+  // Output: candidates = If not nullptr, all candidates are appended to it.
+  Extremum computeSegmentMaximumOfMagnitude(
+      int derivative, size_t segment_idx, std::vector<double>* extrema_times,
+      std::vector<Extremum>* candidates) const;
+
   // Constructs the sparse R (cost) matrix.
   void constructR(Eigen::SparseMatrix<double>* R) const;
 
+  // Computes the cost and inverse mapping matrices of a segment.
+  void updateSegmentMatrices(size_t segment_idx, double segment_time);
+
+  // Computes the block H = A^{-T}QA^{-1} of a segment.
+  void computeCostBlock(size_t segment_idx, SquareMatrix* H) const;
+
+  // Sets up the sparsity patterns of cost_free_free_ and cost_free_fixed_
+  // and where the entries of the segment blocks go. Called whenever the
+  // constraint reordering changes.
+  void setupCostBlockPatterns();
+
+  // Assembles the blocks R_pp and R_pf of R for the current segment times
+  // into cost_free_free_ and cost_free_fixed_, without forming R. Only the
+  // values are written, such that the matrices are not reallocated.
+  void updateCostBlocks();
+
   // Sets up the matrix (C in [1]) that reorders constraints for the
   // optimization problem.
   // This matrix is the same for each dimension, i.e. each dimension must have
   // the same fixed and free parameters.
   void setupConstraintReorderingMatrix();
 
+  // Updates constraint_pattern_ from vertices_ and returns whether it
+  // changed.
+  bool updateConstraintPattern();
+
+  // Copies the constraint values of vertices_ into the compact fixed
+  // constraints, in the order of setupConstraintReorderingMatrix().
+  void updateFixedConstraintsCompact();
+
   // Updates the segments stored internally from the set of compact fixed
   // and free constraints.
   void updateSegmentsFromCompactConstraints();
@@ -248,9 +410,30 @@ class PolynomialOptimization {
   // constraints (C in [1]).
   Eigen::SparseMatrix<double> constraint_reordering_;
 
+  // Column of the single entry in every row of constraint_reordering_, i.e.
+  // the index of every segment constraint in [d_f; d_p].
+  std::vector<size_t> constraint_indices_;
+
+  // Blocks R_pp and R_pf of R, allocated once per constraint pattern.
+  Eigen::SparseMatrix<double> cost_free_free_;
+  Eigen::SparseMatrix<double> cost_free_fixed_;
+
+  // Destination of every entry of the segment blocks A^{-T}QA^{-1}, stored
+  // column-major per segment: index into the values of cost_free_free_ if
+  // >= 0, into the values of cost_free_fixed_ at -2 - index if < -1, and
+  // -1 for entries in the unused rows of the fixed constraints.
+  std::vector<int> cost_value_indices_;
+
+  // Segment blocks A^{-T}QA^{-1}, computed in parallel.
+  SquareMatrixVector cost_blocks_;
+
   // Original vertices containing the constraints.
   Vertex::Vector vertices_;
 
+  // Bit mask of the constrained derivatives of every vertex, from which the
+  // constraint reordering was set up.
+  std::vector<unsigned int> constraint_pattern_;
+
   // The actual segments containing the solution.
   Segment::Vector segments_;
 
@@ -271,6 +454,16 @@ class PolynomialOptimization {
 
   std::vector<double> segment_times_;
 
+  bool time_normalization_;
+
+  // Inverse mapping, cost and H matrices of a segment with T = 1. Dynamic
+  // to not impose alignment requirements on the class.
+  Eigen::MatrixXd unit_inverse_mapping_matrix_;
+  Eigen::MatrixXd unit_cost_matrix_;
+  Eigen::MatrixXd unit_cost_block_;
+  // Derivative that the unit time matrices were computed for.
+  int unit_matrices_derivative_;
+
   // Number of polynomials, e.g 3 for a 3D path.
   size_t dimension_;
 
@@ -281,6 +474,11 @@ class PolynomialOptimization {
   size_t n_all_constraints_;
   size_t n_fixed_constraints_;
   size_t n_free_constraints_;
+
+  std::vector<DerivativeBound> derivative_bounds_;
+
+  // Iterates of the QP of every dimension for warm starts.
+  std::vector<AdmmQpSolver::State> qp_states_;
 };
 
 // Constraint class that aggregates all constraints from incoming Vertices.
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_H_
+#define MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_H_
+
+#include <memory>
+#include <vector>
+
+#include "mav_trajectory_generation/polynomial_optimization_linear.h"
+#include "mav_trajectory_generation/trajectory.h"
+
+namespace mav_trajectory_generation {
+
+// Linear optimization problem of a group of dimensions, e.g. the position or
+// the yaw of a trajectory, independent of the number of coefficients.
+class PolynomialOptimizationGroupBase {
+ public:
+  virtual ~PolynomialOptimizationGroupBase() {}
+
+  virtual size_t getDimension() const = 0;
+  virtual int getN() const = 0;
+  virtual size_t getNumberOfVertices() const = 0;
+
+  // Sets up the problem from the vertices of the group and the given times.
+  virtual bool setup(const std::vector<double>& segment_times) = 0;
+  virtual void updateSegmentTimes(const std::vector<double>& segment_times) = 0;
+  virtual bool solveLinear() = 0;
+  virtual double computeCost() const = 0;
+  virtual void getTrajectory(Trajectory* trajectory) const = 0;
+};
+
+// Group with polynomials of _N coefficients.
+template <int _N = 10>
+class PolynomialOptimizationGroup : public PolynomialOptimizationGroupBase {
+ public:
+  enum { N = _N };
+
+  // Input: vertices = Vertices of the group, their dimension is the
+  // dimension of the group.
+  // Input: derivative_to_optimize = Derivative of which the cost is
+  // optimized.
+  PolynomialOptimizationGroup(const Vertex::Vector& vertices,
+                              int derivative_to_optimize);
+
+  virtual size_t getDimension() const { return dimension_; }
+  virtual int getN() const { return N; }
+  virtual size_t getNumberOfVertices() const { return vertices_.size(); }
+
+  virtual bool setup(const std::vector<double>& segment_times);
+  virtual void updateSegmentTimes(const std::vector<double>& segment_times);
+  virtual bool solveLinear();
+  virtual double computeCost() const;
+  virtual void getTrajectory(Trajectory* trajectory) const;
+
+  // Access to the underlying problem, e.g. to enable time normalization.
+  PolynomialOptimization<N>& getOptimization() { return optimization_; }
+  const PolynomialOptimization<N>& getOptimization() const {
+    return optimization_;
+  }
+
+ private:
+  size_t dimension_;
+  Vertex::Vector vertices_;
+  int derivative_to_optimize_;
+  PolynomialOptimization<N> optimization_;
+};
+
+// Jointly plans groups of dimensions that share their segment times, but
+// each have their own number of coefficients, derivative to optimize and
+// vertex constraints. For example, the position can minimize snap with
+// N = 10 while the yaw minimizes acceleration with N = 6, instead of
+// forcing the yaw into the polynomial order of the position as a 4D problem
+// does. The groups are independent problems for fixed segment times and are
+// solved concurrently. The resulting trajectory contains the dimensions of
+// all groups in the order the groups were added, with the polynomials of
+// the lower order groups padded to the highest N.
+class PolynomialOptimizationMultiGroup {
+ public:
+  PolynomialOptimizationMultiGroup() {}
+
+  // Adds a group and returns its index. All groups need the same number of
+  // vertices.
+  template <int N>
+  size_t addGroup(const Vertex::Vector& vertices,
+                  int derivative_to_optimize =
+                      PolynomialOptimization<N>::kHighestDerivativeToOptimize);
+
+  // Adds a group with a custom implementation and returns its index.
+  size_t addGroup(std::unique_ptr<PolynomialOptimizationGroupBase> group);
+
+  size_t getNumberOfGroups() const { return groups_.size(); }
+
+  // Returns the group with the given index. Use dynamic_cast to access the
+  // PolynomialOptimizationGroup<N> of a group added with addGroup<N>().
+  PolynomialOptimizationGroupBase& getGroup(size_t group_idx);
+  const PolynomialOptimizationGroupBase& getGroup(size_t group_idx) const;
+
+  // Returns the dimension of the merged trajectory.
+  size_t getDimension() const;
+
+  // Sets up all groups with the shared segment times. Returns false if the
+  // groups do not have one vertex more than segment times.
+  bool setup(const std::vector<double>& segment_times);
+
+  // Updates the shared segment times of all groups.
+  void updateSegmentTimes(const std::vector<double>& segment_times);
+
+  // Solves the linear problems of all groups concurrently. Returns true if
+  // all groups were solved.
+  bool solveLinear();
+
+  // Returns the sum of the costs of all groups.
+  double computeCost() const;
+
+  // Merges the solutions of all groups into one trajectory.
+  bool getTrajectory(Trajectory* trajectory) const;
+
+ private:
+  std::vector<std::unique_ptr<PolynomialOptimizationGroupBase> > groups_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#include "mav_trajectory_generation/impl/polynomial_optimization_multi_group_impl.h"
+
+#endif  // MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_GROUP_H_
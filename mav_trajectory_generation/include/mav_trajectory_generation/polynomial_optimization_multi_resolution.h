@@ -0,0 +1,129 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_H_
+#define MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_H_
+
+#include <map>
+#include <vector>
+
+#include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
+
+namespace mav_trajectory_generation {
+
+// Parameters of the resolution levels.
+struct MultiResolutionParameters {
+  // Every subsampling-th vertex of a level is kept on the next coarser level.
+  size_t subsampling = 2;
+
+  // Coarser levels are only added while they keep at least this many
+  // segments.
+  size_t min_segments = 8;
+
+  // Maximum number of levels, including the full resolution. Chosen
+  // automatically from the number of segments if 0.
+  size_t max_levels = 0;
+
+  // Maximum number of iterations on all levels but the coarsest, which uses
+  // NonlinearOptimizationParameters::max_iterations.
+  int refinement_iterations = 100;
+};
+
+// Coarse-to-fine nonlinear time optimization for paths with dense vertices.
+// The segment times are first optimized on a subsampled set of vertices. The
+// optimized time of every coarse segment is then distributed over the finer
+// segments it covers, proportionally to their initial times, and serves as
+// initial guess for the next finer level, which only runs a few refinement
+// iterations. Vertices that constrain more than their position are kept on
+// all levels.
+// _N specifies the number of coefficients for the underlying polynomials.
+template <int _N = 10>
+class PolynomialOptimizationMultiResolution {
+  static_assert(_N % 2 == 0, "The number of coefficients has to be even.");
+
+ public:
+  enum { N = _N };
+
+  // Input: dimension = Spatial dimension of the problem. Usually 1 or 3.
+  // Input: parameters = Parameters for the nonlinear optimization of every
+  // level.
+  // Input: resolution_parameters = Parameters of the resolution levels.
+  PolynomialOptimizationMultiResolution(
+      size_t dimension, const NonlinearOptimizationParameters& parameters,
+      const MultiResolutionParameters& resolution_parameters =
+          MultiResolutionParameters());
+
+  // Sets up the optimization problem from a vector of Vertex objects and
+  // a vector of times between the vertices, and selects the levels.
+  bool setupFromVertices(
+      const Vertex::Vector& vertices, const std::vector<double>& segment_times,
+      int derivative_to_optimize =
+          PolynomialOptimization<N>::kHighestDerivativeToOptimize);
+
+  // Adds a constraint for the maximum of magnitude to every level. See
+  // PolynomialOptimizationNonLinear::addMaximumMagnitudeConstraint().
+  bool addMaximumMagnitudeConstraint(int derivative, double maximum_value);
+
+  // Optimizes all levels from coarse to fine. Returns the nlopt result of the
+  // full resolution level.
+  int optimize();
+
+  // Returns the trajectory at full resolution. Only valid after optimize().
+  void getTrajectory(Trajectory* trajectory) const;
+
+  // Returns the number of levels, including the full resolution.
+  size_t getNumberOfLevels() const { return level_vertex_indices_.size(); }
+
+  // Returns the indices of the vertices used on a level. Level 0 is the full
+  // resolution.
+  const std::vector<size_t>& getLevelVertexIndices(size_t level) const {
+    CHECK_LT(level, level_vertex_indices_.size());
+    return level_vertex_indices_[level];
+  }
+
+  // Returns the optimization info of every level, from fine to coarse.
+  const std::vector<OptimizationInfo>& getLevelOptimizationInfos() const {
+    return level_infos_;
+  }
+
+ private:
+  // Selects the vertices of all levels.
+  void computeLevels();
+
+  size_t dimension_;
+  NonlinearOptimizationParameters optimization_parameters_;
+  MultiResolutionParameters resolution_parameters_;
+
+  Vertex::Vector vertices_;
+  std::vector<double> segment_times_;
+  int derivative_to_optimize_;
+  std::map<int, double> maximum_magnitude_constraints_;
+
+  // Indices into vertices_ per level, from fine to coarse.
+  std::vector<std::vector<size_t> > level_vertex_indices_;
+  std::vector<OptimizationInfo> level_infos_;
+  Trajectory trajectory_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_MULTI_RESOLUTION_H_
+
+#include "mav_trajectory_generation/impl/polynomial_optimization_multi_resolution_impl.h"
@@ -21,9 +21,12 @@
 #ifndef MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_NONLINEAR_H_
 #define MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_NONLINEAR_H_
 
+#include <chrono>
 #include <memory>
 #include <nlopt.hpp>
 
+#include "mav_trajectory_generation/bound_constrained_optimizer.h"
+#include "mav_trajectory_generation/optimization_trace.h"
 #include "mav_trajectory_generation/polynomial_optimization_linear.h"
 
 namespace mav_trajectory_generation {
@@ -85,17 +88,60 @@ struct NonlinearOptimizationParameters {
   // Weights the relative violation of a soft constraint.
   double soft_constraint_weight = 100.0;
 
+  // Formulation of the maximum magnitude constraints as soft constraints.
+  enum SoftConstraintMethod {
+    // exp(soft_constraint_weight * relative violation of the peak
+    // magnitude). Requires a maximum search in every evaluation and is not
+    // smooth where the time of the peak jumps.
+    kPeakViolation,
+    // soft_constraint_integral_weight * integral over time of the squared
+    // relative exceedance (|d|^2 - max^2) / max^2 where it is positive.
+    // Computed analytically between the crossings of the limit, smooth in
+    // the optimization variables. The maxima in OptimizationInfo are only
+    // computed once for the final solution.
+    kIntegralViolation
+  } soft_constraint_method = kPeakViolation;
+
+  // Weights the integral of kIntegralViolation.
+  double soft_constraint_integral_weight = 1.0e6;
+
+  // Relative accuracy of the segment times found by kMinimumTime. Segment
+  // times are reduced until shortening any of them by more than this
+  // fraction would violate a limit.
+  double minimum_time_tolerance_rel = 1.0e-3;
+
+  // Backend for kSquaredTime and kRichterTime. The other time allocation
+  // methods always run on nlopt.
+  enum Solver {
+    // nlopt with the algorithm above.
+    kNlopt,
+    // Built-in projected L-BFGS with finite-difference gradients. It does not
+    // support hard constraints, for which nlopt is used instead.
+    kProjectedLbfgs
+  } solver = kNlopt;
+
+  // Keeps the curvature information of the kProjectedLbfgs solver between
+  // calls to optimize(), e.g. to speed up replanning.
+  bool warm_start = false;
+
   enum TimeAllocMethod {
     kSquaredTime,
     kRichterTime,
     kMellingerOuterLoop,
     kSquaredTimeAndConstraints,
     kRichterTimeAndConstraints,
+    // Fastest trajectory that meets all constraints as hard limits. Ignores
+    // time_penalty and nlopt settings, see optimizeMinimumTime().
+    kMinimumTime,
     kUnknown
   } time_alloc_method = kSquaredTimeAndConstraints;
 
   bool print_debug_info = false;
   bool print_debug_info_time_allocation = false;
+
+  // Number of objective evaluations recorded in the trace of an optimization,
+  // see PolynomialOptimizationNonLinear::getTrace(). Disabled if 0.
+  size_t trace_capacity = 0;
 };
 
 struct OptimizationInfo {
@@ -106,6 +152,14 @@ struct OptimizationInfo {
   double cost_soft_constraints = 0.0;
   double optimization_time = 0.0;
   std::map<int, Extremum> maxima;
+  // Minimum distance to each neighbour of the separation constraints.
+  std::vector<Extremum> separation_minima;
+  // Largest signed distance outside of the corridor per constrained segment.
+  // Negative values mean that the segment stays inside.
+  std::map<size_t, double> corridor_violations;
+  // Derivatives whose maximum magnitude constraint limits the result of
+  // minimum-time allocation.
+  std::vector<int> active_constraints;
 };
 
 std::ostream& operator<<(std::ostream& stream, const OptimizationInfo& val);
@@ -145,11 +199,26 @@ class PolynomialOptimizationNonLinear {
   // between two vertices. Thus, its size is size(vertices) - 1.
   // Input: derivative_to_optimize = Specifies the derivative of which the
   // cost is optimized.
+  // For replanning, the same object can be set up again after reset(). The
+  // linear problem keeps its buffers, and the nlopt object is kept if the
+  // number of optimization variables does not change.
   bool setupFromVertices(
       const Vertex::Vector& vertices, const std::vector<double>& segment_times,
       int derivative_to_optimize =
           PolynomialOptimization<N>::kHighestDerivativeToOptimize);
 
+  // Removes all constraints and the results of the last optimization, to
+  // set up a new problem on this object. Allocated memory, the nlopt object
+  // and the parameters are kept.
+  void reset();
+
+  // Sets up the optimization problem from a linear problem that has already
+  // been set up, e.g. with PolynomialOptimization::updateVertices() from the
+  // problem of another vehicle. The segment times of poly_opt are the
+  // initial guess.
+  bool setupFromPolynomialOptimization(
+      const PolynomialOptimization<N>& poly_opt);
+
   // Adds a constraint for the maximum of magnitude to the optimization
   // problem.
   // Input: derivative_order = Order of the derivative, for which the
@@ -158,6 +227,38 @@ class PolynomialOptimizationNonLinear {
   bool addMaximumMagnitudeConstraint(int derivative_order,
                                      double maximum_value);
 
+  // Adds a constraint on the minimum distance between the optimized
+  // trajectory and each of the given neighbour trajectories, e.g. the planned
+  // trajectories of other vehicles. All trajectories start at time 0 and
+  // vehicles hold their final position once their trajectory has ended. The
+  // distance is measured in the first min(dimension, 3) dimensions and is
+  // computed exactly from the minima of the squared-distance polynomials.
+  // Like the magnitude constraints, these are soft constraints unless
+  // use_soft_constraints is false.
+  // Input: neighbours = Fixed trajectories of the other vehicles.
+  // Input: minimum_distance = Minimum allowed distance to every neighbour.
+  bool addMinimumSeparationConstraint(const std::vector<Trajectory>& neighbours,
+                                      double minimum_distance);
+
+  // Adds a constraint that keeps a segment inside a convex polytope
+  // {p | A * p <= b}, e.g. one element of a safe flight corridor. The
+  // polytope is defined in the first min(dimension, 3) dimensions. The
+  // constraint is checked exactly through the maxima of the polynomials
+  // a_j * p(t) - b_j of every face j over the segment. Like the magnitude
+  // constraints, this is a soft constraint (with the signed distance to the
+  // polytope as violation) unless use_soft_constraints is false.
+  // Input: segment_idx = Index of the constrained segment.
+  // Input: A = Face normals, one row per face.
+  // Input: b = Face offsets.
+  bool addCorridorConstraint(size_t segment_idx, const Eigen::MatrixXd& A,
+                             const Eigen::VectorXd& b);
+
+  // Adds one corridor constraint per segment, see addCorridorConstraint().
+  // Input: polytopes = (A, b) for every segment.
+  bool addCorridorConstraints(
+      const std::vector<std::pair<Eigen::MatrixXd, Eigen::VectorXd> >&
+          polytopes);
+
   // Solves the linear optimization problem according to [1].
   // The solver is re-used for every dimension, which means:
   //  - segment times are equal for each dimension.
@@ -185,11 +286,16 @@ class PolynomialOptimizationNonLinear {
   // Returns a non-const reference to the underlying linear optimization
   // object.
   PolynomialOptimization<N>& getPolynomialOptimizationRef() {
+    invalidateEvaluationCache();
     return poly_opt_;
   }
 
   OptimizationInfo getOptimizationInfo() const { return optimization_info_; }
 
+  // Returns the objective evaluations of the last optimization, if
+  // NonlinearOptimizationParameters::trace_capacity is set.
+  const OptimizationTrace& getTrace() const { return trace_; }
+
   // Functions for optimization, but may be useful for diagnostics outside.
   // Gets the trajectory cost (same as the cost in the linear problem).
   double getCost() const;
@@ -210,16 +316,45 @@ class PolynomialOptimizationNonLinear {
     double value;
   };
 
-  // Objective function for the time-only version.
-  // Input: segment_times = Segment times in the current iteration.
-  // Input: gradient = Gradient of the objective function w.r.t. changes of
-  // parameters. We can't compute the gradient analytically here.
-  // Thus, only gradient-free optimization methods are possible.
-  // Input: Custom data pointer = In our case, it's an ConstraintData object.
-  // Output: Cost = based on the parameters passed in.
-  static double objectiveFunctionTime(const std::vector<double>& segment_times,
-                                      std::vector<double>& gradient,
-                                      void* data);
+  // Holds the data for evaluating the corridor of one segment. The rows of
+  // A are normalized, such that A * p - b is the signed distance to the
+  // faces.
+  struct CorridorConstraintData {
+    PolynomialOptimizationNonLinear<N>* this_object;
+    size_t segment_idx;
+    Eigen::MatrixXd A;
+    Eigen::VectorXd b;
+  };
+
+  // Holds the data for evaluating the separation to one neighbour.
+  struct SeparationConstraintData {
+    PolynomialOptimizationNonLinear<N>* this_object;
+    size_t neighbour_idx;
+    Trajectory neighbour;
+    double minimum_distance;
+  };
+
+  // How an evaluation of the objective of the time allocation methods is
+  // accounted for.
+  enum Evaluation {
+    // A point of the optimizer: counted in the iterations, traced and
+    // reported in the optimization info.
+    kIterate,
+    // A finite-difference probe around an iterate: not accounted for.
+    kProbe,
+    // The returned optimum: its costs are reported.
+    kOptimum
+  };
+
+  // Objective function of kSquaredTime, kRichterTime,
+  // kSquaredTimeAndConstraints and kRichterTimeAndConstraints: trajectory
+  // cost, time penalty and soft constraints.
+  // Input: x = Optimization variables, stacked as [segment_times
+  // derivatives_dim_0 ... derivatives_dim_N]. The derivatives are only
+  // present for the methods that optimize them.
+  // Output: Cost based on the parameters passed in.
+  double evaluateTimeObjective(const Eigen::Ref<const Eigen::VectorXd>& x,
+                               Evaluation evaluation);
 
   // Objective function for the time-only Mellinger Outer Loop.
   // Input: segment_times = Segment times in the current iteration.
@@ -232,22 +367,6 @@ class PolynomialOptimizationNonLinear {
       const std::vector<double>& segment_times, std::vector<double>& gradient,
       void* data);
 
-  // Objective function for the version optimizing segment times and free
-  // derivatives.
-  // Input: optimization_variables = Optimization variables times in the
-  // current iteration.
-  // The variables (time, derivatives) are stacked as follows: [segment_times
-  // derivatives_dim_0 ... derivatives_dim_N]
-  // Input: gradient = Gradient of the objective function wrt. changes of
-  // parameters. We can't compute the gradient analytically here.
-  // Thus, only gradient free optimization methods are possible.
-  // Input: data = Custom data pointer. In our case, it's an ConstraintData
-  // object.
-  // Output: Cost based on the parameters passed in.
-  static double objectiveFunctionTimeAndConstraints(
-      const std::vector<double>& optimization_variables,
-      std::vector<double>& gradient, void* data);
-
   // Evaluates the maximum magnitude constraint at the current value of
   // the optimization variables.
   // All input parameters are ignored, all information is contained in data.
@@ -255,6 +374,51 @@ class PolynomialOptimizationNonLinear {
       const std::vector<double>& optimization_variables,
       std::vector<double>& gradient, void* data);
 
+  // Creates the nlopt object for the current problem size, or resets the
+  // existing one if it has the right size.
+  void setupNlopt();
+
+  // Applies the optimization variables x of the current time allocation
+  // method to the linear problem and solves it, unless x is the point that
+  // was evaluated last. The objective and all constraint callbacks go
+  // through here, such that each distinct x is only solved once.
+  void updateOptimizationVariables(const std::vector<double>& x);
+  void updateOptimizationVariables(const Eigen::Ref<const Eigen::VectorXd>& x);
+
+  // Has to be called whenever poly_opt_ is changed other than through
+  // updateOptimizationVariables().
+  void invalidateEvaluationCache() const;
+
+  // Returns the maximum of magnitude of a derivative of the current solution.
+  // It is computed at most once per evaluated point.
+  const Extremum& getMaximumOfMagnitude(int derivative) const;
+
+  // Returns the trajectory of the current solution. It is extracted at most
+  // once per evaluated point.
+  const Trajectory& getCurrentTrajectory() const;
+
+  // Evaluates the minimum separation constraint to one neighbour at the
+  // current value of the optimization variables. Returns
+  // minimum_distance - distance, i.e. a positive value means violation.
+  // All input parameters are ignored, all information is contained in data.
+  static double evaluateMinimumSeparationConstraint(
+      const std::vector<double>& optimization_variables,
+      std::vector<double>& gradient, void* data);
+
+  // Evaluates the corridor constraint of one segment at the current value of
+  // the optimization variables. Returns the largest signed distance of the
+  // segment to the outside of the polytope, i.e. a positive value means
+  // violation.
+  // All input parameters are ignored, all information is contained in data.
+  static double evaluateCorridorConstraint(
+      const std::vector<double>& optimization_variables,
+      std::vector<double>& gradient, void* data);
+
+  // Computes the largest signed distance of the current segment to the
+  // outside of its polytope and records it in the optimization info.
+  static double computeCorridorViolation(
+      const CorridorConstraintData& constraint);
+
   // Does the actual optimization work for the time-only version.
   int optimizeTime();
   int optimizeTimeMellingerOuterLoop();
@@ -262,6 +426,37 @@ class PolynomialOptimizationNonLinear {
   // Does the actual optimization work for the full optimization version.
   int optimizeTimeAndFreeConstraints();
 
+  // Records the costs of an objective evaluation and the current segment
+  // times in the trace, if enabled.
+  void recordTrace(double cost_trajectory, double cost_time,
+                   double cost_soft_constraints);
+
+  // Whether the built-in optimizer is selected and can handle the time-only
+  // problem.
+  bool useNativeSolver() const;
+
+  // Minimizes evaluateTimeObjective() with the built-in optimizer, or with
+  // nlopt_ and the hard constraints registered on it.
+  // Input: initial_step = Initial step of nlopt.
+  // Input/Output: x = Initial guess, overwritten by the optimum.
+  int minimizeTimeObjective(const Eigen::VectorXd& lower_bounds,
+                            const Eigen::VectorXd& upper_bounds,
+                            const std::vector<double>& initial_step,
+                            Eigen::VectorXd* x);
+
+  // Minimum-time allocation. Scales all segment times uniformly until the
+  // maximum magnitude constraints are just met, then shortens one segment at
+  // a time by bisection for as long as all constraints remain satisfied.
+  // Constraints are evaluated exactly on the extrema of the solution. The
+  // symbolic factorization of the linear problem is shared by all trials.
+  int optimizeMinimumTime();
+
+  // Solves the linear problem for the current segment times and returns
+  // whether all constraints are met.
+  bool solveAndCheckConstraints(
+      typename PolynomialOptimization<N>::LinearSolver* solver,
+      bool analyze_pattern);
+
   // Evaluates the maximum magnitude constraints as soft constraints and
   // returns a cost, depending on the violation of the constraints.
   // cost_i = min(maximum_cost, exp(abs_violation_i / max_allowed_i * weight))
@@ -277,6 +472,36 @@ class PolynomialOptimizationNonLinear {
           inequality_constraints,
       double weight, double maximum_cost = 1.0e12) const;
 
+  // Evaluates the maximum magnitude constraints as
+  // NonlinearOptimizationParameters::kIntegralViolation:
+  // cost_i = min(maximum_cost, weight *
+  //     integral(max(0, |d_i(t)|^2 - max_i^2)^2 / max_i^4 dt))
+  // The squared magnitude minus the squared limit is a polynomial per
+  // segment. Its real roots split the segment into intervals of constant
+  // sign, over which the square of the polynomial is integrated in closed
+  // form.
+  // Output: Sum of the costs per constraint.
+  double evaluateMaximumMagnitudeAsIntegralSoftConstraint(
+      double weight, double maximum_cost) const;
+
+  // Evaluates the minimum separation constraints as soft constraints, in the
+  // same way as evaluateMaximumMagnitudeAsSoftConstraint():
+  // cost_i = min(maximum_cost, exp(violation_i / minimum_distance_i * weight))
+  // Output: Sum of the costs per neighbour.
+  double evaluateMinimumSeparationAsSoftConstraint(
+      double weight, double maximum_cost = 1.0e12) const;
+
+  // Evaluates the corridor constraints as soft constraints:
+  // cost_i = min(maximum_cost, exp(signed_distance_i * weight))
+  // Output: Sum of the costs per constrained segment.
+  double evaluateCorridorAsSoftConstraint(double weight,
+                                          double maximum_cost = 1.0e12) const;
+
+  // Computes the separation of the given trajectory to a neighbour and
+  // records it in the optimization info.
+  static Extremum computeSeparation(const SeparationConstraintData& constraint,
+                                    const Trajectory& trajectory);
+
   // Set lower and upper bounds on the optimization parameters
   void setFreeEndpointDerivativeHardConstraints(
       const Vertex::Vector& vertices, std::vector<double>* lower_bounds,
@@ -292,6 +517,9 @@ class PolynomialOptimizationNonLinear {
   // nlopt optimization object.
   std::shared_ptr<nlopt::opt> nlopt_;
 
+  // Built-in optimizer, created on first use.
+  std::shared_ptr<ProjectedLbfgsOptimizer> native_optimizer_;
+
   // Underlying linear optimization object.
   PolynomialOptimization<N> poly_opt_;
 
@@ -301,7 +529,23 @@ class PolynomialOptimizationNonLinear {
   // Holds the data for evaluating inequality constraints.
   std::vector<std::shared_ptr<ConstraintData> > inequality_constraints_;
 
+  // Holds the data for evaluating corridor constraints.
+  std::vector<std::shared_ptr<CorridorConstraintData> > corridor_constraints_;
+
+  // Holds the data for evaluating separation constraints.
+  std::vector<std::shared_ptr<SeparationConstraintData> >
+      separation_constraints_;
+
   OptimizationInfo optimization_info_;
+
+  // Objective evaluations of the current optimization.
+  OptimizationTrace trace_;
+  std::chrono::high_resolution_clock::time_point optimization_start_;
+
+  // Evaluation cache, valid for the optimization variables evaluated_x_.
+  mutable Eigen::VectorXd evaluated_x_;
+  mutable std::map<int, Extremum> evaluated_maxima_;
+  mutable Trajectory evaluated_trajectory_;
 };
 
 }  // namespace mav_trajectory_generation
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_WINDOWED_H_
+#define MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_WINDOWED_H_
+
+#include <map>
+#include <vector>
+
+#include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
+#include "mav_trajectory_generation/thread_pool.h"
+
+namespace mav_trajectory_generation {
+
+// Parameters of the decomposition into windows.
+struct WindowedOptimizationParameters {
+  // Number of segments a window is responsible for.
+  size_t window_segments = 20;
+
+  // Number of segments a window additionally optimizes on each side of its
+  // own segments. The overlap lets a window see the path beyond its cuts.
+  size_t overlap_segments = 5;
+
+  // Number of optimization sweeps over all windows. Every other sweep shifts
+  // the cuts by half a window, such that the segments around the cuts of one
+  // sweep are in the middle of a window in the next.
+  size_t n_sweeps = 2;
+};
+
+// Nonlinear time optimization of very long paths by domain decomposition.
+// The vertices are split into overlapping windows, which are optimized
+// independently and in parallel with PolynomialOptimizationNonLinear. After
+// the last sweep, the states at each cut are averaged between the two windows
+// meeting there and fixed, and every window's segments are solved once more
+// with the optimized segment times. The resulting trajectory is as smooth at
+// the cuts as everywhere else, but only near-optimal: the windows do not
+// share the trajectory cost of the full path.
+// _N specifies the number of coefficients for the underlying polynomials.
+template <int _N = 10>
+class PolynomialOptimizationWindowed {
+  static_assert(_N % 2 == 0, "The number of coefficients has to be even.");
+
+ public:
+  enum { N = _N };
+
+  // Input: dimension = Spatial dimension of the problem. Usually 1 or 3.
+  // Input: parameters = Parameters for the nonlinear optimization of each
+  // window.
+  // Input: window_parameters = Parameters of the decomposition.
+  // Input: n_threads = Number of threads optimizing windows. If 0, the
+  // number of hardware threads is used.
+  PolynomialOptimizationWindowed(
+      size_t dimension, const NonlinearOptimizationParameters& parameters,
+      const WindowedOptimizationParameters& window_parameters =
+          WindowedOptimizationParameters(),
+      size_t n_threads = 0);
+
+  // Sets up the optimization problem from a vector of Vertex objects and
+  // a vector of times between the vertices. Same as
+  // PolynomialOptimization::setupFromVertices().
+  bool setupFromVertices(
+      const Vertex::Vector& vertices, const std::vector<double>& segment_times,
+      int derivative_to_optimize =
+          PolynomialOptimization<N>::kHighestDerivativeToOptimize);
+
+  // Adds a constraint for the maximum of magnitude to every window. See
+  // PolynomialOptimizationNonLinear::addMaximumMagnitudeConstraint().
+  bool addMaximumMagnitudeConstraint(int derivative, double maximum_value);
+
+  // Runs the sweeps and the final solve. Returns false if the optimization
+  // of a window failed, see getWindowOptimizationInfos(). The trajectory is
+  // assembled nevertheless.
+  bool optimize();
+
+  // Returns the trajectory over all segments. Only valid after optimize().
+  void getTrajectory(Trajectory* trajectory) const;
+
+  // Returns the optimized segment times of all segments.
+  const std::vector<double>& getSegmentTimes() const { return segment_times_; }
+
+  // Returns the number of windows of the last sweep.
+  size_t getNumberOfWindows() const { return window_infos_.size(); }
+
+  // Returns the optimization info of every window of the last sweep.
+  const std::vector<OptimizationInfo>& getWindowOptimizationInfos() const {
+    return window_infos_;
+  }
+
+ private:
+  // Range [start, end) of segments a window is responsible for, and the
+  // extended range it optimizes.
+  struct Window {
+    size_t start;
+    size_t end;
+    size_t extended_start;
+    size_t extended_end;
+  };
+
+  // Splits the segments into windows, with the first cut at offset segments
+  // after the start of the previous window.
+  void computeWindows(size_t offset, std::vector<Window>* windows) const;
+
+  // Evaluates derivatives 0 to kHighestDerivativeToOptimize at the vertex
+  // with the given index of the full path, for the solution of a window.
+  // Output: state = Matrix with one row per derivative.
+  void getVertexState(const Window& window, const Trajectory& trajectory,
+                      size_t vertex_idx, Eigen::MatrixXd* state) const;
+
+  size_t dimension_;
+  NonlinearOptimizationParameters optimization_parameters_;
+  WindowedOptimizationParameters window_parameters_;
+  ThreadPool thread_pool_;
+
+  Vertex::Vector vertices_;
+  std::vector<double> segment_times_;
+  int derivative_to_optimize_;
+  std::map<int, double> maximum_magnitude_constraints_;
+
+  Segment::Vector segments_;
+  std::vector<OptimizationInfo> window_infos_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_POLYNOMIAL_OPTIMIZATION_WINDOWED_H_
+
+#include "mav_trajectory_generation/impl/polynomial_optimization_windowed_impl.h"
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_QP_SOLVER_H_
+#define MAV_TRAJECTORY_GENERATION_QP_SOLVER_H_
+
+#include <Eigen/Sparse>
+#include <Eigen/SparseCholesky>
+#include <vector>
+
+namespace mav_trajectory_generation {
+
+// Parameters of AdmmQpSolver.
+struct AdmmQpParameters {
+  // Initial penalty of the constraint residual.
+  double rho = 0.1;
+  // Regularization of the x-update, keeps the system positive definite.
+  double sigma = 1.0e-6;
+  // Over-relaxation, between 0 and 2.
+  double alpha = 1.6;
+  // Converged if the primal residual |G x - z| and the dual residual
+  // |P x + q + G^T y| are below eps_abs + eps_rel * (scale of the terms).
+  double eps_abs = 1.0e-4;
+  double eps_rel = 1.0e-4;
+  int max_iterations = 4000;
+  // Number of iterations after which rho is adapted to balance the
+  // residuals. Disabled if 0.
+  int rho_update_interval = 25;
+  // Number of Ruiz equilibration iterations scaling the problem before it
+  // is solved.
+  int n_scaling_iterations = 10;
+  // Solves the equality-constrained problem on the active set guessed from
+  // the iterates every rho_update_interval iterations and at convergence.
+  // The polished solution meets the bounds to eps_abs regardless of the
+  // tolerances of the iteration.
+  bool polish = true;
+  // Starts from the last solution, if the problem size did not change.
+  bool warm_start = true;
+};
+
+// Solves convex quadratic programs
+//   min 0.5 * x^T P x + q^T x  s.t.  lower <= G x <= upper
+// with the alternating direction method of multipliers as in OSQP [1]. The
+// problem is equilibrated first, such that the method is insensitive to the
+// scale of the cost and the constraints. Every iteration solves one linear
+// system with the sparse matrix P + sigma * I + rho * G^T G, which is
+// factorized once (and again when rho is adapted), so the cost per iteration
+// is a pair of sparse triangular solves. The iterates are polished on their
+// active set, which gives an exact solution once ADMM has identified it.
+// Equality constraints are expressed as lower = upper.
+// [1]: OSQP: An Operator Splitting Solver for Quadratic Programs.
+// Bartolomeo Stellato, Goran Banjac, Paul Goulart, Alberto Bemporad and
+// Stephen Boyd. Mathematical Programming Computation, 2020.
+class AdmmQpSolver {
+ public:
+  // Iterates of the method, kept between solves for warm starts.
+  struct State {
+    Eigen::VectorXd x;
+    // Projection of G x onto the bounds.
+    Eigen::VectorXd z;
+    // Dual variables of the constraints.
+    Eigen::VectorXd y;
+  };
+
+  struct Info {
+    int n_iterations = 0;
+    double primal_residual = 0.0;
+    double dual_residual = 0.0;
+    double rho = 0.0;
+    bool converged = false;
+    // Whether the solution is the polished one.
+    bool polished = false;
+  };
+
+  explicit AdmmQpSolver(
+      const AdmmQpParameters& parameters = AdmmQpParameters());
+
+  // Input: P = Symmetric positive semidefinite cost matrix.
+  // Input: q = Linear cost.
+  // Input: G = Constraint matrix, may have zero rows.
+  // Input: lower, upper = Bounds on G x. Infinite values are allowed.
+  // Input/Output: state = Initial iterates if warm_start is set and the sizes
+  // match, overwritten by the final iterates. state->x is the solution.
+  // Output: info = Optional statistics.
+  // Returns whether the method converged.
+  bool solve(const Eigen::SparseMatrix<double>& P, const Eigen::VectorXd& q,
+             const Eigen::SparseMatrix<double>& G,
+             const Eigen::VectorXd& lower, const Eigen::VectorXd& upper,
+             State* state, Info* info = nullptr);
+
+  const AdmmQpParameters& getParameters() const { return parameters_; }
+
+ private:
+  // Factorizes P + sigma * I + rho * G^T G.
+  bool factorize(const Eigen::SparseMatrix<double>& P,
+                 const Eigen::SparseMatrix<double>& G, double rho,
+                 bool analyze_pattern);
+
+  // Solves the problem with the active constraints at their bounds, -1 for
+  // lower and 1 for upper, and the others dropped.
+  // Input/Output: x, y = Primal and dual solution, only written on success.
+  // Returns whether the solution meets all bounds within the tolerance and
+  // the multipliers have the signs of an optimum.
+  static bool polish(const Eigen::SparseMatrix<double>& P,
+                     const Eigen::VectorXd& q,
+                     const Eigen::SparseMatrix<double>& G,
+                     const Eigen::VectorXd& lower, const Eigen::VectorXd& upper,
+                     const std::vector<int>& active,
+                     const Eigen::VectorXd& tolerance, Eigen::VectorXd* x,
+                     Eigen::VectorXd* y);
+
+  AdmmQpParameters parameters_;
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > solver_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_QP_SOLVER_H_
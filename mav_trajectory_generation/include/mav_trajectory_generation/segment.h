@@ -23,8 +23,10 @@
 
 #include <glog/logging.h>
 #include <Eigen/Core>
+#include <Eigen/Geometry>
 #include <chrono>
 #include <map>
+#include <memory>
 #include <vector>
 
 #include "mav_trajectory_generation/extremum.h"
@@ -40,14 +42,23 @@ constexpr double kNumSecPerNsec = 1.0e-9;
 // Time of the segment and one polynomial for each dimension.
 //    X------------X---------------X
 //  vertex             segment
+// The polynomials are copy-on-write: copies of a segment, e.g. in the
+// versions of a trajectory during replanning, share them until one of the
+// copies is modified through a non-const accessor. References obtained from
+// the non-const operator[] are invalidated by copying the segment.
 class Segment {
  public:
   typedef std::vector<Segment> Vector;
 
-  Segment(int N, int D) : time_(0.0), N_(N), D_(D) {
-    polynomials_.resize(D_, Polynomial(N_));
-  }
+  Segment(int N, int D)
+      : polynomials_(std::make_shared<Polynomial::Vector>(D, Polynomial(N))),
+        time_(0.0),
+        N_(N),
+        D_(D) {}
   Segment(const Segment& segment) = default;
+  Segment(Segment&& segment) = default;
+  Segment& operator=(const Segment& segment) = default;
+  Segment& operator=(Segment&& segment) = default;
 
   bool operator==(const Segment& rhs) const;
   inline bool operator!=(const Segment& rhs) const { return !operator==(rhs); }
@@ -66,7 +77,12 @@ class Segment {
 
   const Polynomial& operator[](size_t idx) const;
 
-  const Polynomial::Vector& getPolynomialsRef() const { return polynomials_; }
+  const Polynomial::Vector& getPolynomialsRef() const { return *polynomials_; }
+
+  // Returns whether this segment and the given one share their polynomials.
+  bool sharesPolynomialsWith(const Segment& segment) const {
+    return polynomials_ == segment.polynomials_;
+  }
 
   Eigen::VectorXd evaluate(
       double t, int derivative_order = derivative_order::POSITION) const;
@@ -118,8 +134,36 @@ class Segment {
  // Offset this segment by vector A_r_B.
  bool offsetSegment(const Eigen::VectorXd& A_r_B);
 
+  // Transforms this segment from frame B to frame A, p_A = T_A_B * p_B,
+  // directly on the coefficients: the position coefficients (first three
+  // dimensions) are multiplied with the linear part of T_A_B, and the
+  // translation is added to the constant coefficients. The linear part may
+  // contain a uniform scale or a mirroring. If the segment has a 4th
+  // dimension, it is treated as yaw and rotated (or mirrored) with the
+  // transformation, which then has to keep the z-axis vertical and scale the
+  // horizontal axes uniformly.
+  // Returns false if the segment has less than three dimensions or the
+  // transformation tilts the z-axis, shears or scales the horizontal axes
+  // non-uniformly for a segment with yaw.
+  bool transformSegment(const Eigen::Affine3d& T_A_B);
+
+  // Gets the part of this segment between t_start and t_end as a new segment
+  // that starts at time 0. The polynomials of all dimensions are shifted to
+  // t_start together, see Polynomial::shiftCoefficientsInTime(). For
+  // t_start = 0, the coefficients are copied unchanged.
+  // Returns false if not 0 <= t_start < t_end <= segment time.
+  bool crop(double t_start, double t_end, Segment* cropped) const;
+
+  // Splits this segment at time t into the parts before and after t.
+  // Returns false if t is not inside the segment.
+  bool split(double t, Segment* first, Segment* second) const;
+
  protected:
-  Polynomial::Vector polynomials_;
+  // Returns the polynomials for modification, after detaching them from all
+  // other segments that share them.
+  Polynomial::Vector& mutablePolynomials();
+
+  std::shared_ptr<Polynomial::Vector> polynomials_;
   double time_;
 
  private:
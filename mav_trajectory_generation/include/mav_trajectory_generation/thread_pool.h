@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_THREAD_POOL_H_
+#define MAV_TRAJECTORY_GENERATION_THREAD_POOL_H_
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace mav_trajectory_generation {
+
+// Fixed-size pool of worker threads that executes parallel loops. The
+// workers are started once and sleep between loops, such that short loops
+// (e.g. one solve per vehicle of a fleet every planning cycle) do not pay
+// for thread creation.
+class ThreadPool {
+ public:
+  // Starts the worker threads.
+  // Input: n_threads = Number of threads working on a loop, including the
+  // calling thread. If 0, std::thread::hardware_concurrency() is used.
+  explicit ThreadPool(size_t n_threads = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  // Returns the number of threads working on a loop, including the
+  // calling thread.
+  size_t getNumberOfThreads() const { return workers_.size() + 1; }
+
+  // Calls function(i) for every i in [0, n) and blocks until all calls have
+  // returned. The indices are handed out dynamically to the workers and the
+  // calling thread, so the order of the calls is unspecified. Loops that are
+  // started from within another parallel loop (of any pool) run serially on
+  // the calling thread, which avoids both deadlocks and oversubscription, as
+  // do loops started while another thread is running a loop on the pool.
+  void parallelFor(size_t n, const std::function<void(size_t)>& function);
+
+ private:
+  // Waits for loops and works on them until the pool is destroyed.
+  void workerLoop();
+
+  // Processes indices of the current loop until none are left.
+  void processIndices();
+
+  std::vector<std::thread> workers_;
+
+  // Held by the thread running a loop on the pool.
+  std::mutex loop_mutex_;
+
+  // Protects the loop state below.
+  std::mutex mutex_;
+  std::condition_variable loop_started_;
+  std::condition_variable loop_finished_;
+
+  const std::function<void(size_t)>* function_;
+  size_t n_indices_;
+  std::atomic<size_t> next_index_;
+  size_t n_busy_workers_;
+  size_t loop_id_;
+  bool stop_;
+};
+
+// Returns the pool shared by the library for parallel evaluations over
+// segments. It is started on first use with one thread per core.
+ThreadPool& getSharedThreadPool();
+
+// Sets the number of segments from which per-segment evaluations, e.g. the
+// extremum searches, are distributed over the shared pool. For fewer
+// segments, waking the workers costs more than it saves. 0 disables the
+// parallel evaluation. The default is 32.
+void setParallelSegmentThreshold(size_t n_segments);
+size_t getParallelSegmentThreshold();
+
+// Whether parallelForSegments() distributes n_segments over the shared pool.
+// Callers use it to keep a serial path without the buffers that a parallel
+// evaluation needs.
+bool runsSegmentsInParallel(size_t n_segments);
+
+// Calls function(i) for every segment index i in [0, n_segments). Runs on the
+// shared pool if n_segments reaches the parallel segment threshold and
+// serially on the calling thread otherwise.
+void parallelForSegments(size_t n_segments,
+                         const std::function<void(size_t)>& function);
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_THREAD_POOL_H_
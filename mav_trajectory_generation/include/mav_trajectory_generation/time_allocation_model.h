@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_TIME_ALLOCATION_MODEL_H_
+#define MAV_TRAJECTORY_GENERATION_TIME_ALLOCATION_MODEL_H_
+
+#include <Eigen/Core>
+#include <string>
+#include <vector>
+
+#include "mav_trajectory_generation/vertex.h"
+
+namespace mav_trajectory_generation {
+
+// Regression model that maps local path features to segment times.
+// The model is fitted offline on segment times found by
+// PolynomialOptimizationNonLinear and evaluated online in O(K) without
+// allocating memory. Its estimate is a drop-in replacement for
+// estimateSegmentTimes() and a good warm start for the nonlinear solver.
+//
+// For every segment, the features are computed from the segment length, the
+// normalized turn at both end vertices (0 = straight, 1 = full stop), the
+// relative length of the neighbouring segments and the ratio of the segment
+// length to the distance needed to accelerate to v_max. The regression target
+// is the ratio between the optimized segment time and the velocity ramp time
+// computed by computeTimeVelocityRamp().
+class TimeAllocationModel {
+ public:
+  static constexpr int kNumFeatures = 9;
+  typedef Eigen::Matrix<double, kNumFeatures, 1> FeatureVector;
+  typedef Eigen::Matrix<double, kNumFeatures, kNumFeatures> FeatureMatrix;
+
+  // Constructs an untrained model which predicts the velocity ramp time.
+  TimeAllocationModel();
+
+  // Computes the features of the segment between vertex segment_idx and
+  // segment_idx + 1. All vertices need a position constraint.
+  static void computeFeatures(const Vertex::Vector& vertices,
+                              size_t segment_idx, double v_max, double a_max,
+                              FeatureVector* features);
+
+  // Adds one training problem, e.g. the vertices passed to
+  // PolynomialOptimizationNonLinear and the segment times of its result
+  // (Trajectory::getSegmentTimes()). v_max and a_max should be the limits
+  // used during optimization.
+  void addSample(const Vertex::Vector& vertices,
+                 const std::vector<double>& segment_times, double v_max,
+                 double a_max);
+
+  // Fits the weights to all samples added so far by ridge regression.
+  // Returns false if no samples are available.
+  bool train(double regularization = 1.0e-6);
+
+  // Removes all accumulated samples, but keeps the current weights.
+  void clearSamples();
+
+  // Estimates the segment times for the vertices. Does not allocate memory
+  // if segment_times has already reserved vertices.size() - 1 elements.
+  void estimateSegmentTimes(const Vertex::Vector& vertices, double v_max,
+                            double a_max,
+                            std::vector<double>* segment_times) const;
+
+  // Convenience function returning a new vector.
+  std::vector<double> estimateSegmentTimes(const Vertex::Vector& vertices,
+                                           double v_max, double a_max) const;
+
+  size_t getNumberOfSamples() const { return n_samples_; }
+  const FeatureVector& getWeights() const { return weights_; }
+  void setWeights(const FeatureVector& weights) { weights_ = weights; }
+
+  // Stores and loads the model weights as a YAML file.
+  bool saveToFile(const std::string& filename) const;
+  bool loadFromFile(const std::string& filename);
+
+ private:
+  // Lower bound of the predicted ratio to the velocity ramp time.
+  static constexpr double kMinTimeRatio = 0.1;
+  // Lower bound of the predicted segment time.
+  static constexpr double kMinSegmentTime = 0.1;
+
+  FeatureVector weights_;
+
+  // Normal equations of the least squares problem accumulated from all
+  // samples: (J^T * J) * weights = J^T * y.
+  FeatureMatrix jtj_;
+  FeatureVector jty_;
+  size_t n_samples_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_TIME_ALLOCATION_MODEL_H_
@@ -27,6 +27,7 @@
 #include <chrono>
 #include <limits>
 #include <map>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -178,6 +179,10 @@ class Timing {
   list_t timers_;
   map_t tag_map_;
   size_t max_tag_length_;
+
+  // Timers may be used from several threads, e.g. when optimizing
+  // independent problems concurrently.
+  std::recursive_mutex mutex_;
 };
 
 #if DISABLE_TIMING
@@ -21,6 +21,9 @@
 #ifndef MAV_TRAJECTORY_GENERATION_TRAJECTORY_H_
 #define MAV_TRAJECTORY_GENERATION_TRAJECTORY_H_
 
+#include <iterator>
+#include <utility>
+
 #include "mav_trajectory_generation/extremum.h"
 #include "mav_trajectory_generation/segment.h"
 #include "mav_trajectory_generation/vertex.h"
@@ -32,6 +35,10 @@ namespace mav_trajectory_generation {
 class Trajectory {
  public:
   Trajectory() : D_(0), N_(0), max_time_(0.0) {}
+  Trajectory(const Trajectory&) = default;
+  Trajectory(Trajectory&&) = default;
+  Trajectory& operator=(const Trajectory&) = default;
+  Trajectory& operator=(Trajectory&&) = default;
   ~Trajectory() {}
 
   bool operator==(const Trajectory& rhs) const;
@@ -62,6 +69,20 @@ class Trajectory {
     addSegments(segments);
   }
 
+  // Same as above, but takes over the segments without copying them.
+  void setSegments(Segment::Vector&& segments) {
+    CHECK(!segments.empty());
+    D_ = segments.front().D();
+    N_ = segments.front().N();
+    max_time_ = 0.0;
+    for (const Segment& segment : segments) {
+      CHECK_EQ(segment.D(), D_);
+      CHECK_EQ(segment.N(), N_);
+      max_time_ += segment.getTime();
+    }
+    segments_ = std::move(segments);
+  }
+
   void addSegments(const Segment::Vector& segments) {
     for (const Segment& segment : segments) {
       CHECK_EQ(segment.D(), D_);
@@ -71,16 +92,42 @@ class Trajectory {
     segments_.insert(segments_.end(), segments.begin(), segments.end());
   }
 
+  // Same as above, but moves the segments instead of copying them.
+  void addSegments(Segment::Vector&& segments) {
+    for (const Segment& segment : segments) {
+      CHECK_EQ(segment.D(), D_);
+      CHECK_EQ(segment.N(), N_);
+      max_time_ += segment.getTime();
+    }
+    if (segments_.empty()) {
+      segments_ = std::move(segments);
+    } else {
+      segments_.insert(segments_.end(),
+                       std::make_move_iterator(segments.begin()),
+                       std::make_move_iterator(segments.end()));
+    }
+    segments.clear();
+  }
+
   void getSegments(Segment::Vector* segments) const {
     CHECK_NOTNULL(segments);
     *segments = segments_;
   }
 
+  // Moves the segments out and leaves the trajectory empty.
+  Segment::Vector releaseSegments() {
+    Segment::Vector segments = std::move(segments_);
+    clear();
+    return segments;
+  }
+
   const Segment::Vector& segments() const { return segments_; }
 
   double getMinTime() const { return 0.0; }
   double getMaxTime() const { return max_time_; }
   std::vector<double> getSegmentTimes() const;
+  // Same as above, but reuses the memory of *segment_times.
+  void getSegmentTimes(std::vector<double>* segment_times) const;
 
   // Functions to create new trajectories by splitting (getting a NEW trajectory
   // with a single dimension) or compositing (create a new trajectory with
@@ -89,6 +136,14 @@ class Trajectory {
   bool getTrajectoryWithAppendedDimension(
       const Trajectory& trajectory_to_append, Trajectory* new_trajectory) const;
 
+  // Gets the part of this trajectory between t_start and t_end as a new
+  // trajectory that starts at time 0, e.g. to replan from the current state
+  // or to execute only a window. Segments inside the interval are shared
+  // with this trajectory, only the first and the last one are cut, see
+  // Segment::crop().
+  // Returns false if not 0 <= t_start < t_end <= max time.
+  bool crop(double t_start, double t_end, Trajectory* cropped) const;
+
   // Add trajectories with same dimensions and coefficients to this trajectory.
   bool addTrajectories(const std::vector<Trajectory>& trajectories,
                        Trajectory* merged) const;
@@ -96,6 +151,11 @@ class Trajectory {
   // Offset this trajectory by vector A_r_B.
   bool offsetTrajectory(const Eigen::VectorXd& A_r_B);
 
+  // Transforms this trajectory from frame B to frame A, p_A = T_A_B * p_B,
+  // see Segment::transformSegment(). The 4th dimension, if any, is treated as
+  // yaw.
+  bool transformTrajectory(const Eigen::Affine3d& T_A_B);
+
   // Evaluate the vertex constraint at time t.
   Vertex getVertexAtTime(double t, int max_derivative_order) const;
   // Evaluate the vertex constraint at start time.
@@ -129,6 +189,18 @@ class Trajectory {
                               const std::vector<int>& dimensions,
                               Extremum* minimum, Extremum* maximum) const;
 
+  // Computes the exact minimum distance to another trajectory in the given
+  // dimensions, e.g. [0, 1, 2] for position, as the smallest of the minima
+  // of the squared-distance polynomials between all pairs of overlapping
+  // segments. Both trajectories start at time 0 and stay at their final
+  // state once they have ended. minimum->segment_idx is the segment of this
+  // trajectory, and minimum->time is relative to its start (it may exceed
+  // the segment time after this trajectory has ended).
+  // Returns false if either trajectory is empty or lacks a dimension.
+  bool computeMinimumDistance(const Trajectory& other,
+                              const std::vector<int>& dimensions,
+                              Extremum* minimum) const;
+
   // Compute max velocity and max acceleration. Shorthand for the method above.
   bool computeMaxVelocityAndAcceleration(double* v_max, double* a_max) const;
 
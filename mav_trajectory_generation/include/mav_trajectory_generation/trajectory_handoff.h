@@ -0,0 +1,95 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef MAV_TRAJECTORY_GENERATION_TRAJECTORY_HANDOFF_H_
+#define MAV_TRAJECTORY_GENERATION_TRAJECTORY_HANDOFF_H_
+
+#include <atomic>
+#include <cstdint>
+
+#include "mav_trajectory_generation/trajectory.h"
+
+namespace mav_trajectory_generation {
+
+// Hands trajectories from one planner thread to one controller (or sampler)
+// thread without locks. Triple buffer: the planner fills a back slot and
+// swaps it with the shared middle slot, the controller swaps its front slot
+// with the middle slot if a newer one was published. The controller side is
+// wait-free and neither allocates nor frees memory; trajectories that are
+// replaced are freed by the planner when it reuses their slot.
+class TrajectoryHandoff {
+ public:
+  // Trajectory together with the time base it is evaluated in.
+  struct Snapshot {
+    Snapshot() : start_time(0.0), version(0) {}
+
+    // Time on the caller's clock at which the trajectory starts.
+    double start_time;
+    // Number of the publish() call that wrote this snapshot, 0 if none.
+    uint64_t version;
+    Trajectory trajectory;
+
+    // Converts a time on the caller's clock to the time of the trajectory,
+    // clamped to [0, max time].
+    double getTrajectoryTime(double time) const;
+  };
+
+  TrajectoryHandoff();
+
+  TrajectoryHandoff(const TrajectoryHandoff&) = delete;
+  TrajectoryHandoff& operator=(const TrajectoryHandoff&) = delete;
+
+  // Planner side. Publishes a new trajectory that starts at start_time on
+  // the clock of the controller. Must only be called from one thread.
+  void publish(const Trajectory& trajectory, double start_time);
+  void publish(Trajectory&& trajectory, double start_time);
+
+  // Controller side. Returns the latest published snapshot. The reference
+  // stays valid and unchanged until the next call to acquire(), so a control
+  // cycle evaluates one consistent trajectory and time base even if the
+  // planner publishes meanwhile. Must only be called from one thread.
+  const Snapshot& acquire();
+
+  // Returns whether a snapshot was published since the last acquire().
+  bool hasUpdate() const;
+
+ private:
+  static constexpr uint32_t kIndexMask = 3;
+  static constexpr uint32_t kUpdateFlag = 4;
+
+  // Makes the back slot the middle slot.
+  void swapBackSlot();
+
+  Snapshot slots_[3];
+
+  // Index of the middle slot and kUpdateFlag if it was not acquired yet.
+  std::atomic<uint32_t> middle_;
+
+  // Owned by the planner.
+  uint32_t back_;
+  uint64_t n_published_;
+
+  // Owned by the controller.
+  uint32_t front_;
+};
+
+}  // namespace mav_trajectory_generation
+
+#endif  // MAV_TRAJECTORY_GENERATION_TRAJECTORY_HANDOFF_H_
@@ -146,6 +146,22 @@ double computeTimeVelocityRamp(const Eigen::VectorXd& start,
 
 inline int getHighestDerivativeFromN(int N) { return N / 2 - 1; }
 
+// Removes redundant vertices of a dense polyline, e.g. the output of a graph
+// planner, to shrink the optimization problem. Only vertices that constrain
+// nothing but position are removed, and only if the polyline through the
+// remaining vertices passes within tolerance of them (Ramer-Douglas-Peucker
+// between each pair of consecutive kept vertices). The start, the end and
+// all vertices with any other constraint are always kept.
+// Input: vertices = Vertices of the dense polyline.
+// Input: tolerance = Maximum distance of a removed vertex to the pruned
+// polyline.
+// Output: pruned_vertices = Remaining vertices.
+// Output: original_indices = Optional, index in vertices of each remaining
+// vertex.
+void pruneVertices(const Vertex::Vector& vertices, double tolerance,
+                   Vertex::Vector* pruned_vertices,
+                   std::vector<size_t>* original_indices = nullptr);
+
 // Creates random vertices for position within minimum_position and
 // maximum_position.
 // Vertices at the beginning and end have only fixed constraints with their
@@ -0,0 +1,275 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/bound_constrained_optimizer.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <memory>
+
+namespace mav_trajectory_generation {
+
+BoundConstrainedOptimizer::Objective
+BoundConstrainedOptimizer::withFiniteDifferenceGradient(
+    const Function& function, const Eigen::VectorXd& upper,
+    double relative_step) {
+  return withFiniteDifferenceGradient(function, function, upper,
+                                      relative_step);
+}
+
+BoundConstrainedOptimizer::Objective
+BoundConstrainedOptimizer::withFiniteDifferenceGradient(
+    const Function& function, const Function& probe,
+    const Eigen::VectorXd& upper, double relative_step) {
+  CHECK_GT(relative_step, 0.0);
+  // The perturbed point is kept between calls to avoid allocations.
+  std::shared_ptr<Eigen::VectorXd> perturbed(new Eigen::VectorXd);
+  return [function, probe, upper, relative_step, perturbed](
+      const Eigen::Ref<const Eigen::VectorXd>& x,
+      Eigen::Ref<Eigen::VectorXd> gradient) {
+    const double f = function(x);
+    if (gradient.size() == 0) {
+      return f;
+    }
+    *perturbed = x;
+    for (int i = 0; i < x.size(); ++i) {
+      double step = relative_step * std::max(1.0, std::abs(x[i]));
+      if (x[i] + step > upper[i]) step = -step;
+      (*perturbed)[i] = x[i] + step;
+      gradient[i] = (probe(*perturbed) - f) / step;
+      (*perturbed)[i] = x[i];
+    }
+    return f;
+  };
+}
+
+namespace {
+// Passes nlopt's arguments to an objective without copying them.
+struct NloptObjectiveData {
+  const BoundConstrainedOptimizer::Objective* objective;
+  int* n_evaluations;
+};
+
+double nloptObjective(const std::vector<double>& x, std::vector<double>& grad,
+                      void* data) {
+  NloptObjectiveData* objective_data = static_cast<NloptObjectiveData*>(data);
+  ++(*objective_data->n_evaluations);
+  const Eigen::Map<const Eigen::VectorXd> x_map(x.data(), x.size());
+  Eigen::Map<Eigen::VectorXd> gradient_map(grad.data(), grad.size());
+  return (*objective_data->objective)(x_map, gradient_map);
+}
+}  // namespace
+
+NloptOptimizer::NloptOptimizer(nlopt::opt* opt) : opt_(CHECK_NOTNULL(opt)) {}
+
+bool NloptOptimizer::requiresGradient() const {
+  // nlopt names gradient-free algorithms "... (local, no-derivative)" or
+  // "... (global, no-derivative)".
+  return std::strstr(nlopt::algorithm_name(opt_->get_algorithm()),
+                     "no-derivative") == nullptr;
+}
+
+int NloptOptimizer::minimize(const Objective& objective,
+                             const Eigen::VectorXd& lower,
+                             const Eigen::VectorXd& upper, Eigen::VectorXd* x,
+                             double* f_min) {
+  CHECK_NOTNULL(x);
+  CHECK_NOTNULL(f_min);
+  CHECK_EQ(static_cast<unsigned>(x->size()), opt_->get_dimension());
+  CHECK_EQ(x->size(), lower.size());
+  CHECK_EQ(x->size(), upper.size());
+  n_evaluations_ = 0;
+
+  std::vector<double> x_vector(x->data(), x->data() + x->size());
+  NloptObjectiveData data;
+  data.objective = &objective;
+  data.n_evaluations = &n_evaluations_;
+  int result = nlopt::FAILURE;
+  try {
+    opt_->set_lower_bounds(
+        std::vector<double>(lower.data(), lower.data() + lower.size()));
+    opt_->set_upper_bounds(
+        std::vector<double>(upper.data(), upper.data() + upper.size()));
+    opt_->set_ftol_rel(tolerances_.f_rel);
+    opt_->set_xtol_rel(tolerances_.x_rel);
+    opt_->set_maxeval(tolerances_.max_evaluations);
+    opt_->set_min_objective(&nloptObjective, &data);
+    result = opt_->optimize(x_vector, *f_min);
+  } catch (std::exception& e) {
+    LOG(ERROR) << "error while running nlopt: " << e.what() << std::endl;
+    return nlopt::FAILURE;
+  }
+  *x = Eigen::Map<const Eigen::VectorXd>(x_vector.data(), x_vector.size());
+  return result;
+}
+
+ProjectedLbfgsOptimizer::ProjectedLbfgsOptimizer(size_t memory)
+    : memory_(memory), warm_start_(false), gradient_tolerance_(1.0e-8) {
+  CHECK_GT(memory_, 0u);
+}
+
+void ProjectedLbfgsOptimizer::reset() {
+  s_.clear();
+  y_.clear();
+}
+
+void ProjectedLbfgsOptimizer::computeDirection(
+    const Eigen::VectorXd& gradient,
+    const Eigen::Array<bool, Eigen::Dynamic, 1>& fixed,
+    Eigen::VectorXd* direction) const {
+  CHECK_NOTNULL(direction);
+  // Two-loop recursion on the free variables.
+  Eigen::VectorXd& q = *direction;
+  q = fixed.select(0.0, gradient);
+  std::vector<double> alpha(s_.size());
+  for (int i = static_cast<int>(s_.size()) - 1; i >= 0; --i) {
+    const double rho = 1.0 / y_[i].dot(s_[i]);
+    alpha[i] = rho * s_[i].dot(q);
+    q -= alpha[i] * y_[i];
+  }
+  if (!s_.empty()) {
+    q *= s_.back().dot(y_.back()) / y_.back().squaredNorm();
+  }
+  for (size_t i = 0; i < s_.size(); ++i) {
+    const double rho = 1.0 / y_[i].dot(s_[i]);
+    const double beta = rho * y_[i].dot(q);
+    q += (alpha[i] - beta) * s_[i];
+  }
+  q = fixed.select(0.0, -q);
+}
+
+int ProjectedLbfgsOptimizer::minimize(const Objective& objective,
+                                      const Eigen::VectorXd& lower,
+                                      const Eigen::VectorXd& upper,
+                                      Eigen::VectorXd* x, double* f_min) {
+  CHECK_NOTNULL(x);
+  CHECK_NOTNULL(f_min);
+  const int n = x->size();
+  CHECK_EQ(n, lower.size());
+  CHECK_EQ(n, upper.size());
+  CHECK((lower.array() <= upper.array()).all());
+  if (!warm_start_ || (!s_.empty() && s_.front().size() != n)) {
+    reset();
+  }
+  n_evaluations_ = 0;
+  const int max_evaluations = tolerances_.max_evaluations > 0
+                                  ? tolerances_.max_evaluations
+                                  : std::numeric_limits<int>::max();
+
+  // All buffers are allocated once per minimization.
+  Eigen::VectorXd& x_current = *x;
+  x_current = x_current.cwiseMax(lower).cwiseMin(upper);
+  Eigen::VectorXd gradient(n), x_trial(n), gradient_trial(n), direction(n),
+      step(n), curvature(n);
+  Eigen::Array<bool, Eigen::Dynamic, 1> fixed(n);
+
+  double f = objective(x_current, gradient);
+  ++n_evaluations_;
+
+  while (true) {
+    // Variables at a bound that the gradient pushes outwards stay fixed.
+    fixed = (x_current.array() <= lower.array() && gradient.array() > 0.0) ||
+            (x_current.array() >= upper.array() && gradient.array() < 0.0);
+    const double projected_gradient =
+        fixed.select(0.0, gradient.array()).abs().maxCoeff();
+    if (projected_gradient <= gradient_tolerance_) {
+      *f_min = f;
+      return nlopt::SUCCESS;
+    }
+
+    computeDirection(gradient, fixed, &direction);
+    if (direction.dot(gradient) >= 0.0) {
+      // Not a descent direction, restart from steepest descent.
+      reset();
+      computeDirection(gradient, fixed, &direction);
+    }
+
+    // Without curvature information, limit the first step to a unit change
+    // of the largest variable.
+    double alpha = 1.0;
+    if (s_.empty()) {
+      alpha = std::min(1.0, 1.0 / direction.lpNorm<Eigen::Infinity>());
+    }
+
+    // Backtracking along the projected path.
+    constexpr double kSufficientDecrease = 1.0e-4;
+    constexpr int kMaxLineSearchSteps = 30;
+    bool accepted = false;
+    double f_trial = f;
+    for (int i = 0; i < kMaxLineSearchSteps; ++i) {
+      if (n_evaluations_ >= max_evaluations) {
+        *f_min = f;
+        return nlopt::MAXEVAL_REACHED;
+      }
+      x_trial = (x_current + alpha * direction).cwiseMax(lower).cwiseMin(upper);
+      step = x_trial - x_current;
+      if (step.lpNorm<Eigen::Infinity>() == 0.0) break;
+      f_trial = objective(x_trial, gradient_trial);
+      ++n_evaluations_;
+      if (f_trial <= f + kSufficientDecrease * gradient.dot(step)) {
+        accepted = true;
+        break;
+      }
+      alpha *= 0.5;
+    }
+    if (!accepted) {
+      if (!s_.empty()) {
+        reset();
+        continue;
+      }
+      *f_min = f;
+      return nlopt::XTOL_REACHED;
+    }
+
+    // Only keep pairs with positive curvature, such that H stays positive
+    // definite.
+    curvature = gradient_trial - gradient;
+    if (step.dot(curvature) > std::numeric_limits<double>::epsilon() *
+                                  step.norm() * curvature.norm()) {
+      s_.push_back(step);
+      y_.push_back(curvature);
+      if (s_.size() > memory_) {
+        s_.pop_front();
+        y_.pop_front();
+      }
+    }
+
+    const double f_change = f - f_trial;
+    x_current.swap(x_trial);
+    gradient.swap(gradient_trial);
+    f = f_trial;
+
+    if (tolerances_.f_rel >= 0.0 &&
+        f_change <= tolerances_.f_rel * std::abs(f)) {
+      *f_min = f;
+      return nlopt::FTOL_REACHED;
+    }
+    if (tolerances_.x_rel >= 0.0 &&
+        step.lpNorm<Eigen::Infinity>() <=
+            tolerances_.x_rel * x_current.lpNorm<Eigen::Infinity>()) {
+      *f_min = f;
+      return nlopt::XTOL_REACHED;
+    }
+  }
+}
+
+}  // namespace mav_trajectory_generation
@@ -19,6 +19,7 @@
  */
 
 #include "mav_trajectory_generation/io.h"
+#include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
 #include "mav_trajectory_generation/trajectory_sampling.h"
 
 #include <yaml-cpp/yaml.h>
@@ -29,6 +30,18 @@ const std::string kNumCoefficientsKey = "N";
 const std::string kDimKey = "D";
 const std::string kSegmentTimeKey = "time";
 const std::string kCoefficientsKey = "coefficients";
+const std::string kConstraintsKey = "constraints";
+
+const std::vector<std::string> kTimeAllocMethodNames = {
+    "SquaredTime",
+    "RichterTime",
+    "MellingerOuterLoop",
+    "SquaredTimeAndConstraints",
+    "RichterTimeAndConstraints",
+    "MinimumTime"};
+const std::vector<std::string> kSolverNames = {"Nlopt", "ProjectedLbfgs"};
+const std::vector<std::string> kSoftConstraintMethodNames = {
+    "PeakViolation", "IntegralViolation"};
 
 namespace mav_trajectory_generation {
 
@@ -62,9 +75,7 @@ YAML::Node segmentsToYaml(const Segment::Vector& segments) {
 }
 
 YAML::Node trajectoryToYaml(const Trajectory& trajectory) {
-  Segment::Vector segments;
-  trajectory.getSegments(&segments);
-  return segmentsToYaml(segments);
+  return segmentsToYaml(trajectory.segments());
 }
 
 bool coefficientsFromYaml(const YAML::Node& node,
@@ -259,8 +270,8 @@ bool sampledTrajectoryStatesToFile(const std::string& filename,
   }
 
   // Set the segment times
-  mav_trajectory_generation::Segment::Vector segments;
-  trajectory.getSegments(&segments);
+  const mav_trajectory_generation::Segment::Vector& segments =
+      trajectory.segments();
   double current_segment_time = 0.0;
   for (int j = 0; j < segments.size(); ++j) {
     double segment_time = segments[j].getTime();
@@ -278,4 +289,191 @@ bool sampledTrajectoryStatesToFile(const std::string& filename,
   return true;
 }
 
+YAML::Node verticesToYaml(const Vertex::Vector& vertices) {
+  YAML::Node node(YAML::NodeType::Sequence);
+  for (const Vertex& vertex : vertices) {
+    YAML::Node vertex_node;
+    vertex_node[kDimKey] = vertex.D();
+    vertex_node[kConstraintsKey] = YAML::Node(YAML::NodeType::Map);
+    for (Vertex::Constraints::const_iterator it = vertex.cBegin();
+         it != vertex.cEnd(); ++it) {
+      vertex_node[kConstraintsKey][it->first] =
+          coefficientsToYaml(it->second);
+    }
+    node.push_back(vertex_node);
+  }
+  return node;
+}
+
+bool verticesFromYaml(const YAML::Node& node, Vertex::Vector* vertices) {
+  CHECK_NOTNULL(vertices);
+  if (!node.IsSequence()) return false;
+
+  vertices->clear();
+  vertices->reserve(node.size());
+  for (size_t i = 0; i < node.size(); ++i) {
+    if (!node[i][kDimKey]) return false;
+    if (!node[i][kConstraintsKey]) return false;
+    if (!node[i][kConstraintsKey].IsMap()) return false;
+
+    Vertex vertex(node[i][kDimKey].as<size_t>());
+    for (YAML::const_iterator it = node[i][kConstraintsKey].begin();
+         it != node[i][kConstraintsKey].end(); ++it) {
+      Eigen::VectorXd value;
+      if (!coefficientsFromYaml(it->second, &value)) return false;
+      if (value.size() != vertex.D()) return false;
+      vertex.addConstraint(it->first.as<int>(), value);
+    }
+    vertices->push_back(vertex);
+  }
+
+  return true;
+}
+
+YAML::Node nonlinearOptimizationParametersToYaml(
+    const NonlinearOptimizationParameters& parameters) {
+  YAML::Node node;
+  node["f_abs"] = parameters.f_abs;
+  node["f_rel"] = parameters.f_rel;
+  node["x_rel"] = parameters.x_rel;
+  node["x_abs"] = parameters.x_abs;
+  node["initial_stepsize_rel"] = parameters.initial_stepsize_rel;
+  node["equality_constraint_tolerance"] =
+      parameters.equality_constraint_tolerance;
+  node["inequality_constraint_tolerance"] =
+      parameters.inequality_constraint_tolerance;
+  node["max_iterations"] = parameters.max_iterations;
+  node["time_penalty"] = parameters.time_penalty;
+  node["algorithm"] = static_cast<int>(parameters.algorithm);
+  node["random_seed"] = parameters.random_seed;
+  node["use_soft_constraints"] = parameters.use_soft_constraints;
+  node["soft_constraint_weight"] = parameters.soft_constraint_weight;
+  node["soft_constraint_method"] =
+      kSoftConstraintMethodNames[parameters.soft_constraint_method];
+  node["soft_constraint_integral_weight"] =
+      parameters.soft_constraint_integral_weight;
+  node["minimum_time_tolerance_rel"] = parameters.minimum_time_tolerance_rel;
+  node["solver"] = kSolverNames[parameters.solver];
+  node["warm_start"] = parameters.warm_start;
+  if (parameters.time_alloc_method < kTimeAllocMethodNames.size()) {
+    node["time_alloc_method"] =
+        kTimeAllocMethodNames[parameters.time_alloc_method];
+  }
+  node["print_debug_info"] = parameters.print_debug_info;
+  node["print_debug_info_time_allocation"] =
+      parameters.print_debug_info_time_allocation;
+  node["trace_capacity"] = parameters.trace_capacity;
+  return node;
+}
+
+namespace {
+template <typename T>
+void readIfPresent(const YAML::Node& node, const std::string& key, T* value) {
+  if (node[key]) {
+    *value = node[key].as<T>();
+  }
+}
+
+// Returns the index of the name in names, or -1 if it is unknown.
+int indexOfName(const std::vector<std::string>& names,
+                const std::string& name) {
+  for (size_t i = 0; i < names.size(); ++i) {
+    if (names[i] == name) return i;
+  }
+  return -1;
+}
+}  // namespace
+
+bool nonlinearOptimizationParametersFromYaml(
+    const YAML::Node& node, NonlinearOptimizationParameters* parameters) {
+  CHECK_NOTNULL(parameters);
+  if (!node.IsMap()) return false;
+
+  readIfPresent(node, "f_abs", &parameters->f_abs);
+  readIfPresent(node, "f_rel", &parameters->f_rel);
+  readIfPresent(node, "x_rel", &parameters->x_rel);
+  readIfPresent(node, "x_abs", &parameters->x_abs);
+  readIfPresent(node, "initial_stepsize_rel",
+                &parameters->initial_stepsize_rel);
+  readIfPresent(node, "equality_constraint_tolerance",
+                &parameters->equality_constraint_tolerance);
+  readIfPresent(node, "inequality_constraint_tolerance",
+                &parameters->inequality_constraint_tolerance);
+  readIfPresent(node, "max_iterations", &parameters->max_iterations);
+  readIfPresent(node, "time_penalty", &parameters->time_penalty);
+  if (node["algorithm"]) {
+    parameters->algorithm =
+        static_cast<nlopt::algorithm>(node["algorithm"].as<int>());
+  }
+  readIfPresent(node, "random_seed", &parameters->random_seed);
+  readIfPresent(node, "use_soft_constraints",
+                &parameters->use_soft_constraints);
+  readIfPresent(node, "soft_constraint_weight",
+                &parameters->soft_constraint_weight);
+  if (node["soft_constraint_method"]) {
+    const int method =
+        indexOfName(kSoftConstraintMethodNames,
+                    node["soft_constraint_method"].as<std::string>());
+    if (method < 0) return false;
+    parameters->soft_constraint_method =
+        static_cast<NonlinearOptimizationParameters::SoftConstraintMethod>(
+            method);
+  }
+  readIfPresent(node, "soft_constraint_integral_weight",
+                &parameters->soft_constraint_integral_weight);
+  readIfPresent(node, "minimum_time_tolerance_rel",
+                &parameters->minimum_time_tolerance_rel);
+  if (node["solver"]) {
+    const int solver =
+        indexOfName(kSolverNames, node["solver"].as<std::string>());
+    if (solver < 0) return false;
+    parameters->solver =
+        static_cast<NonlinearOptimizationParameters::Solver>(solver);
+  }
+  readIfPresent(node, "warm_start", &parameters->warm_start);
+  if (node["time_alloc_method"]) {
+    const int method = indexOfName(
+        kTimeAllocMethodNames, node["time_alloc_method"].as<std::string>());
+    if (method < 0) return false;
+    parameters->time_alloc_method =
+        static_cast<NonlinearOptimizationParameters::TimeAllocMethod>(method);
+  }
+  readIfPresent(node, "print_debug_info", &parameters->print_debug_info);
+  readIfPresent(node, "print_debug_info_time_allocation",
+                &parameters->print_debug_info_time_allocation);
+  readIfPresent(node, "trace_capacity", &parameters->trace_capacity);
+
+  return true;
+}
+
+bool nonlinearOptimizationParametersToFile(
+    const std::string& filename,
+    const NonlinearOptimizationParameters& parameters) {
+  YAML::Emitter out;
+  out << nonlinearOptimizationParametersToYaml(parameters);
+
+  std::ofstream fout(filename);
+  if (!fout) {
+    return false;
+  }
+  fout << out.c_str() << std::endl;
+  fout.close();
+
+  return true;
+}
+
+bool nonlinearOptimizationParametersFromFile(
+    const std::string& filename, NonlinearOptimizationParameters* parameters) {
+  CHECK_NOTNULL(parameters);
+
+  // Check file exists and is readable.
+  std::ifstream in(filename);
+  if (!in.good()) {
+    return false;
+  }
+
+  return nonlinearOptimizationParametersFromYaml(YAML::LoadFile(filename),
+                                                 parameters);
+}
+
 }  // namespace mav_trajectory_generation
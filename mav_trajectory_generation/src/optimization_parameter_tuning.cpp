@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+// Tunes the parameters of the nonlinear optimization on a corpus of recorded
+// problems, see parameter_tuning.h.
+// Usage: optimization_parameter_tuning [--parameters=base.yaml]
+//     [--samples=50] [--threads=0] [--seed=0] output_prefix problem.yaml...
+// Writes the Pareto-optimal parameter sets to output_prefix_<i>.yaml, by
+// increasing runtime, and the one with the lowest cost among those that are
+// feasible on the most problems to output_prefix.yaml.
+
+#include <iostream>
+#include <string>
+
+#include <mav_trajectory_generation/io.h>
+#include <mav_trajectory_generation/parameter_tuning.h>
+
+const int N = 10;
+
+namespace {
+// Returns whether argument starts with the flag and sets value to the rest.
+bool parseFlag(const std::string& argument, const std::string& flag,
+               std::string* value) {
+  if (argument.compare(0, flag.size(), flag) != 0) return false;
+  *value = argument.substr(flag.size());
+  return true;
+}
+}  // namespace
+
+int main(int argc, char** argv) {
+  google::InitGoogleLogging(argv[0]);
+  FLAGS_alsologtostderr = true;
+
+  mav_trajectory_generation::NonlinearOptimizationParameters base;
+  mav_trajectory_generation::TuningParameters tuning_parameters;
+  std::string output_prefix;
+  std::vector<std::string> problem_files;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string argument(argv[i]);
+    std::string value;
+    if (parseFlag(argument, "--parameters=", &value)) {
+      if (!mav_trajectory_generation::nonlinearOptimizationParametersFromFile(
+              value, &base)) {
+        LOG(ERROR) << "Could not read parameters from " << value;
+        return 1;
+      }
+    } else if (parseFlag(argument, "--samples=", &value)) {
+      tuning_parameters.n_samples = std::stoul(value);
+    } else if (parseFlag(argument, "--threads=", &value)) {
+      tuning_parameters.n_threads = std::stoul(value);
+    } else if (parseFlag(argument, "--seed=", &value)) {
+      tuning_parameters.random_seed = std::stoi(value);
+    } else if (output_prefix.empty()) {
+      output_prefix = argument;
+    } else {
+      problem_files.push_back(argument);
+    }
+  }
+  if (problem_files.empty()) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--parameters=base.yaml] [--samples=50] [--threads=0]"
+                 " [--seed=0] output_prefix problem.yaml..."
+              << std::endl;
+    return 1;
+  }
+
+  mav_trajectory_generation::ParameterTuning<N> tuning(base,
+                                                       tuning_parameters);
+  for (const std::string& filename : problem_files) {
+    mav_trajectory_generation::TuningProblem problem;
+    if (!mav_trajectory_generation::tuningProblemFromFile(filename,
+                                                          &problem)) {
+      LOG(ERROR) << "Could not read problem from " << filename;
+      return 1;
+    }
+    tuning.addProblem(problem);
+  }
+
+  if (!tuning.run()) {
+    LOG(ERROR) << "Evaluation of the parameters failed.";
+    return 1;
+  }
+
+  const std::vector<mav_trajectory_generation::TuningResult>& results =
+      tuning.getResults();
+  std::vector<size_t> front;
+  tuning.getParetoFront(&front);
+
+  std::cout << "Base parameters:" << std::endl
+            << results.front() << std::endl
+            << "Pareto front:" << std::endl;
+  size_t best = front.front();
+  for (size_t i = 0; i < front.size(); ++i) {
+    const mav_trajectory_generation::TuningResult& result = results[front[i]];
+    std::cout << "[" << i << "] " << result << std::endl;
+    mav_trajectory_generation::nonlinearOptimizationParametersToFile(
+        output_prefix + "_" + std::to_string(i) + ".yaml", result.parameters);
+
+    if (result.n_feasible > results[best].n_feasible ||
+        (result.n_feasible == results[best].n_feasible &&
+         result.cost < results[best].cost)) {
+      best = front[i];
+    }
+  }
+
+  if (!mav_trajectory_generation::nonlinearOptimizationParametersToFile(
+          output_prefix + ".yaml", results[best].parameters)) {
+    LOG(ERROR) << "Could not write " << output_prefix << ".yaml";
+    return 1;
+  }
+  std::cout << "Selected:" << std::endl << results[best] << std::endl;
+
+  return 0;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/optimization_trace.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <limits>
+
+namespace mav_trajectory_generation {
+
+namespace {
+// JSON has no representation for infinity and NaN.
+void writeJsonNumber(double value, std::ostream& stream) {
+  if (std::isfinite(value)) {
+    stream << value;
+  } else {
+    stream << "null";
+  }
+}
+}  // namespace
+
+OptimizationTrace::OptimizationTrace(size_t capacity)
+    : entries_(capacity), begin_(0), size_(0), n_dropped_(0) {}
+
+void OptimizationTrace::setCapacity(size_t capacity) {
+  entries_.resize(capacity);
+  clear();
+}
+
+void OptimizationTrace::clear() {
+  begin_ = 0;
+  size_ = 0;
+  n_dropped_ = 0;
+}
+
+OptimizationTraceEntry& OptimizationTrace::addEntry() {
+  CHECK(!entries_.empty()) << "Trace capacity is 0.";
+  if (size_ < entries_.size()) {
+    return entries_[(begin_ + size_++) % entries_.size()];
+  }
+  OptimizationTraceEntry& entry = entries_[begin_];
+  begin_ = (begin_ + 1) % entries_.size();
+  ++n_dropped_;
+  return entry;
+}
+
+const OptimizationTraceEntry& OptimizationTrace::operator[](size_t i) const {
+  CHECK_LT(i, size_);
+  return entries_[(begin_ + i) % entries_.size()];
+}
+
+void OptimizationTrace::writeCsv(std::ostream& stream) const {
+  size_t n_segments = 0;
+  for (size_t i = 0; i < size_; ++i) {
+    n_segments = std::max(n_segments, (*this)[i].segment_times.size());
+  }
+
+  const std::streamsize precision = stream.precision();
+  stream.precision(std::numeric_limits<double>::max_digits10);
+  stream << "iteration,elapsed_time,cost_trajectory,cost_time,"
+            "cost_soft_constraints";
+  for (size_t k = 0; k < n_segments; ++k) {
+    stream << ",t_" << k;
+  }
+  stream << std::endl;
+  for (size_t i = 0; i < size_; ++i) {
+    const OptimizationTraceEntry& entry = (*this)[i];
+    stream << entry.iteration << "," << entry.elapsed_time << ","
+           << entry.cost_trajectory << "," << entry.cost_time << ","
+           << entry.cost_soft_constraints;
+    for (size_t k = 0; k < n_segments; ++k) {
+      stream << ",";
+      if (k < entry.segment_times.size()) stream << entry.segment_times[k];
+    }
+    stream << std::endl;
+  }
+  stream.precision(precision);
+}
+
+void OptimizationTrace::writeJson(std::ostream& stream) const {
+  const std::streamsize precision = stream.precision();
+  stream.precision(std::numeric_limits<double>::max_digits10);
+  stream << "[";
+  for (size_t i = 0; i < size_; ++i) {
+    const OptimizationTraceEntry& entry = (*this)[i];
+    stream << (i == 0 ? "\n" : ",\n");
+    stream << "  {\"iteration\": " << entry.iteration << ", \"elapsed_time\": ";
+    writeJsonNumber(entry.elapsed_time, stream);
+    stream << ", \"cost_trajectory\": ";
+    writeJsonNumber(entry.cost_trajectory, stream);
+    stream << ", \"cost_time\": ";
+    writeJsonNumber(entry.cost_time, stream);
+    stream << ", \"cost_soft_constraints\": ";
+    writeJsonNumber(entry.cost_soft_constraints, stream);
+    stream << ", \"segment_times\": [";
+    for (size_t k = 0; k < entry.segment_times.size(); ++k) {
+      if (k > 0) stream << ", ";
+      writeJsonNumber(entry.segment_times[k], stream);
+    }
+    stream << "]}";
+  }
+  stream << "\n]" << std::endl;
+  stream.precision(precision);
+}
+
+bool OptimizationTrace::saveCsv(const std::string& filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    return false;
+  }
+  writeCsv(file);
+  return true;
+}
+
+bool OptimizationTrace::saveJson(const std::string& filename) const {
+  std::ofstream file(filename);
+  if (!file) {
+    return false;
+  }
+  writeJson(file);
+  return true;
+}
+
+}  // namespace mav_trajectory_generation
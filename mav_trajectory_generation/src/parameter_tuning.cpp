@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/parameter_tuning.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+#include "mav_trajectory_generation/io.h"
+
+namespace mav_trajectory_generation {
+
+namespace {
+const std::string kVerticesKey = "vertices";
+const std::string kSegmentTimesKey = "segment_times";
+const std::string kLimitsKey = "limits";
+const std::string kDerivativeToOptimizeKey = "derivative_to_optimize";
+
+double sampleLogUniform(double min, double max, std::mt19937* generator) {
+  CHECK_GT(min, 0.0);
+  CHECK_GE(max, min);
+  std::uniform_real_distribution<double> distribution(std::log(min),
+                                                      std::log(max));
+  return std::exp(distribution(*generator));
+}
+
+template <typename T>
+const T& sampleFrom(const std::vector<T>& values, std::mt19937* generator) {
+  CHECK(!values.empty());
+  std::uniform_int_distribution<size_t> distribution(0, values.size() - 1);
+  return values[distribution(*generator)];
+}
+
+// Whether a is at least as good as b in all objectives and better in one.
+bool dominates(const TuningResult& a, const TuningResult& b) {
+  const bool no_worse = a.runtime <= b.runtime && a.cost <= b.cost &&
+                        a.violation <= b.violation;
+  const bool better = a.runtime < b.runtime || a.cost < b.cost ||
+                      a.violation < b.violation;
+  return no_worse && better;
+}
+}  // namespace
+
+YAML::Node tuningProblemToYaml(const TuningProblem& problem) {
+  YAML::Node node;
+  node[kVerticesKey] = verticesToYaml(problem.vertices);
+  if (!problem.segment_times.empty()) {
+    node[kSegmentTimesKey] = problem.segment_times;
+    node[kSegmentTimesKey].SetStyle(YAML::EmitterStyle::Flow);
+  }
+  for (const std::pair<const int, double>& limit : problem.limits) {
+    node[kLimitsKey][limit.first] = limit.second;
+  }
+  node[kDerivativeToOptimizeKey] = problem.derivative_to_optimize;
+  return node;
+}
+
+bool tuningProblemFromYaml(const YAML::Node& node, TuningProblem* problem) {
+  CHECK_NOTNULL(problem);
+  if (!node[kVerticesKey]) return false;
+
+  *problem = TuningProblem();
+  if (!verticesFromYaml(node[kVerticesKey], &problem->vertices)) return false;
+  if (problem->vertices.size() < 2) return false;
+
+  if (node[kSegmentTimesKey]) {
+    problem->segment_times = node[kSegmentTimesKey].as<std::vector<double> >();
+    if (problem->segment_times.size() != problem->vertices.size() - 1) {
+      return false;
+    }
+  }
+  if (node[kLimitsKey]) {
+    if (!node[kLimitsKey].IsMap()) return false;
+    for (YAML::const_iterator it = node[kLimitsKey].begin();
+         it != node[kLimitsKey].end(); ++it) {
+      problem->limits[it->first.as<int>()] = it->second.as<double>();
+    }
+  }
+  if (node[kDerivativeToOptimizeKey]) {
+    problem->derivative_to_optimize = node[kDerivativeToOptimizeKey].as<int>();
+  }
+
+  return true;
+}
+
+bool tuningProblemToFile(const std::string& filename,
+                         const TuningProblem& problem) {
+  YAML::Emitter out;
+  out << tuningProblemToYaml(problem);
+
+  std::ofstream fout(filename);
+  if (!fout) {
+    return false;
+  }
+  fout << out.c_str() << std::endl;
+  fout.close();
+
+  return true;
+}
+
+bool tuningProblemFromFile(const std::string& filename,
+                           TuningProblem* problem) {
+  CHECK_NOTNULL(problem);
+
+  // Check file exists and is readable.
+  std::ifstream in(filename);
+  if (!in.good()) {
+    return false;
+  }
+
+  return tuningProblemFromYaml(YAML::LoadFile(filename), problem);
+}
+
+std::ostream& operator<<(std::ostream& stream, const TuningResult& val) {
+  stream << "runtime: " << val.runtime << " cost: " << val.cost
+         << " violation: " << val.violation << " feasible: " << val.n_feasible
+         << " | algorithm: " << val.parameters.algorithm
+         << " time_alloc_method: " << val.parameters.time_alloc_method
+         << " f_rel: " << val.parameters.f_rel
+         << " initial_stepsize_rel: " << val.parameters.initial_stepsize_rel
+         << " time_penalty: " << val.parameters.time_penalty
+         << " soft_constraint_weight: "
+         << val.parameters.soft_constraint_weight;
+  return stream;
+}
+
+NonlinearOptimizationParameters sampleParameters(
+    const NonlinearOptimizationParameters& base,
+    const TuningParameters& tuning_parameters, std::mt19937* generator) {
+  CHECK_NOTNULL(generator);
+  NonlinearOptimizationParameters parameters = base;
+  parameters.algorithm = sampleFrom(tuning_parameters.algorithms, generator);
+  parameters.time_alloc_method =
+      sampleFrom(tuning_parameters.time_alloc_methods, generator);
+  parameters.f_rel = sampleLogUniform(tuning_parameters.f_rel_min,
+                                      tuning_parameters.f_rel_max, generator);
+  parameters.initial_stepsize_rel =
+      sampleLogUniform(tuning_parameters.initial_stepsize_rel_min,
+                       tuning_parameters.initial_stepsize_rel_max, generator);
+  parameters.time_penalty =
+      sampleLogUniform(tuning_parameters.time_penalty_min,
+                       tuning_parameters.time_penalty_max, generator);
+  parameters.soft_constraint_weight =
+      sampleLogUniform(tuning_parameters.soft_constraint_weight_min,
+                       tuning_parameters.soft_constraint_weight_max, generator);
+  return parameters;
+}
+
+void computeParetoFront(const std::vector<TuningResult>& results,
+                        std::vector<size_t>* front) {
+  CHECK_NOTNULL(front);
+  front->clear();
+  for (size_t i = 0; i < results.size(); ++i) {
+    bool dominated = false;
+    for (size_t j = 0; j < results.size() && !dominated; ++j) {
+      dominated = dominates(results[j], results[i]);
+    }
+    if (!dominated) {
+      front->push_back(i);
+    }
+  }
+  std::sort(front->begin(), front->end(), [&results](size_t a, size_t b) {
+    return results[a].runtime < results[b].runtime;
+  });
+}
+
+}  // namespace mav_trajectory_generation
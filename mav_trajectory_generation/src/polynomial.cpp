@@ -204,6 +204,23 @@ void Polynomial::scalePolynomialInTime(double scaling_factor) {
   }
 }
 
+void Polynomial::shiftPolynomialInTime(double t_shift) {
+  shiftCoefficientsInTime(
+      t_shift, Eigen::Map<CoefficientMatrix>(coefficients_.data(), N_, 1));
+}
+
+void Polynomial::shiftCoefficientsInTime(
+    double t_shift, Eigen::Ref<CoefficientMatrix> coefficients) {
+  // Taylor shift by repeated synthetic division (Horner's scheme). After the
+  // k-th pass, coefficient k is final.
+  const int N = coefficients.rows();
+  for (int k = 0; k < N - 1; ++k) {
+    for (int i = N - 2; i >= k; --i) {
+      coefficients.row(i) += t_shift * coefficients.row(i + 1);
+    }
+  }
+}
+
 void Polynomial::offsetPolynomial(const double offset) {
   if (coefficients_.size() == 0) return;
 
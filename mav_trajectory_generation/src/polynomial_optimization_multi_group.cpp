@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/polynomial_optimization_multi_group.h"
+
+#include <algorithm>
+
+#include "mav_trajectory_generation/thread_pool.h"
+
+namespace mav_trajectory_generation {
+
+size_t PolynomialOptimizationMultiGroup::addGroup(
+    std::unique_ptr<PolynomialOptimizationGroupBase> group) {
+  CHECK(group);
+  if (!groups_.empty()) {
+    CHECK_EQ(group->getNumberOfVertices(), groups_.front()->getNumberOfVertices())
+        << "All groups need the same number of vertices.";
+  }
+  groups_.push_back(std::move(group));
+  return groups_.size() - 1;
+}
+
+PolynomialOptimizationGroupBase& PolynomialOptimizationMultiGroup::getGroup(
+    size_t group_idx) {
+  CHECK_LT(group_idx, groups_.size());
+  return *groups_[group_idx];
+}
+
+const PolynomialOptimizationGroupBase&
+PolynomialOptimizationMultiGroup::getGroup(size_t group_idx) const {
+  CHECK_LT(group_idx, groups_.size());
+  return *groups_[group_idx];
+}
+
+size_t PolynomialOptimizationMultiGroup::getDimension() const {
+  size_t dimension = 0;
+  for (const std::unique_ptr<PolynomialOptimizationGroupBase>& group :
+       groups_) {
+    dimension += group->getDimension();
+  }
+  return dimension;
+}
+
+bool PolynomialOptimizationMultiGroup::setup(
+    const std::vector<double>& segment_times) {
+  for (const std::unique_ptr<PolynomialOptimizationGroupBase>& group :
+       groups_) {
+    if (group->getNumberOfVertices() != segment_times.size() + 1) {
+      LOG(WARNING) << "Number of segment times (" << segment_times.size()
+                   << ") does not match the number of vertices ("
+                   << group->getNumberOfVertices() << ").";
+      return false;
+    }
+  }
+  std::vector<char> success(groups_.size(), false);
+  getSharedThreadPool().parallelFor(groups_.size(), [&](size_t group_idx) {
+    success[group_idx] = groups_[group_idx]->setup(segment_times);
+  });
+  return std::find(success.begin(), success.end(), false) == success.end();
+}
+
+void PolynomialOptimizationMultiGroup::updateSegmentTimes(
+    const std::vector<double>& segment_times) {
+  for (const std::unique_ptr<PolynomialOptimizationGroupBase>& group :
+       groups_) {
+    group->updateSegmentTimes(segment_times);
+  }
+}
+
+bool PolynomialOptimizationMultiGroup::solveLinear() {
+  std::vector<char> success(groups_.size(), false);
+  getSharedThreadPool().parallelFor(groups_.size(), [&](size_t group_idx) {
+    success[group_idx] = groups_[group_idx]->solveLinear();
+  });
+  return std::find(success.begin(), success.end(), false) == success.end();
+}
+
+double PolynomialOptimizationMultiGroup::computeCost() const {
+  double cost = 0.0;
+  for (const std::unique_ptr<PolynomialOptimizationGroupBase>& group :
+       groups_) {
+    cost += group->computeCost();
+  }
+  return cost;
+}
+
+bool PolynomialOptimizationMultiGroup::getTrajectory(
+    Trajectory* trajectory) const {
+  CHECK_NOTNULL(trajectory);
+  trajectory->clear();
+  Trajectory group_trajectory, merged;
+  for (const std::unique_ptr<PolynomialOptimizationGroupBase>& group :
+       groups_) {
+    group->getTrajectory(&group_trajectory);
+    if (!trajectory->getTrajectoryWithAppendedDimension(group_trajectory,
+                                                        &merged)) {
+      return false;
+    }
+    *trajectory = merged;
+  }
+  return true;
+}
+
+}  // namespace mav_trajectory_generation
@@ -0,0 +1,381 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/qp_solver.h"
+
+#include <glog/logging.h>
+#include <algorithm>
+#include <cmath>
+
+namespace mav_trajectory_generation {
+
+namespace {
+double infinityNorm(const Eigen::VectorXd& v) {
+  return v.size() == 0 ? 0.0 : v.lpNorm<Eigen::Infinity>();
+}
+}  // namespace
+
+AdmmQpSolver::AdmmQpSolver(const AdmmQpParameters& parameters)
+    : parameters_(parameters) {
+  CHECK_GT(parameters_.rho, 0.0);
+  CHECK_GT(parameters_.sigma, 0.0);
+  CHECK(parameters_.alpha > 0.0 && parameters_.alpha < 2.0);
+}
+
+bool AdmmQpSolver::factorize(const Eigen::SparseMatrix<double>& P,
+                             const Eigen::SparseMatrix<double>& G, double rho,
+                             bool analyze_pattern) {
+  Eigen::SparseMatrix<double> identity(P.rows(), P.cols());
+  identity.setIdentity();
+  const Eigen::SparseMatrix<double> K =
+      P + parameters_.sigma * identity +
+      rho * Eigen::SparseMatrix<double>(G.transpose() * G);
+  if (analyze_pattern) {
+    solver_.analyzePattern(K);
+  }
+  solver_.factorize(K);
+  return solver_.info() == Eigen::Success;
+}
+
+bool AdmmQpSolver::solve(const Eigen::SparseMatrix<double>& P,
+                         const Eigen::VectorXd& q,
+                         const Eigen::SparseMatrix<double>& G,
+                         const Eigen::VectorXd& lower,
+                         const Eigen::VectorXd& upper, State* state,
+                         Info* info) {
+  CHECK_NOTNULL(state);
+  const int n = P.cols();
+  const int m = G.rows();
+  CHECK_EQ(P.rows(), n);
+  CHECK_EQ(q.size(), n);
+  CHECK_EQ(G.cols(), n);
+  CHECK_EQ(lower.size(), m);
+  CHECK_EQ(upper.size(), m);
+
+  // Ruiz equilibration of [P G^T; G 0] and scaling of the cost, see [1],
+  // section 5.1. The derivative costs of a trajectory are often many orders
+  // of magnitude away from one, which stalls the unscaled iteration.
+  // Scaled problem: P_s = c * D P D, q_s = c * D q, G_s = E G D.
+  Eigen::VectorXd D = Eigen::VectorXd::Ones(n);
+  Eigen::VectorXd E = Eigen::VectorXd::Ones(m);
+  Eigen::SparseMatrix<double> P_scaled = P;
+  Eigen::SparseMatrix<double> G_scaled = G;
+  Eigen::VectorXd column_norms(n), row_norms(m);
+  for (int iteration = 0; iteration < parameters_.n_scaling_iterations;
+       ++iteration) {
+    column_norms.setZero();
+    row_norms.setZero();
+    for (int k = 0; k < P_scaled.outerSize(); ++k) {
+      for (Eigen::SparseMatrix<double>::InnerIterator it(P_scaled, k); it;
+           ++it) {
+        column_norms[it.col()] =
+            std::max(column_norms[it.col()], std::abs(it.value()));
+      }
+    }
+    for (int k = 0; k < G_scaled.outerSize(); ++k) {
+      for (Eigen::SparseMatrix<double>::InnerIterator it(G_scaled, k); it;
+           ++it) {
+        column_norms[it.col()] =
+            std::max(column_norms[it.col()], std::abs(it.value()));
+        row_norms[it.row()] =
+            std::max(row_norms[it.row()], std::abs(it.value()));
+      }
+    }
+    const Eigen::VectorXd delta_D =
+        (column_norms.array() > 1.0e-12)
+            .select(column_norms.cwiseSqrt().cwiseInverse(), 1.0);
+    const Eigen::VectorXd delta_E =
+        (row_norms.array() > 1.0e-12)
+            .select(row_norms.cwiseSqrt().cwiseInverse(), 1.0);
+    P_scaled = delta_D.asDiagonal() * P_scaled * delta_D.asDiagonal();
+    G_scaled = delta_E.asDiagonal() * G_scaled * delta_D.asDiagonal();
+    D = D.cwiseProduct(delta_D);
+    E = E.cwiseProduct(delta_E);
+  }
+  Eigen::VectorXd q_scaled = D.cwiseProduct(q);
+  double mean_column_norm = 0.0;
+  for (int k = 0; k < P_scaled.outerSize(); ++k) {
+    double column_norm = 0.0;
+    for (Eigen::SparseMatrix<double>::InnerIterator it(P_scaled, k); it;
+         ++it) {
+      column_norm = std::max(column_norm, std::abs(it.value()));
+    }
+    mean_column_norm += column_norm / n;
+  }
+  const double cost_scaling =
+      1.0 / std::max(1.0e-12, std::max(mean_column_norm,
+                                       infinityNorm(q_scaled)));
+  P_scaled *= cost_scaling;
+  q_scaled *= cost_scaling;
+  const Eigen::VectorXd lower_scaled = E.cwiseProduct(lower);
+  const Eigen::VectorXd upper_scaled = E.cwiseProduct(upper);
+
+  // Iterates of the scaled problem.
+  Eigen::VectorXd x, z, y;
+  const bool warm_start = parameters_.warm_start && state->x.size() == n &&
+                          state->z.size() == m && state->y.size() == m;
+  if (warm_start) {
+    x = state->x.cwiseQuotient(D);
+    z = state->z.cwiseProduct(E);
+    y = cost_scaling * state->y.cwiseQuotient(E);
+  } else {
+    x = Eigen::VectorXd::Zero(n);
+    z = Eigen::VectorXd::Zero(m);
+    y = Eigen::VectorXd::Zero(m);
+  }
+
+  Info local_info;
+  // The tolerance of the polished solution on G x in the scaled problem.
+  const Eigen::VectorXd polish_tolerance = parameters_.eps_abs * E;
+  auto finish = [&](bool converged) {
+    state->x = D.cwiseProduct(x);
+    state->z = z.cwiseQuotient(E);
+    state->y = E.cwiseProduct(y) / cost_scaling;
+    local_info.converged = converged;
+    if (info != nullptr) {
+      *info = local_info;
+    }
+    return converged;
+  };
+
+  // Constraints with a positive multiplier are at their upper bound, with a
+  // negative multiplier at their lower bound. Trying the active set of the
+  // warm start first solves sequences of similar problems without
+  // iterations. Without warm start, the active set is empty and the check
+  // finds problems whose bounds are inactive.
+  std::vector<int> active(m);
+  for (int i = 0; i < m; ++i) {
+    active[i] = y[i] > 0.0 ? 1 : (y[i] < 0.0 ? -1 : 0);
+  }
+  if (parameters_.polish && polish(P_scaled, q_scaled, G_scaled, lower_scaled,
+                                   upper_scaled, active, polish_tolerance,
+                                   &x, &y)) {
+    z = (G_scaled * x).cwiseMax(lower_scaled).cwiseMin(upper_scaled);
+    local_info.polished = true;
+    return finish(true);
+  }
+
+  // Refines the solution on the active set guessed from the ADMM iterates,
+  // see [1], section 4.1. The iterates only meet the bounds within the
+  // tolerances, the polished solution meets them exactly. As the polished
+  // solution is optimal if it passes the checks, trying it periodically also
+  // ends the iteration once ADMM has found the active set, which is usually
+  // long before the residuals converge.
+  auto polish_active_set = [&]() {
+    for (int i = 0; i < m; ++i) {
+      active[i] = z[i] - lower_scaled[i] < -y[i]
+                      ? -1
+                      : (upper_scaled[i] - z[i] < y[i] ? 1 : 0);
+    }
+    Eigen::VectorXd x_polished = x;
+    Eigen::VectorXd y_polished = y;
+    if (!polish(P_scaled, q_scaled, G_scaled, lower_scaled, upper_scaled,
+                active, polish_tolerance, &x_polished, &y_polished)) {
+      return false;
+    }
+    x = x_polished;
+    y = y_polished;
+    z = (G_scaled * x).cwiseMax(lower_scaled).cwiseMin(upper_scaled);
+    local_info.polished = true;
+    return true;
+  };
+
+  double rho = parameters_.rho;
+  if (!factorize(P_scaled, G_scaled, rho, true)) {
+    LOG(WARNING) << "Could not factorize the KKT system of the QP.";
+    return false;
+  }
+
+  Eigen::VectorXd Gx(m), z_relaxed(m), Px(n), Gty(n);
+  bool converged = false;
+  int iteration = 0;
+  for (; iteration < parameters_.max_iterations; ++iteration) {
+    const Eigen::VectorXd rhs = parameters_.sigma * x - q_scaled +
+                                G_scaled.transpose() * (rho * z - y);
+    x = solver_.solve(rhs);
+    Gx = G_scaled * x;
+    z_relaxed = parameters_.alpha * Gx + (1.0 - parameters_.alpha) * z;
+    z = (z_relaxed + y / rho).cwiseMax(lower_scaled).cwiseMin(upper_scaled);
+    y += rho * (z_relaxed - z);
+
+    // Residuals and their scales in the original problem.
+    Px = P_scaled * x;
+    Gty = G_scaled.transpose() * y;
+    const double primal_residual = infinityNorm((Gx - z).cwiseQuotient(E));
+    const double dual_residual =
+        infinityNorm((Px + q_scaled + Gty).cwiseQuotient(D)) / cost_scaling;
+    const double primal_scale = std::max(infinityNorm(Gx.cwiseQuotient(E)),
+                                         infinityNorm(z.cwiseQuotient(E)));
+    const double dual_scale =
+        std::max(infinityNorm(Px.cwiseQuotient(D)),
+                 std::max(infinityNorm(Gty.cwiseQuotient(D)),
+                          infinityNorm(q_scaled.cwiseQuotient(D)))) /
+        cost_scaling;
+    local_info.primal_residual = primal_residual;
+    local_info.dual_residual = dual_residual;
+    if (primal_residual <=
+            parameters_.eps_abs + parameters_.eps_rel * primal_scale &&
+        dual_residual <=
+            parameters_.eps_abs + parameters_.eps_rel * dual_scale) {
+      converged = true;
+      ++iteration;
+      break;
+    }
+
+    if (parameters_.rho_update_interval > 0 &&
+        (iteration + 1) % parameters_.rho_update_interval == 0) {
+      if (parameters_.polish && polish_active_set()) {
+        converged = true;
+        ++iteration;
+        break;
+      }
+
+      // Balances the relative residuals of the scaled problem, see [1],
+      // section 5.2.
+      const double relative_primal =
+          infinityNorm(Gx - z) /
+          std::max(1.0e-12, std::max(infinityNorm(Gx), infinityNorm(z)));
+      const double relative_dual =
+          infinityNorm(Px + q_scaled + Gty) /
+          std::max(1.0e-12,
+                   std::max(infinityNorm(Px),
+                            std::max(infinityNorm(Gty),
+                                     infinityNorm(q_scaled))));
+      const double rho_new = std::min(
+          1.0e6,
+          std::max(1.0e-6,
+                   rho * std::sqrt(relative_primal /
+                                   std::max(relative_dual, 1.0e-12))));
+      if (rho_new > 5.0 * rho || rho_new < 0.2 * rho) {
+        rho = rho_new;
+        if (!factorize(P_scaled, G_scaled, rho, false)) {
+          LOG(WARNING) << "Could not factorize the KKT system of the QP.";
+          return false;
+        }
+      }
+    }
+  }
+  local_info.n_iterations = iteration;
+  local_info.rho = rho;
+
+  if (converged && !local_info.polished && parameters_.polish) {
+    polish_active_set();
+  }
+
+  return finish(converged);
+}
+
+bool AdmmQpSolver::polish(const Eigen::SparseMatrix<double>& P,
+                          const Eigen::VectorXd& q,
+                          const Eigen::SparseMatrix<double>& G,
+                          const Eigen::VectorXd& lower,
+                          const Eigen::VectorXd& upper,
+                          const std::vector<int>& active,
+                          const Eigen::VectorXd& tolerance,
+                          Eigen::VectorXd* x, Eigen::VectorXd* y) {
+  CHECK_NOTNULL(x);
+  CHECK_NOTNULL(y);
+  const int n = P.cols();
+  const int m = G.rows();
+  std::vector<int> active_rows;
+  for (int i = 0; i < m; ++i) {
+    if (active[i] != 0) {
+      active_rows.push_back(i);
+    }
+  }
+  const int n_active = active_rows.size();
+
+  // Quasi-definite KKT system [P + delta I, G_A^T; G_A, -delta I] of the
+  // equality-constrained problem, which LDL^T factorizes without pivoting.
+  const double delta = 1.0e-9;
+  typedef Eigen::Triplet<double> Triplet;
+  std::vector<Triplet> triplets;
+  triplets.reserve(P.nonZeros() + 2 * G.nonZeros() + n + n_active);
+  std::vector<Triplet> triplets_regularization;
+  for (int k = 0; k < P.outerSize(); ++k) {
+    for (Eigen::SparseMatrix<double>::InnerIterator it(P, k); it; ++it) {
+      triplets.emplace_back(it.row(), it.col(), it.value());
+    }
+  }
+  Eigen::VectorXd rhs(n + n_active);
+  rhs.head(n) = -q;
+  std::vector<int> kkt_row(m, -1);
+  for (int j = 0; j < n_active; ++j) {
+    const int i = active_rows[j];
+    kkt_row[i] = n + j;
+    rhs[n + j] = active[i] > 0 ? upper[i] : lower[i];
+  }
+  for (int k = 0; k < G.outerSize(); ++k) {
+    for (Eigen::SparseMatrix<double>::InnerIterator it(G, k); it; ++it) {
+      if (kkt_row[it.row()] >= 0) {
+        triplets.emplace_back(kkt_row[it.row()], it.col(), it.value());
+        triplets.emplace_back(it.col(), kkt_row[it.row()], it.value());
+      }
+    }
+  }
+  Eigen::SparseMatrix<double> K(n + n_active, n + n_active);
+  K.setFromTriplets(triplets.begin(), triplets.end());
+  for (int i = 0; i < n; ++i) {
+    triplets_regularization.emplace_back(i, i, delta);
+  }
+  for (int i = n; i < n + n_active; ++i) {
+    triplets_regularization.emplace_back(i, i, -delta);
+  }
+  Eigen::SparseMatrix<double> regularization(n + n_active, n + n_active);
+  regularization.setFromTriplets(triplets_regularization.begin(),
+                                 triplets_regularization.end());
+
+  Eigen::SimplicialLDLT<Eigen::SparseMatrix<double> > kkt_solver(
+      K + regularization);
+  if (kkt_solver.info() != Eigen::Success) {
+    return false;
+  }
+  // Iterative refinement removes the error of the regularization.
+  Eigen::VectorXd solution = kkt_solver.solve(rhs);
+  for (int i = 0; i < 3; ++i) {
+    solution += kkt_solver.solve(rhs - K * solution);
+  }
+  if (!solution.allFinite()) {
+    return false;
+  }
+
+  // The solution is optimal if it meets the inactive bounds and the
+  // multipliers push against the active bounds.
+  const Eigen::VectorXd Gx = G * solution.head(n);
+  for (int i = 0; i < m; ++i) {
+    if (Gx[i] < lower[i] - tolerance[i] || Gx[i] > upper[i] + tolerance[i]) {
+      return false;
+    }
+    if (kkt_row[i] >= 0 && solution[kkt_row[i]] * active[i] < 0.0) {
+      return false;
+    }
+  }
+
+  *x = solution.head(n);
+  y->setZero(m);
+  for (int i = 0; i < m; ++i) {
+    if (kkt_row[i] >= 0) {
+      (*y)[i] = solution[kkt_row[i]];
+    }
+  }
+  return true;
+}
+
+}  // namespace mav_trajectory_generation
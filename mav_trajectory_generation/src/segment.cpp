@@ -20,6 +20,7 @@
 
 #include "mav_trajectory_generation/segment.h"
 
+#include <atomic>
 #include <cmath>
 #include <limits>
 
@@ -29,8 +30,11 @@ bool Segment::operator==(const Segment& rhs) const {
   if (D_ != rhs.D_ || time_ != rhs.time_) {
     return false;
   } else {
+    if (sharesPolynomialsWith(rhs)) {
+      return true;
+    }
     for (int i = 0; i < D(); i++) {
-      if (polynomials_[i] != rhs[i]) {
+      if ((*polynomials_)[i] != rhs[i]) {
         return false;
       }
     }
@@ -38,21 +42,34 @@ bool Segment::operator==(const Segment& rhs) const {
   return true;
 }
 
+Polynomial::Vector& Segment::mutablePolynomials() {
+  if (polynomials_.use_count() > 1) {
+    polynomials_ = std::make_shared<Polynomial::Vector>(*polynomials_);
+  } else {
+    // use_count() is a relaxed load. A copy in another thread may have been
+    // destroyed just before, right after reading the polynomials. The fence
+    // orders those reads, released by the reference count decrement, before
+    // the writes through the returned reference.
+    std::atomic_thread_fence(std::memory_order_acquire);
+  }
+  return *polynomials_;
+}
+
 Polynomial& Segment::operator[](size_t idx) {
   CHECK_LT(idx, static_cast<size_t>(D_));
-  return polynomials_[idx];
+  return mutablePolynomials()[idx];
 }
 
 const Polynomial& Segment::operator[](size_t idx) const {
   CHECK_LT(idx, static_cast<size_t>(D_));
-  return polynomials_[idx];
+  return (*polynomials_)[idx];
 }
 
 Eigen::VectorXd Segment::evaluate(double t, int derivative) const {
   Eigen::VectorXd result(D_);
   result.setZero();
   for (int d = 0; d < D_; ++d) {
-    result[d] = polynomials_[d].evaluate(t, derivative);
+    result[d] = (*polynomials_)[d].evaluate(t, derivative);
   }
   return result;
 }
@@ -107,9 +124,9 @@ bool Segment::computeMinMaxMagnitudeCandidateTimes(
       // only the lower powers of t have non-zero coefficients.
       // So we take the head.
       Eigen::VectorXd d =
-          polynomials_[dim].getCoefficients(derivative).head(n_d);
+          (*polynomials_)[dim].getCoefficients(derivative).head(n_d);
       Eigen::VectorXd dd =
-          polynomials_[dim].getCoefficients(derivative + 1).head(n_dd);
+          (*polynomials_)[dim].getCoefficients(derivative + 1).head(n_dd);
       convolved_coefficients += Polynomial::convolve(d, dd);
     }
     Polynomial polynomial_convolved(convolved_coefficients);
@@ -124,7 +141,7 @@ bool Segment::computeMinMaxMagnitudeCandidateTimes(
   } else {
     // For dimension.size() == 1  we can simply evaluate the roots of the
     // derivative.
-    if (!polynomials_[dimensions[0]].computeMinMaxCandidates(
+    if (!(*polynomials_)[dimensions[0]].computeMinMaxCandidates(
             t_start, t_end, derivative, candidate_times)) {
       return false;
     }
@@ -148,7 +165,7 @@ bool Segment::computeMinMaxMagnitudeCandidates(
     double magnitude = 0.0;
     for (int dim : dimensions) {
       magnitude += std::pow(
-          polynomials_[dim].evaluate(candidate_times[i], derivative), 2);
+          (*polynomials_)[dim].evaluate(candidate_times[i], derivative), 2);
     }
     magnitude = std::sqrt(magnitude);
     (*candidates)[i] = Extremum(candidate_times[i], magnitude, 0);
@@ -192,7 +209,7 @@ bool Segment::getSegmentWithSingleDimension(int dimension,
   }
 
   *new_segment = Segment(N_, 1);
-  (*new_segment)[0] = polynomials_[dimension];
+  (*new_segment)[0] = (*polynomials_)[dimension];
   new_segment->setTime(time_);
   return true;
 }
@@ -242,7 +259,7 @@ bool Segment::getSegmentWithAppendedDimension(const Segment& segment_to_append,
     for (int i = 0; i < new_D; i++) {
       Polynomial polynomial_to_append(new_N);
       if (i < D_) {
-        if (!polynomials_[i].getPolynomialWithAppendedCoefficients(
+        if (!(*polynomials_)[i].getPolynomialWithAppendedCoefficients(
                 new_N, &polynomial_to_append)) {
           return false;
         }
@@ -267,11 +284,111 @@ bool Segment::offsetSegment(const Eigen::VectorXd& A_r_B) {
   }
 
   // Only translate the first three dimensions.
+  Polynomial::Vector& polynomials = mutablePolynomials();
   for (size_t i = 0; i < std::min(D_, 3); ++i) {
-    polynomials_[i].offsetPolynomial(A_r_B(i));
+    polynomials[i].offsetPolynomial(A_r_B(i));
+  }
+
+  return true;
+}
+
+bool Segment::transformSegment(const Eigen::Affine3d& T_A_B) {
+  if (D_ < 3) {
+    LOG(WARNING) << "Only segments with at least three dimensions can be "
+                    "transformed.";
+    return false;
+  }
+  const Eigen::Matrix3d& linear = T_A_B.linear();
+
+  // The yaw is rotated by the angle of the transformation about z, or
+  // mirrored at the angle of the mirror axis, which is only well defined if
+  // the z-axis stays vertical.
+  const bool has_yaw = D_ > 3;
+  double yaw_offset = 0.0;
+  double yaw_sign = 1.0;
+  if (has_yaw) {
+    const double kTolerance = 1.0e-9 * linear.norm();
+    if (std::abs(linear(2, 0)) > kTolerance ||
+        std::abs(linear(2, 1)) > kTolerance ||
+        std::abs(linear(0, 2)) > kTolerance ||
+        std::abs(linear(1, 2)) > kTolerance) {
+      LOG(WARNING) << "The transformation of a segment with yaw has to keep "
+                      "the z-axis vertical.";
+      return false;
+    }
+    // The horizontal part has to be a scaled rotation or mirroring, i.e.
+    // L^T L = s^2 I, otherwise headings are not mapped by a single angle.
+    const Eigen::Matrix2d horizontal = linear.topLeftCorner<2, 2>();
+    const Eigen::Matrix2d gram = horizontal.transpose() * horizontal;
+    const double scale_squared = 0.5 * gram.trace();
+    if (scale_squared <= 0.0 ||
+        (gram - scale_squared * Eigen::Matrix2d::Identity()).norm() >
+            1.0e-9 * scale_squared) {
+      LOG(WARNING) << "The transformation of a segment with yaw has to scale "
+                      "both horizontal axes uniformly without shear.";
+      return false;
+    }
+    yaw_offset = std::atan2(linear(1, 0), linear(0, 0));
+    if (horizontal.determinant() < 0.0) {
+      yaw_sign = -1.0;
+    }
   }
 
+  Eigen::MatrixXd coefficients(N_, 3);
+  for (int d = 0; d < 3; ++d) {
+    coefficients.col(d) = (*polynomials_)[d].getCoefficients();
+  }
+  // Row n holds the n-th coefficients of x, y, z: c_n' = L * c_n.
+  coefficients *= linear.transpose();
+  coefficients.row(0) += T_A_B.translation().transpose();
+
+  Polynomial::Vector& polynomials = mutablePolynomials();
+  for (int d = 0; d < 3; ++d) {
+    polynomials[d].setCoefficients(coefficients.col(d));
+  }
+  if (has_yaw) {
+    Eigen::VectorXd yaw = yaw_sign * polynomials[3].getCoefficients();
+    yaw[0] += yaw_offset;
+    polynomials[3].setCoefficients(yaw);
+  }
+  return true;
+}
+
+bool Segment::crop(double t_start, double t_end, Segment* cropped) const {
+  CHECK_NOTNULL(cropped);
+  if (t_start < 0.0 || t_end > time_ || t_start >= t_end) {
+    LOG(WARNING) << "Invalid interval [" << t_start << ", " << t_end
+                 << "] for segment of time " << time_ << ".";
+    return false;
+  }
+
+  if (t_start == 0.0) {
+    *cropped = *this;
+  } else {
+    Polynomial::CoefficientMatrix coefficients(N_, D_);
+    for (int d = 0; d < D_; ++d) {
+      coefficients.col(d) = (*polynomials_)[d].getCoefficients();
+    }
+    Polynomial::shiftCoefficientsInTime(t_start, coefficients);
+    *cropped = Segment(N_, D_);
+    Polynomial::Vector& polynomials = cropped->mutablePolynomials();
+    for (int d = 0; d < D_; ++d) {
+      polynomials[d].setCoefficients(coefficients.col(d));
+    }
+  }
+  cropped->setTime(t_end - t_start);
   return true;
 }
 
+bool Segment::split(double t, Segment* first, Segment* second) const {
+  CHECK_NOTNULL(first);
+  CHECK_NOTNULL(second);
+  if (t <= 0.0 || t >= time_) {
+    LOG(WARNING) << "Split time " << t << " is not inside segment of time "
+                 << time_ << ".";
+    return false;
+  }
+  return crop(0.0, t, first) && crop(t, time_, second);
+}
+
 }  // namespace mav_trajectory_generation
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/thread_pool.h"
+
+#include <algorithm>
+
+namespace mav_trajectory_generation {
+
+namespace {
+// Whether the current thread is executing an iteration of a parallel loop.
+thread_local bool in_parallel_loop = false;
+
+std::atomic<size_t> parallel_segment_threshold(32);
+}  // namespace
+
+ThreadPool::ThreadPool(size_t n_threads)
+    : function_(nullptr),
+      n_indices_(0),
+      next_index_(0),
+      n_busy_workers_(0),
+      loop_id_(0),
+      stop_(false) {
+  if (n_threads == 0) {
+    n_threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  // The calling thread works on the loop as well.
+  workers_.reserve(n_threads - 1);
+  for (size_t i = 0; i + 1 < n_threads; ++i) {
+    workers_.emplace_back(&ThreadPool::workerLoop, this);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    stop_ = true;
+  }
+  loop_started_.notify_all();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+}
+
+void ThreadPool::parallelFor(size_t n,
+                             const std::function<void(size_t)>& function) {
+  if (n == 0) {
+    return;
+  }
+  // If another thread is running a loop on the pool, waiting for it would
+  // serialize the callers anyway, so the loop runs on the calling thread.
+  std::unique_lock<std::mutex> loop_lock(loop_mutex_, std::defer_lock);
+  if (workers_.empty() || n == 1 || in_parallel_loop ||
+      !loop_lock.try_lock()) {
+    for (size_t i = 0; i < n; ++i) {
+      function(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(mutex_);
+    function_ = &function;
+    n_indices_ = n;
+    next_index_ = 0;
+    n_busy_workers_ = workers_.size();
+    ++loop_id_;
+  }
+  loop_started_.notify_all();
+
+  in_parallel_loop = true;
+  processIndices();
+  in_parallel_loop = false;
+
+  std::unique_lock<std::mutex> lock(mutex_);
+  loop_finished_.wait(lock, [this] { return n_busy_workers_ == 0; });
+  function_ = nullptr;
+}
+
+void ThreadPool::workerLoop() {
+  in_parallel_loop = true;
+  size_t last_loop_id = 0;
+  while (true) {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      loop_started_.wait(lock, [this, last_loop_id] {
+        return stop_ || loop_id_ != last_loop_id;
+      });
+      if (stop_) {
+        return;
+      }
+      last_loop_id = loop_id_;
+    }
+
+    processIndices();
+
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      --n_busy_workers_;
+    }
+    loop_finished_.notify_one();
+  }
+}
+
+void ThreadPool::processIndices() {
+  size_t i;
+  while ((i = next_index_++) < n_indices_) {
+    (*function_)(i);
+  }
+}
+
+ThreadPool& getSharedThreadPool() {
+  static ThreadPool pool;
+  return pool;
+}
+
+void setParallelSegmentThreshold(size_t n_segments) {
+  parallel_segment_threshold = n_segments;
+}
+
+size_t getParallelSegmentThreshold() { return parallel_segment_threshold; }
+
+bool runsSegmentsInParallel(size_t n_segments) {
+  const size_t threshold = parallel_segment_threshold;
+  return threshold != 0 && n_segments >= threshold && !in_parallel_loop;
+}
+
+void parallelForSegments(size_t n_segments,
+                         const std::function<void(size_t)>& function) {
+  if (!runsSegmentsInParallel(n_segments)) {
+    for (size_t i = 0; i < n_segments; ++i) {
+      function(i);
+    }
+    return;
+  }
+  getSharedThreadPool().parallelFor(n_segments, function);
+}
+
+}  // namespace mav_trajectory_generation
@@ -0,0 +1,235 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/time_allocation_model.h"
+
+#include <yaml-cpp/yaml.h>
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+
+namespace mav_trajectory_generation {
+
+const std::string kTimeAllocationWeightsKey = "time_allocation_weights";
+
+constexpr int TimeAllocationModel::kNumFeatures;
+constexpr double TimeAllocationModel::kMinTimeRatio;
+constexpr double TimeAllocationModel::kMinSegmentTime;
+
+namespace {
+
+// Returns a reference to the position constraint of a vertex without copying
+// it. Positions have the lowest derivative order and thus come first.
+const Vertex::ConstraintValue& getPositionRef(const Vertex& vertex) {
+  CHECK(vertex.cBegin() != vertex.cEnd() &&
+        vertex.cBegin()->first == derivative_order::POSITION)
+      << "Time allocation requires a position constraint on every vertex.";
+  return vertex.cBegin()->second;
+}
+
+// Returns true if the vertex forces the vehicle to come to a stop.
+bool isStopVertex(const Vertex& vertex) {
+  for (Vertex::Constraints::const_iterator it = vertex.cBegin();
+       it != vertex.cEnd(); ++it) {
+    if (it->first == derivative_order::VELOCITY) {
+      return it->second.isZero();
+    }
+  }
+  return false;
+}
+
+// Normalized turn at vertex_idx: 0 for a straight path, 1 for a reversal or a
+// full stop. Start and end vertex always count as a full stop.
+double computeTurn(const Vertex::Vector& vertices, size_t vertex_idx) {
+  if (vertex_idx == 0 || vertex_idx + 1 >= vertices.size() ||
+      isStopVertex(vertices[vertex_idx])) {
+    return 1.0;
+  }
+  const Vertex::ConstraintValue& previous =
+      getPositionRef(vertices[vertex_idx - 1]);
+  const Vertex::ConstraintValue& current = getPositionRef(vertices[vertex_idx]);
+  const Vertex::ConstraintValue& next = getPositionRef(vertices[vertex_idx + 1]);
+  const double length_in = (current - previous).norm();
+  const double length_out = (next - current).norm();
+  if (length_in <= 0.0 || length_out <= 0.0) {
+    return 1.0;
+  }
+  const double cos_angle =
+      (current - previous).dot(next - current) / (length_in * length_out);
+  return 0.5 * (1.0 - std::max(-1.0, std::min(1.0, cos_angle)));
+}
+
+double computeSegmentLength(const Vertex::Vector& vertices,
+                            size_t segment_idx) {
+  return (getPositionRef(vertices[segment_idx + 1]) -
+          getPositionRef(vertices[segment_idx]))
+      .norm();
+}
+
+double computeRampTime(const Vertex::Vector& vertices, size_t segment_idx,
+                       double v_max, double a_max) {
+  return computeTimeVelocityRamp(getPositionRef(vertices[segment_idx]),
+                                 getPositionRef(vertices[segment_idx + 1]),
+                                 v_max, a_max);
+}
+
+}  // namespace
+
+TimeAllocationModel::TimeAllocationModel() : n_samples_(0) {
+  // Untrained: predict exactly the velocity ramp time.
+  weights_.setZero();
+  weights_[0] = 1.0;
+  clearSamples();
+}
+
+void TimeAllocationModel::computeFeatures(const Vertex::Vector& vertices,
+                                          size_t segment_idx, double v_max,
+                                          double a_max,
+                                          FeatureVector* features) {
+  CHECK_NOTNULL(features);
+  CHECK_LT(segment_idx + 1, vertices.size());
+  CHECK_GT(v_max, 0.0);
+  CHECK_GT(a_max, 0.0);
+
+  const double length = computeSegmentLength(vertices, segment_idx);
+  const double turn_start = computeTurn(vertices, segment_idx);
+  const double turn_end = computeTurn(vertices, segment_idx + 1);
+
+  double ratio_previous = 0.0;
+  if (segment_idx > 0) {
+    const double length_previous =
+        computeSegmentLength(vertices, segment_idx - 1);
+    ratio_previous = length_previous / (length_previous + length + 1.0e-9);
+  }
+  double ratio_next = 0.0;
+  if (segment_idx + 2 < vertices.size()) {
+    const double length_next = computeSegmentLength(vertices, segment_idx + 1);
+    ratio_next = length_next / (length_next + length + 1.0e-9);
+  }
+
+  // Close to 1 for short segments that are dominated by acceleration, close to
+  // 0 for long segments that are flown at v_max.
+  const double acceleration_limited = 1.0 / (1.0 + length * a_max /
+                                                       (v_max * v_max));
+
+  (*features) << 1.0, turn_start, turn_end, turn_start * turn_end,
+      ratio_previous, ratio_next, acceleration_limited,
+      turn_start * acceleration_limited, turn_end * acceleration_limited;
+}
+
+void TimeAllocationModel::addSample(const Vertex::Vector& vertices,
+                                    const std::vector<double>& segment_times,
+                                    double v_max, double a_max) {
+  CHECK_EQ(vertices.size(), segment_times.size() + 1);
+  FeatureVector features;
+  for (size_t i = 0; i < segment_times.size(); ++i) {
+    const double ramp_time = computeRampTime(vertices, i, v_max, a_max);
+    if (ramp_time <= 0.0) {
+      // Zero length segments carry no information about the time ratio.
+      continue;
+    }
+    computeFeatures(vertices, i, v_max, a_max, &features);
+    const double ratio = segment_times[i] / ramp_time;
+    jtj_.noalias() += features * features.transpose();
+    jty_.noalias() += features * ratio;
+    ++n_samples_;
+  }
+}
+
+bool TimeAllocationModel::train(double regularization) {
+  if (n_samples_ == 0) {
+    LOG(WARNING) << "No samples to train the time allocation model.";
+    return false;
+  }
+  const FeatureMatrix regularized =
+      jtj_ + regularization * n_samples_ * FeatureMatrix::Identity();
+  weights_ = regularized.ldlt().solve(jty_);
+  return true;
+}
+
+void TimeAllocationModel::clearSamples() {
+  jtj_.setZero();
+  jty_.setZero();
+  n_samples_ = 0;
+}
+
+void TimeAllocationModel::estimateSegmentTimes(
+    const Vertex::Vector& vertices, double v_max, double a_max,
+    std::vector<double>* segment_times) const {
+  CHECK_NOTNULL(segment_times);
+  CHECK_GE(vertices.size(), 2u);
+  const size_t n_segments = vertices.size() - 1;
+  segment_times->resize(n_segments);
+
+  FeatureVector features;
+  for (size_t i = 0; i < n_segments; ++i) {
+    computeFeatures(vertices, i, v_max, a_max, &features);
+    const double ratio = std::max(kMinTimeRatio, weights_.dot(features));
+    (*segment_times)[i] = std::max(
+        kMinSegmentTime, ratio * computeRampTime(vertices, i, v_max, a_max));
+  }
+}
+
+std::vector<double> TimeAllocationModel::estimateSegmentTimes(
+    const Vertex::Vector& vertices, double v_max, double a_max) const {
+  std::vector<double> segment_times;
+  estimateSegmentTimes(vertices, v_max, a_max, &segment_times);
+  return segment_times;
+}
+
+bool TimeAllocationModel::saveToFile(const std::string& filename) const {
+  YAML::Emitter out;
+  out << YAML::BeginMap;
+  out << YAML::Key << kTimeAllocationWeightsKey;
+  out << YAML::Flow << YAML::BeginSeq;
+  for (int i = 0; i < kNumFeatures; ++i) {
+    out << weights_[i];
+  }
+  out << YAML::EndSeq;
+  out << YAML::EndMap;
+
+  std::ofstream fout(filename);
+  if (!fout) {
+    return false;
+  }
+  fout << out.c_str();
+  fout.close();
+  return true;
+}
+
+bool TimeAllocationModel::loadFromFile(const std::string& filename) {
+  std::ifstream in(filename);
+  if (!in.good()) {
+    return false;
+  }
+
+  YAML::Node node = YAML::LoadFile(filename);
+  const YAML::Node& weights_yaml = node[kTimeAllocationWeightsKey];
+  if (!weights_yaml || !weights_yaml.IsSequence() ||
+      weights_yaml.size() != kNumFeatures) {
+    return false;
+  }
+  for (int i = 0; i < kNumFeatures; ++i) {
+    weights_[i] = weights_yaml[i].as<double>();
+  }
+  return true;
+}
+
+}  // namespace mav_trajectory_generation
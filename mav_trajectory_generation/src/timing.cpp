@@ -43,6 +43,7 @@ Timing::~Timing() {}
 
 // Static functions to query the timers:
 size_t Timing::GetHandle(std::string const& tag) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   // Search for an existing tag.
   map_t::iterator i = Instance().tag_map_.find(tag);
   if (i == Instance().tag_map_.end()) {
@@ -61,6 +62,7 @@ size_t Timing::GetHandle(std::string const& tag) {
 }
 
 std::string Timing::GetTag(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   std::string tag;
 
   // Perform a linear search for the tag.
@@ -104,40 +106,47 @@ void Timer::Stop() {
 bool Timer::IsTiming() const { return timing_; }
 
 void Timing::AddTime(size_t handle, double seconds) {
+  std::lock_guard<std::recursive_mutex> lock(mutex_);
   timers_[handle].acc_.Add(seconds);
 }
 
 double Timing::GetTotalSeconds(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.Sum();
 }
 double Timing::GetTotalSeconds(std::string const& tag) {
   return GetTotalSeconds(GetHandle(tag));
 }
 double Timing::GetMeanSeconds(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.Mean();
 }
 double Timing::GetMeanSeconds(std::string const& tag) {
   return GetMeanSeconds(GetHandle(tag));
 }
 size_t Timing::GetNumSamples(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.TotalSamples();
 }
 size_t Timing::GetNumSamples(std::string const& tag) {
   return GetNumSamples(GetHandle(tag));
 }
 double Timing::GetVarianceSeconds(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.LazyVariance();
 }
 double Timing::GetVarianceSeconds(std::string const& tag) {
   return GetVarianceSeconds(GetHandle(tag));
 }
 double Timing::GetMinSeconds(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.Min();
 }
 double Timing::GetMinSeconds(std::string const& tag) {
   return GetMinSeconds(GetHandle(tag));
 }
 double Timing::GetMaxSeconds(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return Instance().timers_[handle].acc_.Max();
 }
 double Timing::GetMaxSeconds(std::string const& tag) {
@@ -145,6 +154,7 @@ double Timing::GetMaxSeconds(std::string const& tag) {
 }
 
 double Timing::GetHz(size_t handle) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   return 1.0 / Instance().timers_[handle].acc_.RollingMean();
 }
 
@@ -157,6 +167,7 @@ std::string Timing::SecondsToTimeString(double seconds) {
 }
 
 void Timing::Print(std::ostream& out) {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
   map_t& tagMap = Instance().tag_map_;
 
   if (tagMap.empty()) {
@@ -197,7 +208,10 @@ std::string Timing::Print() {
   return ss.str();
 }
 
-void Timing::Reset() { Instance().tag_map_.clear(); }
+void Timing::Reset() {
+  std::lock_guard<std::recursive_mutex> lock(Instance().mutex_);
+  Instance().tag_map_.clear();
+}
 
 }  // namespace timing
 }  // namespace mav_trajectory_generation
@@ -19,6 +19,7 @@
  */
 
 #include "mav_trajectory_generation/trajectory.h"
+#include "mav_trajectory_generation/thread_pool.h"
 #include <limits>
 
 // fixes error due to std::iota (has been introduced in c++ standard lately
@@ -154,7 +155,7 @@ Trajectory Trajectory::getTrajectoryWithSingleDimension(int dimension) const {
   }
 
   Trajectory traj;
-  traj.setSegments(segments);
+  traj.setSegments(std::move(segments));
   return traj;
 }
 
@@ -181,10 +182,10 @@ bool Trajectory::getTrajectoryWithAppendedDimension(
             trajectory_to_append.segments()[k], &new_segment)) {
       return false;
     }
-    segments.push_back(new_segment);
+    segments.push_back(std::move(new_segment));
   }
 
-  new_trajectory->setSegments(segments);
+  new_trajectory->setSegments(std::move(segments));
   return true;
 }
 
@@ -197,29 +198,68 @@ bool Trajectory::computeMinMaxMagnitude(int derivative,
   minimum->value = std::numeric_limits<double>::max();
   maximum->value = std::numeric_limits<double>::lowest();
 
-  // For all segments in the trajectory:
-  for (size_t segment_idx = 0; segment_idx < segments_.size(); segment_idx++) {
-    // Compute candidates.
+  if (!runsSegmentsInParallel(segments_.size())) {
+    // For all segments in the trajectory:
     std::vector<Extremum> candidates;
+    for (size_t segment_idx = 0; segment_idx < segments_.size();
+         segment_idx++) {
+      // Compute candidates.
+      if (!segments_[segment_idx].computeMinMaxMagnitudeCandidates(
+              derivative, 0.0, segments_[segment_idx].getTime(), dimensions,
+              &candidates)) {
+        return false;
+      }
+      // Evaluate candidates.
+      Extremum minimum_candidate, maximum_candidate;
+      if (!segments_[segment_idx].selectMinMaxMagnitudeFromCandidates(
+              derivative, 0.0, segments_[segment_idx].getTime(), dimensions,
+              candidates, &minimum_candidate, &maximum_candidate)) {
+        return false;
+      }
+      // Select minimum / maximum.
+      if (minimum_candidate < *minimum) {
+        *minimum = minimum_candidate;
+        minimum->segment_idx = static_cast<int>(segment_idx);
+      }
+      if (maximum_candidate > *maximum) {
+        *maximum = maximum_candidate;
+        maximum->segment_idx = static_cast<int>(segment_idx);
+      }
+    }
+    return true;
+  }
+
+  // Evaluate the segments independently in parallel.
+  std::vector<Extremum> segment_minima(segments_.size());
+  std::vector<Extremum> segment_maxima(segments_.size());
+  std::vector<char> segment_success(segments_.size(), false);
+  parallelForSegments(segments_.size(), [&](size_t segment_idx) {
+    // Kept per thread across calls to avoid allocations.
+    static thread_local std::vector<Extremum> candidates;
     if (!segments_[segment_idx].computeMinMaxMagnitudeCandidates(
             derivative, 0.0, segments_[segment_idx].getTime(), dimensions,
             &candidates)) {
-      return false;
+      return;
     }
-    // Evaluate candidates.
-    Extremum minimum_candidate, maximum_candidate;
-    if (!segments_[segment_idx].selectMinMaxMagnitudeFromCandidates(
+    segment_success[segment_idx] =
+        segments_[segment_idx].selectMinMaxMagnitudeFromCandidates(
             derivative, 0.0, segments_[segment_idx].getTime(), dimensions,
-            candidates, &minimum_candidate, &maximum_candidate)) {
+            candidates, &segment_minima[segment_idx],
+            &segment_maxima[segment_idx]);
+  });
+
+  // Select minimum / maximum in segment order, such that ties resolve as in
+  // the serial search.
+  for (size_t segment_idx = 0; segment_idx < segments_.size(); segment_idx++) {
+    if (!segment_success[segment_idx]) {
       return false;
     }
-    // Select minimum / maximum.
-    if (minimum_candidate < *minimum) {
-      *minimum = minimum_candidate;
+    if (segment_minima[segment_idx] < *minimum) {
+      *minimum = segment_minima[segment_idx];
       minimum->segment_idx = static_cast<int>(segment_idx);
     }
-    if (maximum_candidate > *maximum) {
-      *maximum = maximum_candidate;
+    if (segment_maxima[segment_idx] > *maximum) {
+      *maximum = segment_maxima[segment_idx];
       maximum->segment_idx = static_cast<int>(segment_idx);
     }
   }
@@ -227,13 +267,19 @@ bool Trajectory::computeMinMaxMagnitude(int derivative,
 }
 
 std::vector<double> Trajectory::getSegmentTimes() const {
-  std::vector<double> segment_times(segments_.size());
-  for (size_t i = 0; i < segment_times.size(); ++i) {
-    segment_times[i] = segments_[i].getTime();
-  }
+  std::vector<double> segment_times;
+  getSegmentTimes(&segment_times);
   return segment_times;
 }
 
+void Trajectory::getSegmentTimes(std::vector<double>* segment_times) const {
+  CHECK_NOTNULL(segment_times);
+  segment_times->resize(segments_.size());
+  for (size_t i = 0; i < segment_times->size(); ++i) {
+    (*segment_times)[i] = segments_[i].getTime();
+  }
+}
+
 bool Trajectory::addTrajectories(const std::vector<Trajectory>& trajectories,
                                  Trajectory* merged) const {
   CHECK_NOTNULL(merged);
@@ -251,14 +297,61 @@ bool Trajectory::addTrajectories(const std::vector<Trajectory>& trajectories,
       return false;
     }
     // Add segments.
-    Segment::Vector segments;
-    t.getSegments(&segments);
-    merged->addSegments(segments);
+    merged->addSegments(t.segments());
   }
 
   return true;
 }
 
+bool Trajectory::transformTrajectory(const Eigen::Affine3d& T_A_B) {
+  for (Segment& s : segments_) {
+    // Returns false if dimension check fails at segment level.
+    if (!s.transformSegment(T_A_B)) return false;
+  }
+  return true;
+}
+
+bool Trajectory::crop(double t_start, double t_end,
+                      Trajectory* cropped) const {
+  CHECK_NOTNULL(cropped);
+  if (t_start < 0.0 || t_end > max_time_ || t_start >= t_end) {
+    LOG(WARNING) << "Invalid interval [" << t_start << ", " << t_end
+                 << "] for trajectory of time " << max_time_ << ".";
+    return false;
+  }
+
+  Segment::Vector segments;
+  double segment_start = 0.0;
+  for (const Segment& segment : segments_) {
+    const double segment_end = segment_start + segment.getTime();
+    if (segment_end > t_start && segment_start < t_end) {
+      // Compare in absolute time, such that segments that are covered
+      // completely are not cut by rounding errors.
+      const double local_start =
+          t_start <= segment_start ? 0.0 : t_start - segment_start;
+      const double local_end =
+          t_end >= segment_end
+              ? segment.getTime()
+              : std::min(t_end - segment_start, segment.getTime());
+      if (local_start == 0.0 && local_end == segment.getTime()) {
+        segments.push_back(segment);
+      } else if (local_start < local_end) {
+        Segment part(N_, D_);
+        if (!segment.crop(local_start, local_end, &part)) {
+          return false;
+        }
+        segments.push_back(std::move(part));
+      }
+    }
+    segment_start = segment_end;
+  }
+  if (segments.empty()) {
+    return false;
+  }
+  cropped->setSegments(std::move(segments));
+  return true;
+}
+
 bool Trajectory::offsetTrajectory(const Eigen::VectorXd& A_r_B) {
   if (A_r_B.size() < std::min(D_, 3)) {
     LOG(WARNING) << "Offset vector size smaller than trajectory dimension.";
@@ -340,6 +433,127 @@ bool Trajectory::getVertices(int max_derivative_order,
   return true;
 }
 
+// Helpers for the minimum distance between trajectories.
+namespace {
+// Returns the polynomial of one dimension of a trajectory in the local time
+// t_local = t - t_segment_start of the segment with index segment_idx, padded
+// to N coefficients. Past the last segment, the final value is held.
+Polynomial getShiftedPolynomial(const Segment::Vector& segments,
+                                size_t segment_idx, int dimension,
+                                double t_local, int N) {
+  Eigen::VectorXd coefficients = Eigen::VectorXd::Zero(N);
+  if (segment_idx < segments.size()) {
+    const Polynomial& polynomial = segments[segment_idx][dimension];
+    coefficients.head(polynomial.N()) = polynomial.getCoefficients();
+    Polynomial shifted(coefficients);
+    shifted.shiftPolynomialInTime(t_local);
+    return shifted;
+  }
+  const Segment& last_segment = segments.back();
+  coefficients[0] = last_segment[dimension].evaluate(
+      last_segment.getTime(), derivative_order::POSITION);
+  return Polynomial(coefficients);
+}
+}  // namespace
+
+bool Trajectory::computeMinimumDistance(const Trajectory& other,
+                                        const std::vector<int>& dimensions,
+                                        Extremum* minimum) const {
+  CHECK_NOTNULL(minimum);
+  if (empty() || other.empty()) {
+    LOG(WARNING) << "Cannot compute the distance to or from an empty "
+                    "trajectory.";
+    return false;
+  }
+  for (int dimension : dimensions) {
+    if (dimension < 0 || dimension >= D_ || dimension >= other.D()) {
+      LOG(WARNING) << "Dimension " << dimension << " does not exist.";
+      return false;
+    }
+  }
+  minimum->value = std::numeric_limits<double>::max();
+
+  const int N = std::max(N_, other.N());
+  const size_t n_segments = segments_.size();
+  const size_t n_other_segments = other.segments().size();
+  const double t_end = std::max(max_time_, other.getMaxTime());
+
+  // Walk through the pieces in which neither trajectory switches segments.
+  // Segment index n_segments means that the trajectory has ended.
+  size_t segment_idx = 0;
+  size_t other_segment_idx = 0;
+  double t_segment_start = 0.0;
+  double t_other_segment_start = 0.0;
+  double t = 0.0;
+  Polynomial::Vector differences(dimensions.size(), Polynomial(N));
+  std::vector<double> candidates;
+  Eigen::VectorXcd roots;
+  while (segment_idx < n_segments || other_segment_idx < n_other_segments) {
+    const double t_segment_end =
+        segment_idx < n_segments
+            ? t_segment_start + segments_[segment_idx].getTime()
+            : t_end;
+    const double t_other_segment_end =
+        other_segment_idx < n_other_segments
+            ? t_other_segment_start +
+                  other.segments()[other_segment_idx].getTime()
+            : t_end;
+    const double t_piece_end = std::min(t_segment_end, t_other_segment_end);
+
+    // The minima of the squared distance sum_i(d_i^2) are among the roots of
+    // its derivative sum_i(2 * d_i * d_i') and the piece boundaries.
+    Eigen::VectorXd squared_distance_derivative =
+        Eigen::VectorXd::Zero(Polynomial::getConvolutionLength(N, N));
+    for (size_t i = 0; i < dimensions.size(); ++i) {
+      differences[i] =
+          getShiftedPolynomial(segments_, segment_idx, dimensions[i],
+                               t - t_segment_start, N) +
+          getShiftedPolynomial(other.segments(), other_segment_idx,
+                               dimensions[i], t - t_other_segment_start, N) *
+              -1.0;
+      squared_distance_derivative +=
+          Polynomial::convolve(differences[i].getCoefficients(),
+                               differences[i].getCoefficients(1));
+    }
+    Polynomial(squared_distance_derivative).getRoots(0, &roots);
+    if (!Polynomial::selectMinMaxCandidatesFromRoots(0.0, t_piece_end - t,
+                                                     roots, &candidates)) {
+      return false;
+    }
+
+    for (double candidate : candidates) {
+      double squared_distance = 0.0;
+      for (const Polynomial& difference : differences) {
+        const double d = difference.evaluate(candidate, 0);
+        squared_distance += d * d;
+      }
+      const double distance = std::sqrt(squared_distance);
+      if (distance < minimum->value) {
+        const size_t idx = std::min(segment_idx, n_segments - 1);
+        const double t_start =
+            segment_idx < n_segments
+                ? t_segment_start
+                : t_segment_start - segments_.back().getTime();
+        minimum->value = distance;
+        minimum->time = t + candidate - t_start;
+        minimum->segment_idx = static_cast<int>(idx);
+      }
+    }
+
+    t = t_piece_end;
+    if (segment_idx < n_segments && t_segment_end == t_piece_end) {
+      t_segment_start = t_segment_end;
+      ++segment_idx;
+    }
+    if (other_segment_idx < n_other_segments &&
+        t_other_segment_end == t_piece_end) {
+      t_other_segment_start = t_other_segment_end;
+      ++other_segment_idx;
+    }
+  }
+  return true;
+}
+
 // Compute max velocity and max acceleration.
 bool Trajectory::computeMaxVelocityAndAcceleration(double* v_max,
                                                    double* a_max) const {
@@ -0,0 +1,73 @@
+/*
+ * Copyright (c) 2016, Markus Achtelik, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Michael Burri, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Helen Oleynikova, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Rik Bähnemann, ASL, ETH Zurich, Switzerland
+ * Copyright (c) 2016, Marija Popovic, ASL, ETH Zurich, Switzerland
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ * http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "mav_trajectory_generation/trajectory_handoff.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace mav_trajectory_generation {
+
+constexpr uint32_t TrajectoryHandoff::kIndexMask;
+constexpr uint32_t TrajectoryHandoff::kUpdateFlag;
+
+double TrajectoryHandoff::Snapshot::getTrajectoryTime(double time) const {
+  return std::min(std::max(time - start_time, 0.0), trajectory.getMaxTime());
+}
+
+TrajectoryHandoff::TrajectoryHandoff()
+    : middle_(1), back_(2), n_published_(0), front_(0) {}
+
+void TrajectoryHandoff::publish(const Trajectory& trajectory,
+                                double start_time) {
+  Snapshot& slot = slots_[back_];
+  slot.trajectory = trajectory;
+  slot.start_time = start_time;
+  slot.version = ++n_published_;
+  swapBackSlot();
+}
+
+void TrajectoryHandoff::publish(Trajectory&& trajectory, double start_time) {
+  Snapshot& slot = slots_[back_];
+  slot.trajectory = std::move(trajectory);
+  slot.start_time = start_time;
+  slot.version = ++n_published_;
+  swapBackSlot();
+}
+
+void TrajectoryHandoff::swapBackSlot() {
+  // Release: the snapshot is written before the controller can see it.
+  // Acquire: the controller is done with the slot that becomes the back slot.
+  back_ = middle_.exchange(back_ | kUpdateFlag, std::memory_order_acq_rel) &
+          kIndexMask;
+}
+
+const TrajectoryHandoff::Snapshot& TrajectoryHandoff::acquire() {
+  if (middle_.load(std::memory_order_relaxed) & kUpdateFlag) {
+    front_ = middle_.exchange(front_, std::memory_order_acq_rel) & kIndexMask;
+  }
+  return slots_[front_];
+}
+
+bool TrajectoryHandoff::hasUpdate() const {
+  return (middle_.load(std::memory_order_relaxed) & kUpdateFlag) != 0;
+}
+
+}  // namespace mav_trajectory_generation
@@ -18,6 +18,7 @@
  * limitations under the License.
  */
 
+#include <algorithm>
 #include <random>
 
 #include "mav_trajectory_generation/vertex.h"
@@ -271,6 +272,98 @@ std::vector<double> estimateSegmentTimesNfabian(const Vertex::Vector& vertices,
   return segment_times;
 }
 
+namespace {
+// Distance of point p to the line segment from a to b.
+double distanceToLineSegment(const Eigen::VectorXd& p, const Eigen::VectorXd& a,
+                             const Eigen::VectorXd& b) {
+  const Eigen::VectorXd ab = b - a;
+  const double squared_length = ab.squaredNorm();
+  if (squared_length <= 0.0) {
+    return (p - a).norm();
+  }
+  const double s =
+      std::min(1.0, std::max(0.0, (p - a).dot(ab) / squared_length));
+  return (p - a - s * ab).norm();
+}
+}  // namespace
+
+void pruneVertices(const Vertex::Vector& vertices, double tolerance,
+                   Vertex::Vector* pruned_vertices,
+                   std::vector<size_t>* original_indices) {
+  CHECK_NOTNULL(pruned_vertices);
+  CHECK_GE(tolerance, 0.0);
+  const size_t n_vertices = vertices.size();
+
+  // Vertices that constrain anything but position are kept, as well as
+  // vertices without position constraint.
+  std::vector<Eigen::VectorXd> positions(n_vertices);
+  std::vector<bool> has_position(n_vertices, false);
+  std::vector<bool> keep(n_vertices, false);
+  for (size_t i = 0; i < n_vertices; ++i) {
+    const Vertex& vertex = vertices[i];
+    has_position[i] =
+        vertex.getConstraint(derivative_order::POSITION, &positions[i]);
+    keep[i] = i == 0 || i + 1 == n_vertices || !has_position[i] ||
+              vertex.getNumberOfConstraints() > 1;
+  }
+  // Vertices without position break the polyline: their neighbours are kept
+  // as well, such that no range below starts, ends or passes through them.
+  for (size_t i = 1; i + 1 < n_vertices; ++i) {
+    if (!has_position[i]) {
+      keep[i - 1] = true;
+      keep[i + 1] = true;
+    }
+  }
+
+  // Ramer-Douglas-Peucker between each pair of consecutive kept vertices,
+  // with an explicit stack since polylines may be long.
+  std::vector<std::pair<size_t, size_t> > ranges;
+  size_t start = 0;
+  for (size_t i = 1; i < n_vertices; ++i) {
+    if (keep[i]) {
+      if (i > start + 1 && has_position[start] && has_position[i]) {
+        ranges.push_back(std::make_pair(start, i));
+      }
+      start = i;
+    }
+  }
+  while (!ranges.empty()) {
+    const size_t first = ranges.back().first;
+    const size_t last = ranges.back().second;
+    ranges.pop_back();
+
+    double max_distance = 0.0;
+    size_t max_idx = first;
+    for (size_t i = first + 1; i < last; ++i) {
+      const double distance =
+          distanceToLineSegment(positions[i], positions[first],
+                                positions[last]);
+      if (distance > max_distance) {
+        max_distance = distance;
+        max_idx = i;
+      }
+    }
+    if (max_distance > tolerance) {
+      keep[max_idx] = true;
+      ranges.push_back(std::make_pair(first, max_idx));
+      ranges.push_back(std::make_pair(max_idx, last));
+    }
+  }
+
+  pruned_vertices->clear();
+  if (original_indices != nullptr) {
+    original_indices->clear();
+  }
+  for (size_t i = 0; i < n_vertices; ++i) {
+    if (keep[i]) {
+      pruned_vertices->push_back(vertices[i]);
+      if (original_indices != nullptr) {
+        original_indices->push_back(i);
+      }
+    }
+  }
+}
+
 double computeTimeVelocityRamp(const Eigen::VectorXd& start,
                                const Eigen::VectorXd& goal, double v_max,
                                double a_max) {
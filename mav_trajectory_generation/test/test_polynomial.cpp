@@ -136,6 +136,54 @@ TEST(PolynomialTest, FindMinMax) {
             << kNumPolynomials << " polynomials." << std::endl;
 }
 
+TEST(PolynomialTest, ShiftInTime) {
+  std::srand(1234567);
+  const int kNumPolynomials = 100;
+  for (int i = 0; i < kNumPolynomials; i++) {
+    const int num_coeffs = std::rand() % Polynomial::kMaxN + 1;
+    Eigen::VectorXd coeffs(num_coeffs);
+    for (int j = 0; j < num_coeffs; j++) {
+      coeffs[j] = createRandomDouble(-1.0, 1.0);
+    }
+    Polynomial p(coeffs);
+    Polynomial shifted = p;
+    const double t_shift = createRandomDouble(-2.0, 2.0);
+    shifted.shiftPolynomialInTime(t_shift);
+
+    for (double t = -1.0; t <= 1.0; t += 0.1) {
+      for (int derivative = 0; derivative < num_coeffs; derivative++) {
+        const double expected = p.evaluate(t + t_shift, derivative);
+        EXPECT_NEAR(expected, shifted.evaluate(t, derivative),
+                    1.0e-9 * std::max(1.0, std::abs(expected)));
+      }
+    }
+  }
+}
+
+TEST(PolynomialTest, ShiftCoefficientsInTime) {
+  std::srand(7654321);
+  const int kNumCoefficients = 10;
+  const int kDimension = 4;
+  Polynomial::CoefficientMatrix coefficients(kNumCoefficients, kDimension);
+  for (int i = 0; i < coefficients.size(); i++) {
+    coefficients(i) = createRandomDouble(-1.0, 1.0);
+  }
+  const double t_shift = createRandomDouble(-2.0, 2.0);
+  Polynomial::CoefficientMatrix shifted = coefficients;
+  Polynomial::shiftCoefficientsInTime(t_shift, shifted);
+
+  for (int d = 0; d < kDimension; d++) {
+    const Polynomial p(Eigen::VectorXd(coefficients.col(d)));
+    const Eigen::VectorXd shifted_coefficients = shifted.col(d);
+    for (double t = -1.0; t <= 1.0; t += 0.1) {
+      const double expected = p.evaluate(t + t_shift, 0);
+      EXPECT_NEAR(expected,
+                  Polynomial(shifted_coefficients).evaluate(t, 0),
+                  1.0e-9 * std::max(1.0, std::abs(expected)));
+    }
+  }
+}
+
 int main(int argc, char** argv) {
   testing::InitGoogleTest(&argc, argv);
 
@@ -18,18 +18,30 @@
  * limitations under the License.
  */
 
+#include <atomic>
 #include <iostream>
 #include <limits>
+#include <numeric>
 #include <random>
+#include <thread>
 
 #include <eigen-checks/entrypoint.h>
 #include <eigen-checks/glog.h>
 #include <eigen-checks/gtest.h>
 
+#include "mav_trajectory_generation/io.h"
+#include "mav_trajectory_generation/parameter_tuning.h"
+#include "mav_trajectory_generation/polynomial_optimization_batch.h"
 #include "mav_trajectory_generation/polynomial_optimization_linear.h"
+#include "mav_trajectory_generation/polynomial_optimization_multi_group.h"
+#include "mav_trajectory_generation/polynomial_optimization_multi_resolution.h"
 #include "mav_trajectory_generation/polynomial_optimization_nonlinear.h"
+#include "mav_trajectory_generation/polynomial_optimization_windowed.h"
 #include "mav_trajectory_generation/test_utils.h"
+#include "mav_trajectory_generation/thread_pool.h"
+#include "mav_trajectory_generation/time_allocation_model.h"
 #include "mav_trajectory_generation/timing.h"
+#include "mav_trajectory_generation/trajectory_handoff.h"
 
 using namespace mav_trajectory_generation;
 
@@ -91,6 +103,8 @@ class PolynomialOptimizationTests
   bool checkExtrema(const std::vector<double>& testee,
                     const std::vector<double>& reference,
                     double tol = 0.01) const;
+  // Linear solution through the vertices, with estimated segment times.
+  Trajectory solveLinearTrajectory() const;
 
   std::string getSuffix() const {
     std::ostringstream sstream;
@@ -247,6 +261,17 @@ bool PolynomialOptimizationTests::checkExtrema(
   return true;
 }
 
+Trajectory PolynomialOptimizationTests::solveLinearTrajectory() const {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+  return trajectory;
+}
+
 TEST_P(PolynomialOptimizationTests, VertexGeneration) {
   Eigen::VectorXd pos_min(D), pos_max(D);
   pos_min.setConstant(-params_.pos_bounds);
@@ -268,6 +293,98 @@ TEST_P(PolynomialOptimizationTests, VertexGeneration) {
   }
 }
 
+TEST_P(PolynomialOptimizationTests, VertexPruning) {
+  // Densify the vertices with noisy, position-only vertices.
+  const double kTolerance = 0.05;
+  const size_t kNumIntermediate = 20;
+  std::mt19937 generator(params_.seed);
+  std::uniform_real_distribution<double> noise(-0.4 * kTolerance / D,
+                                               0.4 * kTolerance / D);
+  Vertex::Vector dense_vertices;
+  size_t locked_idx = 0;
+  for (size_t i = 0; i + 1 < vertices_.size(); ++i) {
+    dense_vertices.push_back(vertices_[i]);
+    Eigen::VectorXd start, end;
+    vertices_[i].getConstraint(derivative_order::POSITION, &start);
+    vertices_[i + 1].getConstraint(derivative_order::POSITION, &end);
+    for (size_t k = 1; k <= kNumIntermediate; ++k) {
+      Eigen::VectorXd position =
+          start + (end - start) * k / (kNumIntermediate + 1.0);
+      for (int d = 0; d < D; ++d) position[d] += noise(generator);
+      Vertex vertex(D);
+      vertex.addConstraint(derivative_order::POSITION, position);
+      // A vertex with a velocity constraint has to be kept.
+      if (i == 0 && k == kNumIntermediate / 2) {
+        vertex.addConstraint(derivative_order::VELOCITY, 0.0);
+        locked_idx = dense_vertices.size();
+      }
+      dense_vertices.push_back(vertex);
+    }
+  }
+  dense_vertices.push_back(vertices_.back());
+
+  Vertex::Vector pruned_vertices;
+  std::vector<size_t> original_indices;
+  pruneVertices(dense_vertices, kTolerance, &pruned_vertices,
+                &original_indices);
+
+  ASSERT_EQ(pruned_vertices.size(), original_indices.size());
+  EXPECT_LE(pruned_vertices.size(), 2 * vertices_.size() + 1);
+  EXPECT_EQ(0u, original_indices.front());
+  EXPECT_EQ(dense_vertices.size() - 1, original_indices.back());
+  EXPECT_NE(original_indices.end(), std::find(original_indices.begin(),
+                                              original_indices.end(),
+                                              locked_idx));
+  for (size_t k = 0; k < pruned_vertices.size(); ++k) {
+    EXPECT_TRUE(
+        pruned_vertices[k].isEqualTol(dense_vertices[original_indices[k]],
+                                      1.0e-12));
+    if (k == 0) continue;
+    ASSERT_LT(original_indices[k - 1], original_indices[k]);
+
+    // All removed vertices are within tolerance of the pruned polyline.
+    Eigen::VectorXd a, b;
+    pruned_vertices[k - 1].getConstraint(derivative_order::POSITION, &a);
+    pruned_vertices[k].getConstraint(derivative_order::POSITION, &b);
+    for (size_t i = original_indices[k - 1] + 1; i < original_indices[k];
+         ++i) {
+      Eigen::VectorXd p;
+      dense_vertices[i].getConstraint(derivative_order::POSITION, &p);
+      const double s = std::min(
+          1.0, std::max(0.0, (p - a).dot(b - a) / (b - a).squaredNorm()));
+      EXPECT_LE((p - a - s * (b - a)).norm(), kTolerance + 1.0e-12);
+    }
+  }
+
+  // The pruned vertices can be optimized right away.
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(
+      pruned_vertices, estimateSegmentTimes(pruned_vertices, v_max, a_max),
+      max_derivative);
+  EXPECT_TRUE(opt.solveLinear());
+
+  // Vertices without position constraint break the polyline and are kept
+  // with their neighbours.
+  Vertex::Vector broken_vertices;
+  broken_vertices.push_back(dense_vertices.front());
+  Vertex velocity_only(D);
+  velocity_only.addConstraint(derivative_order::VELOCITY,
+                              Eigen::VectorXd::Zero(D));
+  broken_vertices.push_back(velocity_only);
+  for (int k = 0; k < 3; ++k) {
+    Vertex vertex(D);
+    vertex.addConstraint(derivative_order::POSITION,
+                         Eigen::VectorXd::Constant(D, 1.0 + 1.0e-3 * k));
+    broken_vertices.push_back(vertex);
+  }
+  broken_vertices.push_back(Vertex(D));
+  broken_vertices.push_back(dense_vertices.back());
+  pruneVertices(broken_vertices, kTolerance, &pruned_vertices,
+                &original_indices);
+  const std::vector<size_t> expected_indices = {0, 1, 2, 4, 5, 6};
+  EXPECT_EQ(expected_indices, original_indices);
+}
+
 TEST_P(PolynomialOptimizationTests, UnconstrainedLinearEstimateSegmentTimes) {
   std::vector<double> segment_times =
       estimateSegmentTimes(vertices_, v_max, a_max);
@@ -405,6 +522,79 @@ TEST_P(PolynomialOptimizationTests, ExtremaOfMagnitude) {
   EXPECT_NEAR(a_max_ref, a_max_traj.value, 0.01);
 }
 
+TEST_P(PolynomialOptimizationTests, ParallelExtrema) {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+  std::vector<int> dimensions(D);
+  std::iota(dimensions.begin(), dimensions.end(), 0);
+
+  const size_t default_threshold = getParallelSegmentThreshold();
+  std::vector<Extremum> maxima, minima;
+  std::vector<std::vector<Extremum> > candidates;
+  // Serial first, then distributed over the shared pool for any number of
+  // segments.
+  for (const size_t threshold : {size_t(0), size_t(1)}) {
+    setParallelSegmentThreshold(threshold);
+    for (int derivative = derivative_order::VELOCITY;
+         derivative <= derivative_order::JERK; ++derivative) {
+      std::vector<Extremum> opt_candidates;
+      maxima.push_back(
+          opt.computeMaximumOfMagnitude(derivative, &opt_candidates));
+      candidates.push_back(opt_candidates);
+      Extremum minimum, maximum;
+      ASSERT_TRUE(trajectory.computeMinMaxMagnitude(derivative, dimensions,
+                                                    &minimum, &maximum));
+      minima.push_back(minimum);
+      maxima.push_back(maximum);
+    }
+  }
+  setParallelSegmentThreshold(default_threshold);
+
+  // The results have to be identical, including the selected segment.
+  ASSERT_EQ(0u, maxima.size() % 2);
+  const size_t half = maxima.size() / 2;
+  for (size_t i = 0; i < half; ++i) {
+    EXPECT_EQ(maxima[i].value, maxima[i + half].value);
+    EXPECT_EQ(maxima[i].time, maxima[i + half].time);
+    EXPECT_EQ(maxima[i].segment_idx, maxima[i + half].segment_idx);
+  }
+  for (size_t i = 0; i < minima.size() / 2; ++i) {
+    const size_t j = i + minima.size() / 2;
+    EXPECT_EQ(minima[i].value, minima[j].value);
+    EXPECT_EQ(minima[i].segment_idx, minima[j].segment_idx);
+  }
+  for (size_t i = 0; i < candidates.size() / 2; ++i) {
+    const size_t j = i + candidates.size() / 2;
+    ASSERT_EQ(candidates[i].size(), candidates[j].size());
+    for (size_t k = 0; k < candidates[i].size(); ++k) {
+      EXPECT_EQ(candidates[i][k].value, candidates[j][k].value);
+      EXPECT_EQ(candidates[i][k].segment_idx, candidates[j][k].segment_idx);
+    }
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, ThreadPoolBusy) {
+  // A loop started by another thread while the pool is busy runs on that
+  // thread instead of waiting for the pool. Here the running loop waits for
+  // the other thread, which would deadlock otherwise.
+  ThreadPool pool(2);
+  std::atomic<size_t> n_inner_calls(0);
+  pool.parallelFor(2, [&](size_t i) {
+    if (i != 0) return;
+    std::thread other([&] {
+      pool.parallelFor(params_.num_segments,
+                       [&](size_t) { ++n_inner_calls; });
+    });
+    other.join();
+  });
+  EXPECT_EQ(params_.num_segments, static_cast<int>(n_inner_calls));
+}
+
 TEST_P(PolynomialOptimizationTests, UnconstrainedNonlinear) {
   std::vector<double> segment_times =
       estimateSegmentTimes(vertices_, v_max, a_max);
@@ -566,6 +756,22 @@ TEST_P(PolynomialOptimizationTests, ConstraintPacking) {
         EXPECT_TRUE(EIGEN_MATRIX_NEAR(p_seg, p.segment<N>(j * N), 1e-6));
       }
     }
+
+    // The solution from the blocks of R assembled for the solve is optimal
+    // for the full R, i.e. the gradient Rpp * dp + Rpf * df vanishes.
+    Eigen::MatrixXd R;
+    opt.getR(&R);
+    const size_t n_fixed = fixed_constraints[0].size();
+    const size_t n_free = free_constraints[0].size();
+    ASSERT_EQ(n_fixed + n_free, R.rows());
+    const Eigen::MatrixXd Rpp = R.bottomRightCorner(n_free, n_free);
+    const Eigen::MatrixXd Rpf = R.bottomLeftCorner(n_free, n_fixed);
+    for (int i = 0; i < D; ++i) {
+      const Eigen::VectorXd gradient_fixed = Rpf * fixed_constraints[i];
+      const Eigen::VectorXd gradient =
+          Rpp * free_constraints[i] + gradient_fixed;
+      EXPECT_LE(gradient.norm(), 1e-6 * std::max(1.0, gradient_fixed.norm()));
+    }
   }
 }
 
@@ -611,6 +817,1320 @@ TEST_P(PolynomialOptimizationTests, TimeAllocation) {
   EXPECT_LT(a_max_nfabian, a_max * 2.5);
 }
 
+TEST_P(PolynomialOptimizationTests, TimeAllocationModel) {
+  // Ground truth model that the regression should recover exactly.
+  TimeAllocationModel::FeatureVector true_weights;
+  true_weights << 1.2, 0.3, 0.4, 0.1, -0.2, -0.1, 0.5, 0.2, 0.3;
+
+  Eigen::VectorXd pos_min(D), pos_max(D);
+  pos_min.setConstant(-params_.pos_bounds);
+  pos_max.setConstant(params_.pos_bounds);
+
+  TimeAllocationModel model;
+  const size_t kNumTrainingSets = 5;
+  for (size_t i = 0; i < kNumTrainingSets; ++i) {
+    Vertex::Vector vertices = createRandomVertices(
+        max_derivative, params_.num_segments + 2, pos_min, pos_max,
+        params_.seed + 1000 + i);
+    std::vector<double> segment_times =
+        estimateSegmentTimesVelocityRamp(vertices, v_max, a_max);
+    for (size_t k = 0; k < segment_times.size(); ++k) {
+      TimeAllocationModel::FeatureVector features;
+      TimeAllocationModel::computeFeatures(vertices, k, v_max, a_max,
+                                           &features);
+      segment_times[k] *= true_weights.dot(features);
+    }
+    model.addSample(vertices, segment_times, v_max, a_max);
+  }
+  ASSERT_TRUE(model.train(0.0));
+
+  // Evaluate on unseen vertices.
+  std::vector<double> expected_times =
+      estimateSegmentTimesVelocityRamp(vertices_, v_max, a_max);
+  for (size_t k = 0; k < expected_times.size(); ++k) {
+    TimeAllocationModel::FeatureVector features;
+    TimeAllocationModel::computeFeatures(vertices_, k, v_max, a_max,
+                                         &features);
+    expected_times[k] *= true_weights.dot(features);
+  }
+
+  std::vector<double> estimated_times;
+  estimated_times.reserve(vertices_.size() - 1);
+  model.estimateSegmentTimes(vertices_, v_max, a_max, &estimated_times);
+  ASSERT_EQ(expected_times.size(), estimated_times.size());
+  for (size_t k = 0; k < expected_times.size(); ++k) {
+    EXPECT_NEAR(expected_times[k], estimated_times[k],
+                1.0e-3 * expected_times[k]);
+  }
+
+  // An untrained model falls back to the velocity ramp.
+  TimeAllocationModel untrained_model;
+  std::vector<double> ramp_times =
+      estimateSegmentTimesVelocityRamp(vertices_, v_max, a_max);
+  std::vector<double> untrained_times =
+      untrained_model.estimateSegmentTimes(vertices_, v_max, a_max);
+  for (size_t k = 0; k < ramp_times.size(); ++k) {
+    EXPECT_NEAR(ramp_times[k], untrained_times[k], 1.0e-9);
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, BatchOptimization) {
+  Eigen::VectorXd pos_min(D), pos_max(D);
+  pos_min.setConstant(-params_.pos_bounds);
+  pos_max.setConstant(params_.pos_bounds);
+
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 100;
+  parameters.random_seed = 12345678;
+
+  // Vehicles with different waypoints, but the same constraint pattern.
+  const size_t kNumVehicles = 6;
+  PolynomialOptimizationBatch<N> batch(D, parameters, 3);
+  std::vector<BatchOptimizationProblem> problems(kNumVehicles);
+  for (size_t i = 0; i < kNumVehicles; ++i) {
+    BatchOptimizationProblem& problem = problems[i];
+    problem.vertices =
+        createRandomVertices(getHighestDerivativeFromN(N), params_.num_segments,
+                             pos_min, pos_max, params_.seed + i);
+    problem.segment_times =
+        estimateSegmentTimes(problem.vertices, v_max, a_max);
+    problem.derivative_to_optimize = max_derivative;
+    problem.maximum_magnitude_constraints[derivative_order::VELOCITY] = v_max;
+    problem.maximum_magnitude_constraints[derivative_order::ACCELERATION] =
+        a_max;
+    EXPECT_EQ(i, batch.addProblem(problem));
+  }
+
+  // One vehicle with an additional constraint needs its own setup.
+  if (params_.num_segments > 1) {
+    BatchOptimizationProblem problem = problems.front();
+    problem.vertices[1].addConstraint(derivative_order::VELOCITY, 0.0);
+    problems.push_back(problem);
+    batch.addProblem(problem);
+  }
+
+  ASSERT_TRUE(batch.solveLinear());
+  EXPECT_EQ(params_.num_segments > 1 ? 2u : 1u,
+            batch.getNumberOfConstraintPatterns());
+  ASSERT_EQ(problems.size(), batch.getTrajectories().size());
+
+  // The batch has to match solving every vehicle on its own.
+  const double tol = 1.0e-6;
+  for (size_t i = 0; i < problems.size(); ++i) {
+    PolynomialOptimization<N> opt(D);
+    opt.setupFromVertices(problems[i].vertices, problems[i].segment_times,
+                          max_derivative);
+    opt.solveLinear();
+    Segment::Vector expected_segments, segments;
+    opt.getSegments(&expected_segments);
+    batch.getTrajectories()[i].getSegments(&segments);
+    ASSERT_EQ(expected_segments.size(), segments.size());
+    for (size_t k = 0; k < segments.size(); ++k) {
+      for (int d = 0; d < D; ++d) {
+        EXPECT_TRUE(EIGEN_MATRIX_NEAR(expected_segments[k][d].getCoefficients(),
+                                      segments[k][d].getCoefficients(), tol));
+      }
+    }
+    EXPECT_NEAR(opt.computeCost(),
+                batch.getOptimizationInfo(i).cost_trajectory,
+                tol * std::max(1.0, opt.computeCost()));
+    EXPECT_EQ(2u, batch.getOptimizationInfo(i).maxima.size());
+  }
+
+  // Nonlinear optimization is deterministic, so the results also have to
+  // match the serial ones.
+  if (params_.num_segments > 10) {
+    return;
+  }
+  ASSERT_TRUE(batch.optimize());
+  for (size_t i = 0; i < problems.size(); ++i) {
+    PolynomialOptimizationNonLinear<N> opt(D, parameters);
+    opt.setupFromVertices(problems[i].vertices, problems[i].segment_times,
+                          max_derivative);
+    opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+    opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_max);
+    opt.optimize();
+
+    std::vector<double> expected_times, times;
+    opt.getPolynomialOptimizationRef().getSegmentTimes(&expected_times);
+    times = batch.getTrajectories()[i].getSegmentTimes();
+    ASSERT_EQ(expected_times.size(), times.size());
+    for (size_t k = 0; k < times.size(); ++k) {
+      EXPECT_NEAR(expected_times[k], times[k], 1.0e-6);
+    }
+    EXPECT_EQ(opt.getOptimizationInfo().n_iterations,
+              batch.getOptimizationInfo(i).n_iterations);
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, MinimumTime) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kMinimumTime;
+  PolynomialOptimizationNonLinear<N> opt(D, parameters);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  // Without limits, there is no minimum time.
+  EXPECT_EQ(nlopt::INVALID_ARGS, opt.optimize());
+
+  opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_max);
+  EXPECT_GT(opt.optimize(), 0);
+  const OptimizationInfo info = opt.getOptimizationInfo();
+
+  // The limits hold exactly and at least one of them is active.
+  const PolynomialOptimization<N>& result = opt.getPolynomialOptimizationRef();
+  const double v = result.computeMaximumOfMagnitude(derivative_order::VELOCITY,
+                                                    nullptr).value;
+  const double a = result.computeMaximumOfMagnitude(
+                             derivative_order::ACCELERATION, nullptr).value;
+  EXPECT_LE(v, v_max);
+  EXPECT_LE(a, a_max);
+  ASSERT_FALSE(info.active_constraints.empty());
+  for (int derivative : info.active_constraints) {
+    const double limit =
+        derivative == derivative_order::VELOCITY ? v_max : a_max;
+    EXPECT_NEAR(limit, info.maxima.at(derivative).value, 0.01 * limit);
+  }
+
+  // Any uniformly faster trajectory violates a limit.
+  std::vector<double> optimized_times;
+  result.getSegmentTimes(&optimized_times);
+  for (double& t : optimized_times) t *= 0.99;
+  PolynomialOptimization<N> faster(D);
+  faster.setupFromVertices(vertices_, optimized_times, max_derivative);
+  faster.solveLinear();
+  EXPECT_TRUE(
+      faster.computeMaximumOfMagnitude(derivative_order::VELOCITY, nullptr)
+                  .value > v_max ||
+      faster.computeMaximumOfMagnitude(derivative_order::ACCELERATION, nullptr)
+                  .value > a_max);
+}
+
+TEST_P(PolynomialOptimizationTests, WindowedOptimization) {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 50;
+  WindowedOptimizationParameters window_parameters;
+  window_parameters.window_segments = 4;
+  window_parameters.overlap_segments = 2;
+  window_parameters.n_sweeps = 2;
+
+  PolynomialOptimizationWindowed<N> opt(D, parameters, window_parameters);
+  ASSERT_TRUE(opt.setupFromVertices(vertices_, segment_times, max_derivative));
+  opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_max);
+  opt.optimize();
+  if (params_.num_segments >= 2 * window_parameters.window_segments) {
+    EXPECT_GT(opt.getNumberOfWindows(), 1u);
+  }
+
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+  ASSERT_EQ(params_.num_segments, trajectory.K());
+  const std::vector<double> times = trajectory.getSegmentTimes();
+  for (size_t i = 0; i < times.size(); ++i) {
+    EXPECT_DOUBLE_EQ(opt.getSegmentTimes()[i], times[i]);
+  }
+
+  // The vertices are met, and the trajectory is as smooth across the cuts
+  // between windows as at any other vertex.
+  const Segment::Vector& segments = trajectory.segments();
+  for (size_t i = 0; i < segments.size(); ++i) {
+    Eigen::VectorXd position;
+    ASSERT_TRUE(vertices_[i].getConstraint(derivative_order::POSITION,
+                                           &position));
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(position, segments[i].evaluate(0.0), 1e-6));
+    if (i + 1 == segments.size()) {
+      break;
+    }
+    for (int derivative = 0;
+         derivative <= PolynomialOptimization<N>::kHighestDerivativeToOptimize;
+         ++derivative) {
+      const Eigen::VectorXd end =
+          segments[i].evaluate(segments[i].getTime(), derivative);
+      const Eigen::VectorXd start = segments[i + 1].evaluate(0.0, derivative);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+          end, start, 1e-6 * std::max(1.0, end.cwiseAbs().maxCoeff())))
+          << "segment " << i << " derivative " << derivative;
+    }
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, MultiResolution) {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 100;
+  MultiResolutionParameters resolution_parameters;
+  resolution_parameters.min_segments = 4;
+  resolution_parameters.refinement_iterations = 20;
+
+  PolynomialOptimizationMultiResolution<N> opt(D, parameters,
+                                               resolution_parameters);
+  ASSERT_TRUE(opt.setupFromVertices(vertices_, segment_times, max_derivative));
+  opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_max);
+
+  // Levels are added while they keep at least min_segments segments. Every
+  // level keeps the end points and is a subset of the finer one.
+  if (params_.num_segments >= 8) {
+    EXPECT_GT(opt.getNumberOfLevels(), 1u);
+  }
+  EXPECT_EQ(static_cast<size_t>(params_.num_segments + 1),
+            opt.getLevelVertexIndices(0).size());
+  for (size_t level = 1; level < opt.getNumberOfLevels(); ++level) {
+    const std::vector<size_t>& indices = opt.getLevelVertexIndices(level);
+    const std::vector<size_t>& finer = opt.getLevelVertexIndices(level - 1);
+    EXPECT_GE(indices.size() - 1, resolution_parameters.min_segments);
+    EXPECT_LT(indices.size(), finer.size());
+    EXPECT_EQ(0u, indices.front());
+    EXPECT_EQ(static_cast<size_t>(params_.num_segments), indices.back());
+    for (size_t index : indices) {
+      EXPECT_TRUE(std::binary_search(finer.begin(), finer.end(), index));
+    }
+  }
+
+  opt.optimize();
+  EXPECT_EQ(opt.getNumberOfLevels(), opt.getLevelOptimizationInfos().size());
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+  ASSERT_EQ(params_.num_segments, trajectory.K());
+  for (size_t i = 0; i < vertices_.size(); ++i) {
+    Eigen::VectorXd position;
+    ASSERT_TRUE(vertices_[i].getConstraint(derivative_order::POSITION,
+                                           &position));
+    const Eigen::VectorXd actual =
+        i < vertices_.size() - 1
+            ? trajectory.segments()[i].evaluate(0.0)
+            : trajectory.segments().back().evaluate(
+                  trajectory.segments().back().getTime());
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(position, actual, 1e-6));
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, MinimumSeparation) {
+  Eigen::VectorXd pos_min(D), pos_max(D);
+  pos_min.setConstant(-params_.pos_bounds);
+  pos_max.setConstant(params_.pos_bounds);
+
+  const Trajectory trajectory = solveLinearTrajectory();
+  const std::vector<double> segment_times = trajectory.getSegmentTimes();
+
+  // The neighbour has a different number of segments and duration.
+  Vertex::Vector neighbour_vertices =
+      createRandomVertices(getHighestDerivativeFromN(N),
+                           params_.num_segments + 1, pos_min, pos_max,
+                           params_.seed + 1);
+  PolynomialOptimization<N> neighbour_opt(D);
+  neighbour_opt.setupFromVertices(
+      neighbour_vertices,
+      estimateSegmentTimes(neighbour_vertices, 2.0 * v_max, 2.0 * a_max),
+      max_derivative);
+  neighbour_opt.solveLinear();
+  Trajectory neighbour;
+  neighbour_opt.getTrajectory(&neighbour);
+
+  std::vector<int> dimensions;
+  for (int d = 0; d < std::min(D, 3); ++d) dimensions.push_back(d);
+  Extremum minimum;
+  ASSERT_TRUE(trajectory.computeMinimumDistance(neighbour, dimensions,
+                                                &minimum));
+
+  // Compare against sampling, holding the final positions.
+  const double t_end = std::max(trajectory.getMaxTime(), neighbour.getMaxTime());
+  double min_sampled = std::numeric_limits<double>::max();
+  for (double t = 0.0; t <= t_end; t += 1.0e-3) {
+    const Eigen::VectorXd p =
+        trajectory.evaluate(std::min(t, trajectory.getMaxTime()));
+    const Eigen::VectorXd q =
+        neighbour.evaluate(std::min(t, neighbour.getMaxTime()));
+    double distance = 0.0;
+    for (int d : dimensions) distance += (p[d] - q[d]) * (p[d] - q[d]);
+    min_sampled = std::min(min_sampled, std::sqrt(distance));
+  }
+  EXPECT_LE(minimum.value, min_sampled + 1.0e-9);
+  EXPECT_NEAR(min_sampled, minimum.value, 1.0e-2);
+  ASSERT_GE(minimum.segment_idx, 0);
+  ASSERT_LT(minimum.segment_idx, trajectory.K());
+  const std::vector<double> times = trajectory.getSegmentTimes();
+  const double t_minimum =
+      std::accumulate(times.begin(), times.begin() + minimum.segment_idx,
+                      0.0) +
+      minimum.time;
+  const Eigen::VectorXd p =
+      trajectory.evaluate(std::min(t_minimum, trajectory.getMaxTime()));
+  const Eigen::VectorXd q =
+      neighbour.evaluate(std::min(t_minimum, neighbour.getMaxTime()));
+  double distance = 0.0;
+  for (int d : dimensions) distance += (p[d] - q[d]) * (p[d] - q[d]);
+  EXPECT_NEAR(minimum.value, std::sqrt(distance), 1.0e-6);
+
+  // A separation constraint to a neighbour that is too close adds cost.
+  if (params_.num_segments > 10) {
+    return;
+  }
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 100;
+  PolynomialOptimizationNonLinear<N> nlopt(D, parameters);
+  nlopt.setupFromVertices(vertices_, segment_times, max_derivative);
+  nlopt.solveLinear();
+  const double cost_without_separation =
+      nlopt.getTotalCostWithSoftConstraints();
+  ASSERT_TRUE(nlopt.addMinimumSeparationConstraint({neighbour},
+                                                   minimum.value + 1.0));
+  EXPECT_GT(nlopt.getTotalCostWithSoftConstraints(), cost_without_separation);
+
+  nlopt.optimize();
+  const OptimizationInfo info = nlopt.getOptimizationInfo();
+  ASSERT_EQ(1u, info.separation_minima.size());
+  Trajectory result;
+  nlopt.getTrajectory(&result);
+  Extremum result_minimum;
+  ASSERT_TRUE(
+      result.computeMinimumDistance(neighbour, dimensions, &result_minimum));
+  EXPECT_NEAR(result_minimum.value, info.separation_minima[0].value, 1.0e-6);
+}
+
+TEST_P(PolynomialOptimizationTests, CorridorConstraints) {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 100;
+  PolynomialOptimizationNonLinear<N> opt(D, parameters);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+
+  // Boxes around the sampled segments, with a margin.
+  const double kMargin = 0.1;
+  const int n_dims = std::min(D, 3);
+  std::vector<std::pair<Eigen::MatrixXd, Eigen::VectorXd> > polytopes;
+  for (const Segment& segment : trajectory.segments()) {
+    Eigen::VectorXd lower = Eigen::VectorXd::Constant(
+        n_dims, std::numeric_limits<double>::max());
+    Eigen::VectorXd upper = -lower;
+    for (double t = 0.0; t <= segment.getTime(); t += 1.0e-4) {
+      const Eigen::VectorXd p = segment.evaluate(t).head(n_dims);
+      lower = lower.cwiseMin(p);
+      upper = upper.cwiseMax(p);
+    }
+    Eigen::MatrixXd A(2 * n_dims, n_dims);
+    A << Eigen::MatrixXd::Identity(n_dims, n_dims),
+        -Eigen::MatrixXd::Identity(n_dims, n_dims);
+    // Scaled faces are normalized internally.
+    A *= 2.0;
+    Eigen::VectorXd b(2 * n_dims);
+    b << upper.array() + kMargin, -(lower.array() - kMargin);
+    b *= 2.0;
+    polytopes.push_back(std::make_pair(A, b));
+  }
+
+  EXPECT_FALSE(opt.addCorridorConstraint(
+      trajectory.K(), polytopes.front().first, polytopes.front().second));
+  EXPECT_FALSE(opt.addCorridorConstraint(
+      0, Eigen::MatrixXd::Identity(n_dims + 1, n_dims + 1),
+      Eigen::VectorXd::Zero(n_dims + 1)));
+  ASSERT_TRUE(opt.addCorridorConstraints(polytopes));
+
+  // The exact maxima are at least the sampled ones, and only slightly above.
+  opt.getTotalCostWithSoftConstraints();
+  OptimizationInfo info = opt.getOptimizationInfo();
+  ASSERT_EQ(static_cast<size_t>(trajectory.K()),
+            info.corridor_violations.size());
+  for (const auto& violation : info.corridor_violations) {
+    EXPECT_GE(violation.second, -kMargin - 1.0e-9);
+    EXPECT_NEAR(-kMargin, violation.second, 1.0e-3);
+  }
+
+  if (params_.num_segments > 10) {
+    return;
+  }
+  opt.optimize();
+  info = opt.getOptimizationInfo();
+  EXPECT_EQ(static_cast<size_t>(trajectory.K()),
+            info.corridor_violations.size());
+
+  // With hard constraints, the optimized trajectory stays inside the
+  // corridor. The reported violations agree with a sampled check.
+  parameters.use_soft_constraints = false;
+  parameters.algorithm = nlopt::LN_COBYLA;
+  PolynomialOptimizationNonLinear<N> opt_hard(D, parameters);
+  opt_hard.setupFromVertices(vertices_, segment_times, max_derivative);
+  ASSERT_TRUE(opt_hard.addCorridorConstraints(polytopes));
+  opt_hard.optimize();
+  opt_hard.getTotalCostWithSoftConstraints();
+  info = opt_hard.getOptimizationInfo();
+  ASSERT_EQ(static_cast<size_t>(trajectory.K()),
+            info.corridor_violations.size());
+  opt_hard.getTrajectory(&trajectory);
+  const int kNumSamples = 1000;
+  for (const auto& violation : info.corridor_violations) {
+    EXPECT_LE(violation.second, 1.0e-6);
+    const Segment& segment = trajectory.segments()[violation.first];
+    const Eigen::MatrixXd& A = polytopes[violation.first].first;
+    const Eigen::VectorXd& b = polytopes[violation.first].second;
+    double sampled_violation = std::numeric_limits<double>::lowest();
+    for (int i = 0; i <= kNumSamples; ++i) {
+      const double t = segment.getTime() * i / kNumSamples;
+      const Eigen::VectorXd p = segment.evaluate(t).head(n_dims);
+      sampled_violation = std::max(
+          sampled_violation,
+          ((A * p - b).array() / A.rowwise().norm().array()).maxCoeff());
+    }
+    EXPECT_GE(violation.second, sampled_violation - 1.0e-9);
+    EXPECT_NEAR(violation.second, sampled_violation, 1.0e-4);
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, EvaluationCache) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  // Tight limits, such that the constraints are active.
+  const double v_limit = 0.5 * v_max;
+  const double a_limit = 0.5 * a_max;
+
+  for (const bool use_soft_constraints : {true, false}) {
+    NonlinearOptimizationParameters parameters;
+    parameters.time_alloc_method =
+        NonlinearOptimizationParameters::kSquaredTimeAndConstraints;
+    parameters.max_iterations = 200;
+    parameters.use_soft_constraints = use_soft_constraints;
+    parameters.algorithm = use_soft_constraints ? nlopt::LN_BOBYQA
+                                                : nlopt::LN_COBYLA;
+    PolynomialOptimizationNonLinear<N> opt(D, parameters);
+    opt.setupFromVertices(vertices_, segment_times, max_derivative);
+    opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_limit);
+    opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_limit);
+    opt.solveLinear();
+    const double initial_cost = opt.getTotalCostWithSoftConstraints();
+
+    opt.optimize();
+
+    // The problem is left at the returned optimum, so it is no worse than
+    // the initial guess.
+    if (use_soft_constraints) {
+      EXPECT_LE(opt.getTotalCostWithSoftConstraints(),
+                initial_cost * (1.0 + 1.0e-9));
+    }
+
+    // The reported maxima belong to the final solution.
+    opt.getTotalCostWithSoftConstraints();
+    const OptimizationInfo info = opt.getOptimizationInfo();
+    const PolynomialOptimization<N>& linear_opt =
+        opt.getPolynomialOptimizationRef();
+    for (const int derivative :
+         {derivative_order::VELOCITY, derivative_order::ACCELERATION}) {
+      ASSERT_EQ(1u, info.maxima.count(derivative));
+      const Extremum max =
+          linear_opt.computeMaximumOfMagnitude(derivative, nullptr);
+      EXPECT_NEAR(max.value, info.maxima.at(derivative).value,
+                  1.0e-9 * std::max(1.0, max.value));
+    }
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, NativeSolver) {
+  // Bounded Rosenbrock function, whose minimum lies on the bound x_0 <= 0.5.
+  const BoundConstrainedOptimizer::Objective rosenbrock =
+      [](const Eigen::Ref<const Eigen::VectorXd>& x,
+         Eigen::Ref<Eigen::VectorXd> gradient) {
+        if (gradient.size() > 0) {
+          gradient[0] =
+              -2.0 * (1.0 - x[0]) - 400.0 * x[0] * (x[1] - x[0] * x[0]);
+          gradient[1] = 200.0 * (x[1] - x[0] * x[0]);
+        }
+        return (1.0 - x[0]) * (1.0 - x[0]) +
+               100.0 * (x[1] - x[0] * x[0]) * (x[1] - x[0] * x[0]);
+      };
+  const Eigen::Vector2d lower(-2.0, -2.0), upper(0.5, 2.0);
+  ProjectedLbfgsOptimizer lbfgs;
+  BoundConstrainedOptimizer::Tolerances tolerances;
+  tolerances.f_rel = -1.0;
+  lbfgs.setTolerances(tolerances);
+  Eigen::VectorXd x = Eigen::Vector2d(-1.2, 1.0);
+  double f_min;
+  EXPECT_GT(lbfgs.minimize(rosenbrock, lower, upper, &x, &f_min), 0);
+  EXPECT_NEAR(0.5, x[0], 1.0e-6);
+  EXPECT_NEAR(0.25, x[1], 1.0e-4);
+  EXPECT_NEAR(0.25, f_min, 1.0e-6);
+
+  // Same with finite differences.
+  x = Eigen::Vector2d(-1.2, 1.0);
+  const BoundConstrainedOptimizer::Objective rosenbrock_fd =
+      BoundConstrainedOptimizer::withFiniteDifferenceGradient(
+          [&rosenbrock](const Eigen::Ref<const Eigen::VectorXd>& x_value) {
+            Eigen::VectorXd no_gradient;
+            return rosenbrock(x_value, no_gradient);
+          },
+          upper);
+  EXPECT_GT(lbfgs.minimize(rosenbrock_fd, lower, upper, &x, &f_min), 0);
+  EXPECT_NEAR(0.5, x[0], 1.0e-4);
+  EXPECT_NEAR(0.25, f_min, 1.0e-4);
+
+  // Time allocation on the built-in solver is at least as good as the
+  // initial guess, and the problem is left at the returned optimum.
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  for (const NonlinearOptimizationParameters::TimeAllocMethod method :
+       {NonlinearOptimizationParameters::kSquaredTime,
+        NonlinearOptimizationParameters::kRichterTime}) {
+    NonlinearOptimizationParameters parameters;
+    parameters.time_alloc_method = method;
+    parameters.solver = NonlinearOptimizationParameters::kProjectedLbfgs;
+    parameters.warm_start = true;
+    parameters.max_iterations = 20;
+    PolynomialOptimizationNonLinear<N> opt(D, parameters);
+    opt.setupFromVertices(vertices_, segment_times, max_derivative);
+    opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+    opt.addMaximumMagnitudeConstraint(derivative_order::ACCELERATION, a_max);
+    opt.solveLinear();
+    const double initial_cost = opt.getTotalCostWithSoftConstraints();
+    EXPECT_GT(opt.optimize(), 0);
+    EXPECT_LE(opt.getTotalCostWithSoftConstraints(),
+              initial_cost * (1.0 + 1.0e-9));
+    // Finite-difference probes are not counted as iterations, and the
+    // reported costs belong to the returned optimum.
+    const OptimizationInfo info = opt.getOptimizationInfo();
+    EXPECT_LE(info.n_iterations, parameters.max_iterations);
+    EXPECT_NEAR(opt.getPolynomialOptimizationRef().computeCost(),
+                info.cost_trajectory, 1.0e-9 * info.cost_trajectory);
+    // Warm restart from the optimum.
+    EXPECT_GT(opt.optimize(), 0);
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, OptimizationTrace) {
+  // Ring buffer semantics.
+  OptimizationTrace trace(3);
+  for (int i = 0; i < 5; ++i) {
+    trace.addEntry().iteration = i;
+  }
+  ASSERT_EQ(3u, trace.size());
+  EXPECT_EQ(2u, trace.getNumberOfDroppedEntries());
+  for (size_t i = 0; i < trace.size(); ++i) {
+    EXPECT_EQ(static_cast<int>(i) + 2, trace[i].iteration);
+  }
+
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.max_iterations = 50;
+  parameters.trace_capacity = 20;
+  PolynomialOptimizationNonLinear<N> opt(D, parameters);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  opt.optimize();
+  const OptimizationInfo info = opt.getOptimizationInfo();
+  const OptimizationTrace& opt_trace = opt.getTrace();
+  ASSERT_EQ(std::min<size_t>(20, info.n_iterations), opt_trace.size());
+  EXPECT_EQ(info.n_iterations - opt_trace.size(),
+            opt_trace.getNumberOfDroppedEntries());
+  for (size_t i = 0; i < opt_trace.size(); ++i) {
+    EXPECT_EQ(segment_times.size(), opt_trace[i].segment_times.size());
+    if (i > 0) {
+      EXPECT_EQ(opt_trace[i - 1].iteration + 1, opt_trace[i].iteration);
+      EXPECT_GE(opt_trace[i].elapsed_time, opt_trace[i - 1].elapsed_time);
+    }
+  }
+
+  // One header line and one line per entry.
+  std::stringstream csv;
+  opt_trace.writeCsv(csv);
+  std::string line;
+  size_t n_lines = 0;
+  while (std::getline(csv, line)) {
+    EXPECT_EQ(4 + segment_times.size(),
+              static_cast<size_t>(std::count(line.begin(), line.end(), ',')));
+    ++n_lines;
+  }
+  EXPECT_EQ(opt_trace.size() + 1, n_lines);
+  std::stringstream json;
+  opt_trace.writeJson(json);
+  const std::string json_string = json.str();
+  EXPECT_EQ('[', json_string.front());
+  EXPECT_EQ(opt_trace.size(),
+            static_cast<size_t>(std::count(json_string.begin(),
+                                           json_string.end(), '{')));
+}
+
+TEST_P(PolynomialOptimizationTests, ParameterTuning) {
+  // Parameters and vertices survive the round trip through YAML.
+  NonlinearOptimizationParameters parameters;
+  parameters.f_rel = 0.01;
+  parameters.algorithm = nlopt::LN_SBPLX;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kRichterTime;
+  parameters.solver = NonlinearOptimizationParameters::kProjectedLbfgs;
+  parameters.trace_capacity = 10;
+  NonlinearOptimizationParameters parameters_from_yaml;
+  EXPECT_TRUE(nonlinearOptimizationParametersFromYaml(
+      YAML::Load(YAML::Dump(nonlinearOptimizationParametersToYaml(parameters))),
+      &parameters_from_yaml));
+  EXPECT_EQ(parameters.f_rel, parameters_from_yaml.f_rel);
+  EXPECT_EQ(parameters.algorithm, parameters_from_yaml.algorithm);
+  EXPECT_EQ(parameters.time_alloc_method,
+            parameters_from_yaml.time_alloc_method);
+  EXPECT_EQ(parameters.solver, parameters_from_yaml.solver);
+  EXPECT_EQ(parameters.trace_capacity, parameters_from_yaml.trace_capacity);
+
+  TuningProblem problem;
+  problem.vertices = vertices_;
+  problem.limits[derivative_order::VELOCITY] = v_max;
+  problem.limits[derivative_order::ACCELERATION] = a_max;
+  TuningProblem problem_from_yaml;
+  EXPECT_TRUE(tuningProblemFromYaml(
+      YAML::Load(YAML::Dump(tuningProblemToYaml(problem))),
+      &problem_from_yaml));
+  ASSERT_EQ(problem.vertices.size(), problem_from_yaml.vertices.size());
+  for (size_t i = 0; i < problem.vertices.size(); ++i) {
+    EXPECT_TRUE(
+        problem.vertices[i].isEqualTol(problem_from_yaml.vertices[i], 1e-12));
+  }
+  EXPECT_EQ(problem.limits, problem_from_yaml.limits);
+
+  // Pareto front of hand-made results.
+  std::vector<TuningResult> results(4);
+  results[0].runtime = 1.0;
+  results[0].cost = 1.0;
+  results[1].runtime = 0.5;
+  results[1].cost = 2.0;
+  results[2].runtime = 1.0;
+  results[2].cost = 1.5;
+  results[3].runtime = 2.0;
+  results[3].cost = 0.5;
+  results[3].violation = 0.1;
+  std::vector<size_t> front;
+  computeParetoFront(results, &front);
+  EXPECT_EQ(std::vector<size_t>({1, 0, 3}), front);
+
+  if (params_.num_segments > 10) {
+    return;
+  }
+  NonlinearOptimizationParameters base;
+  base.max_iterations = 50;
+  TuningParameters tuning_parameters;
+  tuning_parameters.n_samples = 3;
+  ParameterTuning<N> tuning(base, tuning_parameters);
+  tuning.addProblem(problem);
+  EXPECT_TRUE(tuning.run());
+  ASSERT_EQ(tuning_parameters.n_samples + 1, tuning.getResults().size());
+  for (const TuningResult& result : tuning.getResults()) {
+    EXPECT_EQ(base.max_iterations, result.parameters.max_iterations);
+    EXPECT_GT(result.cost, 0.0);
+    EXPECT_GE(result.violation, 0.0);
+  }
+  tuning.getParetoFront(&front);
+  EXPECT_FALSE(front.empty());
+}
+
+TEST_P(PolynomialOptimizationTests, IntegralSoftConstraint) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+
+  NonlinearOptimizationParameters parameters;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  parameters.soft_constraint_method =
+      NonlinearOptimizationParameters::kIntegralViolation;
+  parameters.time_penalty = 0.0;
+  PolynomialOptimizationNonLinear<N> opt(D, parameters);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+
+  // Limit the velocity well below its current maximum, such that the limit
+  // is crossed several times.
+  double v_max_trajectory, a_max_trajectory;
+  trajectory.computeMaxVelocityAndAcceleration(&v_max_trajectory,
+                                               &a_max_trajectory);
+  const double v_limit = 0.5 * v_max_trajectory;
+  opt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_limit);
+
+  // Compare with numerical integration.
+  const double dt = 1.0e-4;
+  double integral = 0.0;
+  for (double t = 0.5 * dt; t < trajectory.getMaxTime(); t += dt) {
+    const double exceedance =
+        trajectory.evaluate(t, derivative_order::VELOCITY).squaredNorm() -
+        v_limit * v_limit;
+    if (exceedance > 0.0) {
+      integral += exceedance * exceedance * dt;
+    }
+  }
+  const double expected_cost = parameters.soft_constraint_integral_weight *
+                               integral / std::pow(v_limit, 4);
+  EXPECT_GT(expected_cost, 0.0);
+  EXPECT_NEAR(expected_cost,
+              opt.getTotalCostWithSoftConstraints() - opt.getCost(),
+              1.0e-3 * expected_cost);
+
+  // The smooth penalty lets the optimizer stretch the segments until the
+  // limit is met approximately.
+  parameters.time_penalty = 500.0;
+  PolynomialOptimizationNonLinear<N> opt_limited(D, parameters);
+  opt_limited.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt_limited.addMaximumMagnitudeConstraint(derivative_order::VELOCITY,
+                                            v_limit);
+  opt_limited.optimize();
+  opt_limited.getTrajectory(&trajectory);
+  trajectory.computeMaxVelocityAndAcceleration(&v_max_trajectory,
+                                               &a_max_trajectory);
+  EXPECT_LT(v_max_trajectory, 1.2 * v_limit);
+
+  // The maxima of the final solution are reported as for kPeakViolation.
+  const OptimizationInfo info = opt_limited.getOptimizationInfo();
+  ASSERT_EQ(1u, info.maxima.count(derivative_order::VELOCITY));
+  EXPECT_NEAR(v_max_trajectory,
+              info.maxima.at(derivative_order::VELOCITY).value,
+              1.0e-3 * v_max_trajectory);
+}
+
+TEST_P(PolynomialOptimizationTests, QuadraticProgram) {
+  // A single segment between fully constrained vertices has no free
+  // derivatives to meet the bounds with.
+  if (params_.num_segments > 10 || params_.num_segments < 2) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  const double cost_unconstrained = opt.computeCost();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+
+  // Largest per-axis velocity of the unconstrained solution.
+  const double dt = 0.01;
+  auto max_axis_velocity = [dt](const Trajectory& trajectory) {
+    double v_axis = 0.0;
+    for (double t = 0.0; t < trajectory.getMaxTime(); t += dt) {
+      v_axis = std::max(v_axis, trajectory.evaluate(t, derivative_order::VELOCITY)
+                                    .lpNorm<Eigen::Infinity>());
+    }
+    return v_axis;
+  };
+  const double v_axis_unconstrained = max_axis_velocity(trajectory);
+
+  // Loose bounds do not change the solution.
+  opt.addDerivativeBoundsAtCollocationPoints(
+      derivative_order::VELOCITY, -2.0 * v_axis_unconstrained,
+      2.0 * v_axis_unconstrained, 5);
+  EXPECT_TRUE(opt.solveQP());
+  EXPECT_NEAR(cost_unconstrained, opt.computeCost(), 1.0e-4 * cost_unconstrained);
+
+  // Active bounds at dense collocation points hold up to the behavior in
+  // between them.
+  opt.clearDerivativeBounds();
+  const double v_bound = 0.95 * v_axis_unconstrained;
+  opt.addDerivativeBoundsAtCollocationPoints(derivative_order::VELOCITY,
+                                             -v_bound, v_bound, 20);
+  std::vector<AdmmQpSolver::Info> infos;
+  EXPECT_TRUE(opt.solveQP(AdmmQpParameters(), &infos));
+  opt.getTrajectory(&trajectory);
+  EXPECT_LE(max_axis_velocity(trajectory), 1.05 * v_bound);
+  EXPECT_GE(opt.computeCost(), cost_unconstrained);
+  int n_iterations = 0;
+  for (const AdmmQpSolver::Info& info : infos) {
+    EXPECT_TRUE(info.converged);
+    n_iterations += info.n_iterations;
+  }
+
+  // A warm start from the solution converges immediately.
+  EXPECT_TRUE(opt.solveQP(AdmmQpParameters(), &infos));
+  int n_iterations_warm = 0;
+  for (const AdmmQpSolver::Info& info : infos) {
+    n_iterations_warm += info.n_iterations;
+  }
+  EXPECT_LE(n_iterations_warm, n_iterations);
+
+  // Bounds on the Bernstein control points hold everywhere. They are
+  // conservative, such that the segments must be longer to pass the
+  // waypoints within them.
+  opt.clearDerivativeBounds();
+  std::vector<double> stretched_times = segment_times;
+  for (double& time : stretched_times) {
+    time *= 2.0;
+  }
+  opt.updateSegmentTimes(stretched_times);
+  opt.addDerivativeBoundsOnControlPoints(derivative_order::VELOCITY, -v_bound,
+                                         v_bound);
+  EXPECT_TRUE(opt.solveQP(AdmmQpParameters(), &infos));
+  for (const AdmmQpSolver::Info& info : infos) {
+    EXPECT_TRUE(info.converged);
+  }
+  opt.getTrajectory(&trajectory);
+  EXPECT_LE(max_axis_velocity(trajectory), v_bound * (1.0 + 1.0e-3));
+}
+
+TEST_P(PolynomialOptimizationTests, TimeNormalization) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  Trajectory trajectory;
+  opt.getTrajectory(&trajectory);
+  const double cost = opt.computeCost();
+
+  // The normalized problem has the same solution.
+  PolynomialOptimization<N> opt_normalized(D);
+  opt_normalized.setTimeNormalization(true);
+  opt_normalized.setupFromVertices(vertices_, segment_times, max_derivative);
+  EXPECT_TRUE(opt_normalized.solveLinear());
+  Trajectory trajectory_normalized;
+  opt_normalized.getTrajectory(&trajectory_normalized);
+  EXPECT_NEAR(cost, opt_normalized.computeCost(), 1e-6 * cost);
+  const double dt = 0.01;
+  for (double t = 0.0; t < trajectory.getMaxTime(); t += dt) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(trajectory.evaluate(t),
+                                  trajectory_normalized.evaluate(t), 1e-6));
+  }
+
+  // Stretching all segments by a factor stretches the solution, also for
+  // long segments and high polynomial orders.
+  const double kTimeFactor = 20.0;
+  std::vector<double> stretched_times = segment_times;
+  for (double& time : stretched_times) {
+    time *= kTimeFactor;
+  }
+  PolynomialOptimization<16> opt_high_order(D);
+  opt_high_order.setTimeNormalization(true);
+  opt_high_order.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt_high_order.solveLinear();
+  Trajectory trajectory_high_order;
+  opt_high_order.getTrajectory(&trajectory_high_order);
+  opt_high_order.updateSegmentTimes(stretched_times);
+  EXPECT_TRUE(opt_high_order.solveLinear());
+  Trajectory trajectory_stretched;
+  opt_high_order.getTrajectory(&trajectory_stretched);
+  for (double t = 0.0; t < trajectory_high_order.getMaxTime(); t += dt) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(trajectory_high_order.evaluate(t),
+                                  trajectory_stretched.evaluate(kTimeFactor * t),
+                                  1e-6));
+  }
+  double t = 0.0;
+  for (size_t i = 0; i < vertices_.size(); ++i) {
+    Eigen::VectorXd position;
+    vertices_[i].getConstraint(derivative_order::POSITION, &position);
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+        position,
+        trajectory_stretched.evaluate(
+            std::min(t, trajectory_stretched.getMaxTime())),
+        1e-6));
+    if (i < stretched_times.size()) {
+      t += stretched_times[i];
+    }
+  }
+}
+
+TEST_P(PolynomialOptimizationTests, MultiGroup) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+
+  // Yaw minimizes acceleration with N = 6.
+  const int kYawN = 6;
+  const Vertex::Vector yaw_vertices = createRandomVertices1D(
+      derivative_order::ACCELERATION, params_.num_segments, -M_PI, M_PI, 42);
+
+  PolynomialOptimizationMultiGroup multi_group;
+  EXPECT_EQ(0u, multi_group.addGroup<N>(vertices_, max_derivative));
+  EXPECT_EQ(1u, multi_group.addGroup<kYawN>(yaw_vertices,
+                                            derivative_order::ACCELERATION));
+  EXPECT_EQ(static_cast<size_t>(D + 1), multi_group.getDimension());
+  EXPECT_FALSE(multi_group.setup(
+      std::vector<double>(params_.num_segments + 1, 1.0)));
+  ASSERT_TRUE(multi_group.setup(segment_times));
+  ASSERT_TRUE(multi_group.solveLinear());
+  Trajectory trajectory;
+  ASSERT_TRUE(multi_group.getTrajectory(&trajectory));
+  EXPECT_EQ(D + 1, trajectory.D());
+  EXPECT_EQ(N, trajectory.N());
+
+  // The groups equal separate solves.
+  PolynomialOptimization<N> position_opt(D);
+  position_opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  position_opt.solveLinear();
+  PolynomialOptimization<kYawN> yaw_opt(1);
+  yaw_opt.setupFromVertices(yaw_vertices, segment_times,
+                            derivative_order::ACCELERATION);
+  yaw_opt.solveLinear();
+  EXPECT_NEAR(position_opt.computeCost() + yaw_opt.computeCost(),
+              multi_group.computeCost(),
+              1e-6 * multi_group.computeCost());
+  Trajectory position_trajectory, yaw_trajectory;
+  position_opt.getTrajectory(&position_trajectory);
+  yaw_opt.getTrajectory(&yaw_trajectory);
+  EXPECT_NEAR(position_trajectory.getMaxTime(), trajectory.getMaxTime(),
+              1e-9);
+  for (double t = 0.0; t < trajectory.getMaxTime(); t += 0.1) {
+    for (int derivative = derivative_order::POSITION;
+         derivative <= derivative_order::ACCELERATION; ++derivative) {
+      const Eigen::VectorXd value = trajectory.evaluate(t, derivative);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+          position_trajectory.evaluate(t, derivative), value.head(D), 1e-6));
+      EXPECT_NEAR(yaw_trajectory.evaluate(t, derivative)[0], value[D], 1e-6);
+    }
+  }
+
+  // The group gives access to the underlying problem.
+  PolynomialOptimizationGroup<kYawN>* yaw_group =
+      dynamic_cast<PolynomialOptimizationGroup<kYawN>*>(
+          &multi_group.getGroup(1));
+  ASSERT_TRUE(yaw_group != nullptr);
+  EXPECT_EQ(kYawN, yaw_group->getN());
+  EXPECT_NEAR(yaw_opt.computeCost(),
+              yaw_group->getOptimization().computeCost(), 1e-9);
+}
+
+TEST_P(PolynomialOptimizationTests, MoveSemantics) {
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  EXPECT_EQ(vertices_.size(), opt.getVerticesRef().size());
+  EXPECT_EQ(segment_times, opt.getSegmentTimesRef());
+
+  Trajectory copied, extracted;
+  opt.getTrajectory(&copied);
+  opt.extractTrajectory(&extracted);
+  EXPECT_TRUE(opt.getSegmentsRef().empty());
+  EXPECT_TRUE(copied == extracted);
+  std::vector<double> extracted_times;
+  extracted.getSegmentTimes(&extracted_times);
+  EXPECT_EQ(copied.getSegmentTimes(), extracted_times);
+
+  // Solving again refills the segments.
+  opt.solveLinear();
+  Trajectory resolved;
+  opt.getTrajectory(&resolved);
+  EXPECT_TRUE(copied == resolved);
+
+  // Rvalue overloads take over the segments.
+  Segment::Vector segments = copied.segments();
+  Trajectory moved;
+  moved.setSegments(std::move(segments));
+  EXPECT_TRUE(copied == moved);
+  EXPECT_NEAR(copied.getMaxTime(), moved.getMaxTime(), 1e-12);
+  Trajectory appended;
+  appended.setSegments(copied.segments());
+  Segment::Vector more_segments = copied.segments();
+  appended.addSegments(std::move(more_segments));
+  EXPECT_TRUE(more_segments.empty());
+  EXPECT_EQ(2 * copied.K(), appended.K());
+  EXPECT_NEAR(2 * copied.getMaxTime(), appended.getMaxTime(), 1e-9);
+
+  Segment::Vector released = moved.releaseSegments();
+  EXPECT_EQ(copied.segments().size(), released.size());
+  EXPECT_TRUE(moved.empty());
+}
+
+TEST_P(PolynomialOptimizationTests, ReusedOptimizer) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  std::vector<double> segment_times =
+      estimateSegmentTimes(vertices_, v_max, a_max);
+
+  // Same constrained derivatives, different values.
+  Vertex::Vector shifted_vertices = vertices_;
+  Eigen::VectorXd position;
+  for (Vertex& vertex : shifted_vertices) {
+    if (vertex.getConstraint(derivative_order::POSITION, &position)) {
+      vertex.addConstraint(derivative_order::POSITION,
+                           position + Eigen::VectorXd::Constant(D, 0.5));
+    }
+  }
+  // Different constrained derivatives.
+  Vertex::Vector restricted_vertices = vertices_;
+  restricted_vertices[params_.num_segments / 2].addConstraint(
+      derivative_order::VELOCITY, Eigen::VectorXd::Zero(D));
+
+  PolynomialOptimization<N> reused_opt(D);
+  reused_opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  reused_opt.solveLinear();
+  for (const Vertex::Vector* vertices :
+       {&shifted_vertices, &restricted_vertices, &vertices_}) {
+    PolynomialOptimization<N> opt(D);
+    opt.setupFromVertices(*vertices, segment_times, max_derivative);
+    opt.solveLinear();
+    reused_opt.setupFromVertices(*vertices, segment_times, max_derivative);
+    reused_opt.solveLinear();
+    EXPECT_EQ(opt.getNumberFreeConstraints(),
+              reused_opt.getNumberFreeConstraints());
+    EXPECT_NEAR(opt.computeCost(), reused_opt.computeCost(),
+                1e-9 * opt.computeCost());
+    Trajectory trajectory, reused_trajectory;
+    opt.getTrajectory(&trajectory);
+    reused_opt.getTrajectory(&reused_trajectory);
+    for (double t = 0.0; t < trajectory.getMaxTime(); t += 0.1) {
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(trajectory.evaluate(t),
+                                    reused_trajectory.evaluate(t), 1e-6));
+    }
+  }
+
+  // The nonlinear optimization is reset between the problems.
+  NonlinearOptimizationParameters parameters;
+  parameters.max_iterations = 200;
+  parameters.time_penalty = 500.0;
+  parameters.algorithm = nlopt::LN_BOBYQA;
+  parameters.time_alloc_method = NonlinearOptimizationParameters::kSquaredTime;
+  PolynomialOptimizationNonLinear<N> reused_nlopt(D, parameters);
+  reused_nlopt.setupFromVertices(vertices_, segment_times, max_derivative);
+  reused_nlopt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, 1.0);
+  reused_nlopt.optimize();
+  reused_nlopt.reset();
+  reused_nlopt.setupFromVertices(shifted_vertices, segment_times,
+                                 max_derivative);
+  reused_nlopt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  reused_nlopt.optimize();
+
+  PolynomialOptimizationNonLinear<N> nlopt(D, parameters);
+  nlopt.setupFromVertices(shifted_vertices, segment_times, max_derivative);
+  nlopt.addMaximumMagnitudeConstraint(derivative_order::VELOCITY, v_max);
+  nlopt.optimize();
+  std::vector<double> times, reused_times;
+  nlopt.getPolynomialOptimizationRef().getSegmentTimes(&times);
+  reused_nlopt.getPolynomialOptimizationRef().getSegmentTimes(&reused_times);
+  ASSERT_EQ(times.size(), reused_times.size());
+  for (size_t i = 0; i < times.size(); ++i) {
+    EXPECT_NEAR(times[i], reused_times[i], 1e-6 * times[i]);
+  }
+  EXPECT_NEAR(nlopt.getTotalCostWithSoftConstraints(),
+              reused_nlopt.getTotalCostWithSoftConstraints(),
+              1e-6 * nlopt.getTotalCostWithSoftConstraints());
+}
+
+TEST_P(PolynomialOptimizationTests, CopyOnWriteSegments) {
+  const Trajectory trajectory = solveLinearTrajectory();
+
+  // Copies share the polynomials.
+  Trajectory version = trajectory;
+  for (int k = 0; k < trajectory.K(); ++k) {
+    EXPECT_TRUE(
+        trajectory.segments()[k].sharesPolynomialsWith(version.segments()[k]));
+  }
+
+  // Modifying a copy detaches it.
+  const Eigen::VectorXd position = trajectory.evaluate(0.0);
+  const Eigen::VectorXd offset = Eigen::VectorXd::Constant(D, 1.0);
+  ASSERT_TRUE(version.offsetTrajectory(offset));
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(position, trajectory.evaluate(0.0), 1e-12));
+  EXPECT_FALSE(
+      trajectory.segments()[0].sharesPolynomialsWith(version.segments()[0]));
+  if (D <= 3) {
+    EXPECT_TRUE(EIGEN_MATRIX_NEAR(position + offset, version.evaluate(0.0),
+                                  1e-9));
+  }
+
+  // So does solving again.
+  const std::vector<double> segment_times = trajectory.getSegmentTimes();
+  PolynomialOptimization<N> opt(D);
+  opt.setupFromVertices(vertices_, segment_times, max_derivative);
+  opt.solveLinear();
+  opt.getTrajectory(&version);
+  for (int k = 0; k < version.K(); ++k) {
+    EXPECT_TRUE(
+        version.segments()[k].sharesPolynomialsWith(opt.getSegmentsRef()[k]));
+  }
+  Vertex::Vector shifted_vertices = vertices_;
+  Eigen::VectorXd vertex_position;
+  ASSERT_TRUE(shifted_vertices.front().getConstraint(
+      derivative_order::POSITION, &vertex_position));
+  shifted_vertices.front().addConstraint(derivative_order::POSITION,
+                                         vertex_position + offset);
+  ASSERT_TRUE(opt.updateVertices(shifted_vertices, segment_times));
+  opt.solveLinear();
+  EXPECT_TRUE(EIGEN_MATRIX_NEAR(position, version.evaluate(0.0), 1e-12));
+  EXPECT_FALSE(
+      version.segments()[0].sharesPolynomialsWith(opt.getSegmentsRef()[0]));
+}
+
+TEST_P(PolynomialOptimizationTests, TrajectoryHandoff) {
+  if (params_.num_segments > 10) {
+    return;
+  }
+  const Trajectory trajectory = solveLinearTrajectory();
+  const double start_position = trajectory.evaluate(0.0)[0];
+
+  TrajectoryHandoff handoff;
+  EXPECT_FALSE(handoff.hasUpdate());
+  EXPECT_EQ(0u, handoff.acquire().version);
+  EXPECT_TRUE(handoff.acquire().trajectory.empty());
+
+  // Version i is offset by i and starts at time i.
+  const uint64_t kNumVersions = 2000;
+  std::thread planner([&]() {
+    for (uint64_t i = 1; i <= kNumVersions; ++i) {
+      Trajectory version = trajectory;
+      version.offsetTrajectory(Eigen::VectorXd::Constant(D, i));
+      handoff.publish(std::move(version), static_cast<double>(i));
+    }
+  });
+  uint64_t last_version = 0;
+  while (last_version < kNumVersions) {
+    const TrajectoryHandoff::Snapshot& snapshot = handoff.acquire();
+    ASSERT_GE(snapshot.version, last_version);
+    last_version = snapshot.version;
+    if (last_version == 0) {
+      continue;
+    }
+    EXPECT_EQ(static_cast<double>(last_version), snapshot.start_time);
+    EXPECT_NEAR(start_position + last_version,
+                snapshot.trajectory.segments()[0].evaluate(0.0)[0], 1e-6);
+    EXPECT_EQ(0.0, snapshot.getTrajectoryTime(0.0));
+    EXPECT_EQ(trajectory.getMaxTime(), snapshot.getTrajectoryTime(1.0e9));
+  }
+  planner.join();
+  EXPECT_FALSE(handoff.hasUpdate());
+}
+
+TEST_P(PolynomialOptimizationTests, CropAndSplit) {
+  const Trajectory trajectory = solveLinearTrajectory();
+  const double max_time = trajectory.getMaxTime();
+
+  // Split every segment in the middle.
+  for (const Segment& segment : trajectory.segments()) {
+    const double t_split = 0.4 * segment.getTime();
+    Segment first(N, D), second(N, D);
+    ASSERT_TRUE(segment.split(t_split, &first, &second));
+    EXPECT_TRUE(first.sharesPolynomialsWith(segment));
+    EXPECT_NEAR(segment.getTime(), first.getTime() + second.getTime(), 1e-12);
+    for (int derivative = derivative_order::POSITION;
+         derivative <= max_derivative; ++derivative) {
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(first.evaluate(t_split, derivative),
+                                    second.evaluate(0.0, derivative), 1e-6));
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(segment.evaluate(segment.getTime(),
+                                                     derivative),
+                                    second.evaluate(second.getTime(),
+                                                    derivative),
+                                    1e-6));
+    }
+  }
+  Segment first(N, D), second(N, D);
+  EXPECT_FALSE(trajectory.segments()[0].split(0.0, &first, &second));
+
+  // Crop an inner window and the tail.
+  const double t_start = 0.3 * max_time;
+  const double t_end = 0.8 * max_time;
+  Trajectory window, tail;
+  ASSERT_TRUE(trajectory.crop(t_start, t_end, &window));
+  ASSERT_TRUE(trajectory.crop(t_start, max_time, &tail));
+  EXPECT_NEAR(t_end - t_start, window.getMaxTime(), 1e-9);
+  EXPECT_NEAR(max_time - t_start, tail.getMaxTime(), 1e-9);
+  if (tail.K() > 1) {
+    EXPECT_TRUE(tail.segments().back().sharesPolynomialsWith(
+        trajectory.segments().back()));
+  }
+  for (double t = 0.0; t < window.getMaxTime(); t += 0.05) {
+    for (int derivative = derivative_order::POSITION;
+         derivative <= derivative_order::ACCELERATION; ++derivative) {
+      EXPECT_TRUE(
+          EIGEN_MATRIX_NEAR(trajectory.evaluate(t_start + t, derivative),
+                            window.evaluate(t, derivative), 1e-6));
+    }
+  }
+  Trajectory full;
+  ASSERT_TRUE(trajectory.crop(0.0, max_time, &full));
+  EXPECT_TRUE(full == trajectory);
+  EXPECT_FALSE(trajectory.crop(t_end, t_start, &window));
+  EXPECT_FALSE(trajectory.crop(0.0, 2.0 * max_time, &window));
+}
+
+TEST_P(PolynomialOptimizationTests, TransformTrajectory) {
+  if (D != 3) {
+    return;
+  }
+  Trajectory position_trajectory = solveLinearTrajectory();
+
+  PolynomialOptimization<N> yaw_opt(1);
+  yaw_opt.setupFromVertices(
+      createRandomVertices1D(max_derivative, params_.num_segments, -M_PI, M_PI,
+                             42),
+      position_trajectory.getSegmentTimes(), max_derivative);
+  yaw_opt.solveLinear();
+  Trajectory yaw_trajectory, trajectory;
+  yaw_opt.getTrajectory(&yaw_trajectory);
+  ASSERT_TRUE(position_trajectory.getTrajectoryWithAppendedDimension(
+      yaw_trajectory, &trajectory));
+
+  // Rotation about z with scale and translation, and a mirroring at the
+  // x-z plane.
+  Eigen::Affine3d T_similarity =
+      Eigen::Translation3d(1.0, -2.0, 3.0) *
+      Eigen::AngleAxisd(0.7, Eigen::Vector3d::UnitZ()) * Eigen::Scaling(2.0);
+  Eigen::Affine3d T_mirror = Eigen::Affine3d::Identity();
+  T_mirror.linear() = Eigen::Vector3d(1.0, -1.0, 1.0).asDiagonal();
+  for (const Eigen::Affine3d& T_A_B : {T_similarity, T_mirror}) {
+    Trajectory transformed = trajectory;
+    ASSERT_TRUE(transformed.transformTrajectory(T_A_B));
+    for (double t = 0.0; t < trajectory.getMaxTime(); t += 0.1) {
+      const Eigen::VectorXd p_B = trajectory.evaluate(t);
+      const Eigen::VectorXd p_A = transformed.evaluate(t);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(Eigen::Vector3d(T_A_B * p_B.head<3>()),
+                                    p_A.head(3), 1e-6));
+      const Eigen::VectorXd a_B =
+          trajectory.evaluate(t, derivative_order::ACCELERATION);
+      const Eigen::VectorXd a_A =
+          transformed.evaluate(t, derivative_order::ACCELERATION);
+      EXPECT_TRUE(
+          EIGEN_MATRIX_NEAR(Eigen::Vector3d(T_A_B.linear() * a_B.head<3>()),
+                            a_A.head(3), 1e-6));
+      // The heading is transformed like a direction.
+      const Eigen::Vector3d heading_B(std::cos(p_B[3]), std::sin(p_B[3]), 0.0);
+      const Eigen::Vector3d heading_A(std::cos(p_A[3]), std::sin(p_A[3]), 0.0);
+      EXPECT_TRUE(EIGEN_MATRIX_NEAR(
+          Eigen::Vector3d((T_A_B.linear() * heading_B).normalized()),
+          heading_A, 1e-6));
+    }
+  }
+
+  // Yaw is not defined for tilted frames, but positions are.
+  Eigen::Affine3d T_tilted(Eigen::AngleAxisd(0.3, Eigen::Vector3d::UnitX()));
+  Trajectory transformed = trajectory;
+  EXPECT_FALSE(transformed.transformTrajectory(T_tilted));
+  EXPECT_TRUE(position_trajectory.transformTrajectory(T_tilted));
+
+  // Neither for horizontal shear or non-uniform scaling.
+  Eigen::Affine3d T_sheared = Eigen::Affine3d::Identity();
+  T_sheared.linear()(0, 1) = 0.5;
+  EXPECT_FALSE(transformed.transformTrajectory(T_sheared));
+  EXPECT_TRUE(position_trajectory.transformTrajectory(T_sheared));
+  const Eigen::Affine3d T_stretched(Eigen::Scaling(2.0, 1.0, 1.0));
+  EXPECT_FALSE(transformed.transformTrajectory(T_stretched));
+  EXPECT_TRUE(position_trajectory.transformTrajectory(T_stretched));
+}
+
 TEST_P(PolynomialOptimizationTests, TimeScaling) {
   std::vector<double> segment_times;
   double time_factor = 1.0;